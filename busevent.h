@@ -0,0 +1,55 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This file defines the events published to subscribers.
+ */
+
+#ifndef BUSEVENT_H_
+#define BUSEVENT_H_
+
+#include <stdint.h>
+
+namespace cecplugin {
+
+/**
+ * @brief Event published to the subscribers of the event socket.
+ *
+ * The structure only contains fixed size fields, so it can be copied
+ * without allocation in the libCEC callback threads and can be used by
+ * other plugins without the libCEC headers.
+ */
+struct cCECBusEvent {
+    /** @brief Type of the event, the value is used as tag in the encoding. */
+    enum eType : uint8_t {
+        FRAME       = 'F',  ///< CEC frame received
+        KEY         = 'K',  ///< CEC key press received
+        POWER       = 'P',  ///< Power status of a device changed
+        PLAYER      = 'S',  ///< Player switched (mName tv, radio, replay, stop)
+        COMMANDLIST = 'L',  ///< Command list queued (mName event, mValue count)
+        ALERT       = 'A',  ///< Adapter alert (mValue libcec_alert)
+        SOURCE      = 'R'   ///< Active source changed (mInitiator, mValue physical)
+    };
+    static constexpr const uint8_t ADAPTER_NONE = 0xFF; ///< Not adapter specific
+    static constexpr const int MAX_PARAMS = 64;         ///< CEC_MAX_DATA_PACKET_SIZE
+    static constexpr const int MAX_NAME = 32;
+
+    uint8_t mType = FRAME;                 ///< eType
+    uint8_t mAdapter = ADAPTER_NONE;       ///< Index of the adapter
+    uint8_t mInitiator = 0xF;              ///< Logical address of the sender
+    uint8_t mDestination = 0xF;            ///< Logical address of the receiver
+    int16_t mOpcode = -1;                  ///< CEC opcode, -1 if none
+    uint8_t mParamCount = 0;               ///< Valid entries in mParams
+    uint8_t mParams[MAX_PARAMS] = {};      ///< CEC parameters
+    int32_t mValue = 0;                    ///< Key code, power status, alert...
+    char mName[MAX_NAME] = {};             ///< Zero terminated name
+    uint64_t mTimeMs = 0;                  ///< Time of the event (ms since epoch)
+};
+
+} // namespace cecplugin
+
+#endif /* BUSEVENT_H_ */
@@ -0,0 +1,389 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the cache of the CEC bus state.
+ */
+
+#include "busstate.h"
+
+namespace cecplugin {
+
+/**
+ * @brief Forgets all cached device states.
+ */
+void cCECBusState::Clear()
+{
+    cMutexLock lock(&mMutex);
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        mPower[i] = CEC_POWER_STATUS_UNKNOWN;
+        mPowerTime[i] = 0;
+        mPhysicalAddress[i] = cCECBusSnapshot::PHYSICAL_UNKNOWN;
+    }
+    mActiveSource = CECDEVICE_UNKNOWN;
+    mActiveSourcePhysical = cCECBusSnapshot::PHYSICAL_UNKNOWN;
+    mGeneration++;
+}
+
+/**
+ * @brief Stores the power status of a device.
+ *
+ * @param addr Logical address of the device
+ * @param status Reported power status
+ * @return true if the power status has changed
+ */
+bool cCECBusState::SetPowerStatus(cec_logical_address addr,
+                                  cec_power_status status)
+{
+    if ((addr < CECDEVICE_TV) || (addr >= MAX_DEVICES)) {
+        return false;
+    }
+    cMutexLock lock(&mMutex);
+    bool changed = (mPower[addr] != status);
+    mPower[addr] = status;
+    mPowerTime[addr] = cTimeMs::Now();
+    if (changed) {
+        mGeneration++;
+    }
+    return changed;
+}
+
+/**
+ * @brief Gets the cached power status of a device.
+ *
+ * Transition states are not reported, as the caller has to ask the
+ * device again anyway.
+ *
+ * @param addr Logical address of the device
+ * @param status Receives the cached power status
+ * @param maxage Maximum age of the cached value in ms
+ * @return true if a usable value is cached
+ */
+bool cCECBusState::GetPowerStatus(cec_logical_address addr,
+                                  cec_power_status &status, uint64_t maxage)
+{
+    if ((addr < CECDEVICE_TV) || (addr >= MAX_DEVICES)) {
+        return false;
+    }
+    cMutexLock lock(&mMutex);
+    if ((mPowerTime[addr] == 0) ||
+        ((cTimeMs::Now() - mPowerTime[addr]) > maxage)) {
+        return false;
+    }
+    status = mPower[addr];
+    return ((status == CEC_POWER_STATUS_ON) ||
+            (status == CEC_POWER_STATUS_STANDBY));
+}
+
+/**
+ * @brief Stores the physical address reported by a device.
+ *
+ * @param addr Logical address of the device
+ * @param physical Physical address of the device
+ */
+void cCECBusState::SetPhysicalAddress(cec_logical_address addr,
+                                      uint16_t physical)
+{
+    if ((addr < CECDEVICE_TV) || (addr >= MAX_DEVICES)) {
+        return;
+    }
+    cMutexLock lock(&mMutex);
+    if (mPhysicalAddress[addr] != physical) {
+        mPhysicalAddress[addr] = physical;
+        mGeneration++;
+    }
+}
+
+/**
+ * @brief Gets the cached physical address of a device.
+ *
+ * @param addr Logical address of the device
+ * @return Last reported physical address
+ */
+uint16_t cCECBusState::GetPhysicalAddress(cec_logical_address addr)
+{
+    if ((addr < CECDEVICE_TV) || (addr >= MAX_DEVICES)) {
+        return cCECBusSnapshot::PHYSICAL_UNKNOWN;
+    }
+    cMutexLock lock(&mMutex);
+    return mPhysicalAddress[addr];
+}
+
+/**
+ * @brief Stores the active source reported on the bus.
+ *
+ * @param addr Logical address of the active source
+ * @param physical Physical address of the active source
+ * @return true if the active source has changed
+ */
+bool cCECBusState::SetActiveSource(cec_logical_address addr, uint16_t physical)
+{
+    cMutexLock lock(&mMutex);
+    if ((mActiveSource == addr) && (mActiveSourcePhysical == physical)) {
+        return false;
+    }
+    mActiveSource = addr;
+    mActiveSourcePhysical = physical;
+    mGeneration++;
+    return true;
+}
+
+/**
+ * @brief Stores the active route selected by the TV or a switch.
+ *
+ * The logical address of the new source is taken from the reported
+ * physical addresses. If no device reported the physical address, only
+ * the path is known.
+ *
+ * @param physical Physical address of the new source
+ * @return true if the active source has changed
+ */
+bool cCECBusState::SetActivePath(uint16_t physical)
+{
+    cMutexLock lock(&mMutex);
+    cec_logical_address addr = CECDEVICE_UNKNOWN;
+    for (int i = CECDEVICE_TV; i < CECDEVICE_BROADCAST; i++) {
+        if (mPhysicalAddress[i] == physical) {
+            addr = (cec_logical_address)i;
+            break;
+        }
+    }
+    if ((mActiveSource == addr) && (mActiveSourcePhysical == physical)) {
+        return false;
+    }
+    mActiveSource = addr;
+    mActiveSourcePhysical = physical;
+    mGeneration++;
+    return true;
+}
+
+/**
+ * @brief Forgets the active source if it is the given device.
+ *
+ * @param addr Logical address of the device which is no longer active
+ * @return true if the active source has changed
+ */
+bool cCECBusState::ClearActiveSource(cec_logical_address addr)
+{
+    cMutexLock lock(&mMutex);
+    if ((mActiveSource != addr) || (addr == CECDEVICE_UNKNOWN)) {
+        return false;
+    }
+    mActiveSource = CECDEVICE_UNKNOWN;
+    mActiveSourcePhysical = cCECBusSnapshot::PHYSICAL_UNKNOWN;
+    mGeneration++;
+    return true;
+}
+
+/**
+ * @brief Gets the cached active source.
+ *
+ * @param addr Receives the logical address of the active source
+ * @param physical Receives the physical address of the active source
+ */
+void cCECBusState::GetActiveSource(cec_logical_address &addr,
+                                   uint16_t &physical)
+{
+    cMutexLock lock(&mMutex);
+    addr = mActiveSource;
+    physical = mActiveSourcePhysical;
+}
+
+/**
+ * @brief Copies the cached state of all devices.
+ *
+ * @param snapshot Receives the last reported state of all devices
+ */
+void cCECBusState::GetSnapshot(cCECBusSnapshot &snapshot)
+{
+    cMutexLock lock(&mMutex);
+    for (int i = 0; i < MAX_DEVICES; i++) {
+        snapshot.mPower[i] = mPower[i];
+        snapshot.mPhysicalAddress[i] = mPhysicalAddress[i];
+    }
+    snapshot.mActiveSource = mActiveSource;
+    snapshot.mActiveSourcePhysical = mActiveSourcePhysical;
+}
+
+/**
+ * @brief Gets the physical address of the switch a port belongs to.
+ *
+ * The parent is found by clearing the last non zero nibble,
+ * e.g. 1.2.3.0 -> 1.2.0.0.
+ *
+ * @param physical Physical address
+ * @return Parent address, PHYSICAL_UNKNOWN for the TV
+ */
+uint16_t cCECBusState::ParentAddress(uint16_t physical)
+{
+    if ((physical == 0) || (physical == cCECBusSnapshot::PHYSICAL_UNKNOWN)) {
+        return cCECBusSnapshot::PHYSICAL_UNKNOWN;
+    }
+    for (int shift = 0; shift < 16; shift += 4) {
+        if (((physical >> shift) & 0xF) != 0) {
+            return physical & ~(0xF << shift);
+        }
+    }
+    return cCECBusSnapshot::PHYSICAL_UNKNOWN;
+}
+
+/**
+ * @brief Gets the depth of a physical address in the HDMI tree.
+ *
+ * @param physical Physical address
+ * @return Number of leading non zero nibbles
+ */
+int cCECBusState::Depth(uint16_t physical)
+{
+    int depth = 0;
+    for (int shift = 12; shift >= 0; shift -= 4) {
+        if (((physical >> shift) & 0xF) == 0) {
+            break;
+        }
+        depth++;
+    }
+    return depth;
+}
+
+/**
+ * @brief Checks if a physical address is in the subtree of a port.
+ *
+ * @param port Physical address of the port
+ * @param physical Physical address to check
+ * @return true if physical starts with the nibbles of port
+ */
+bool cCECBusState::IsBelow(uint16_t port, uint16_t physical)
+{
+    if ((port == cCECBusSnapshot::PHYSICAL_UNKNOWN) ||
+        (physical == cCECBusSnapshot::PHYSICAL_UNKNOWN)) {
+        return false;
+    }
+    int depth = Depth(port);
+    if (depth == 0) {
+        return true;
+    }
+    uint16_t mask = (uint16_t)(0xFFFF << (16 - 4 * depth));
+    return (physical & mask) == port;
+}
+
+/**
+ * @brief Finds the device with exactly this physical address.
+ *
+ * @param physical Physical address
+ * @return Logical address or CECDEVICE_UNKNOWN
+ */
+cec_logical_address cCECBusState::FindDevice(uint16_t physical)
+{
+    if (physical == cCECBusSnapshot::PHYSICAL_UNKNOWN) {
+        return CECDEVICE_UNKNOWN;
+    }
+    cMutexLock lock(&mMutex);
+    for (int i = CECDEVICE_TV; i < CECDEVICE_BROADCAST; i++) {
+        if (mPhysicalAddress[i] == physical) {
+            return (cec_logical_address)i;
+        }
+    }
+    return CECDEVICE_UNKNOWN;
+}
+
+/**
+ * @brief Finds the nearest device upstream of a port.
+ *
+ * @param physical Physical address of the port
+ * @return Logical address of the nearest switch or TV, CECDEVICE_UNKNOWN
+ *         if none reported its physical address
+ */
+cec_logical_address cCECBusState::FindUpstream(uint16_t physical)
+{
+    for (uint16_t p = ParentAddress(physical);
+         p != cCECBusSnapshot::PHYSICAL_UNKNOWN; p = ParentAddress(p)) {
+        cec_logical_address addr = FindDevice(p);
+        if (addr != CECDEVICE_UNKNOWN) {
+            return addr;
+        }
+    }
+    return CECDEVICE_UNKNOWN;
+}
+
+/**
+ * @brief Finds the device nearest to a port at or behind the port.
+ *
+ * Allows a <device> to be defined by the HDMI input it is connected to,
+ * even if an AVR or switch is inserted in between.
+ *
+ * @param port Physical address of the port
+ * @return Logical address or CECDEVICE_UNKNOWN if it is not unique
+ */
+cec_logical_address cCECBusState::FindDownstream(uint16_t port)
+{
+    cec_logical_address found = CECDEVICE_UNKNOWN;
+    int depth = 5;
+    bool unique = false;
+
+    cMutexLock lock(&mMutex);
+    for (int i = CECDEVICE_TV; i < CECDEVICE_BROADCAST; i++) {
+        if (!IsBelow(port, mPhysicalAddress[i])) {
+            continue;
+        }
+        int d = Depth(mPhysicalAddress[i]);
+        if (d < depth) {
+            depth = d;
+            found = (cec_logical_address)i;
+            unique = true;
+        }
+        else if ((d == depth) &&
+                 (mPhysicalAddress[i] != mPhysicalAddress[found])) {
+            unique = false;
+        }
+    }
+    return unique ? found : CECDEVICE_UNKNOWN;
+}
+
+/**
+ * @brief Gets the switch ports on the route from the TV to a device.
+ *
+ * @param physical Physical address of the device
+ * @param route Receives the ports, e.g. 1.0.0.0, 1.2.0.0 for 1.2.0.0
+ */
+void cCECBusState::GetRoute(uint16_t physical, std::vector<uint16_t> &route)
+{
+    route.clear();
+    if (physical == cCECBusSnapshot::PHYSICAL_UNKNOWN) {
+        return;
+    }
+    int depth = Depth(physical);
+    for (int d = 1; d <= depth; d++) {
+        route.push_back(physical & (uint16_t)(0xFFFF << (16 - 4 * d)));
+    }
+}
+
+/**
+ * @brief Gets the ports which have to switch to route a new source.
+ *
+ * Only the switches below the common part of both routes have to change
+ * their input. If the current source is unknown, all ports of the new
+ * route are returned.
+ *
+ * @param from Physical address of the current source
+ * @param to Physical address of the new source
+ * @param ports Receives the ports which change
+ */
+void cCECBusState::GetRouteChange(uint16_t from, uint16_t to,
+                                  std::vector<uint16_t> &ports)
+{
+    std::vector<uint16_t> oldRoute;
+    GetRoute(from, oldRoute);
+    GetRoute(to, ports);
+    unsigned int common = 0;
+    while ((common < oldRoute.size()) && (common < ports.size()) &&
+           (oldRoute[common] == ports[common])) {
+        common++;
+    }
+    ports.erase(ports.begin(), ports.begin() + common);
+}
+
+} // namespace cecplugin
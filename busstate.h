@@ -0,0 +1,227 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the cache of the CEC bus state.
+ */
+
+#ifndef BUSSTATE_H_
+#define BUSSTATE_H_
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+#include <cectypes.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+namespace cecplugin {
+
+using namespace CEC;
+
+/**
+ * @class cCECBusSnapshot
+ * @brief Copy of the cached bus state, taken at one point in time.
+ */
+class cCECBusSnapshot {
+public:
+    static constexpr const int MAX_DEVICES = CECDEVICE_BROADCAST + 1;
+    static constexpr const uint16_t PHYSICAL_UNKNOWN = 0xFFFF;
+
+    cec_power_status mPower[MAX_DEVICES];    ///< Last reported power status
+    uint16_t mPhysicalAddress[MAX_DEVICES];  ///< Last reported physical address
+    cec_logical_address mActiveSource;       ///< Last reported active source
+    uint16_t mActiveSourcePhysical;          ///< Physical address of active source
+};
+
+/**
+ * @class cCECBusState
+ * @brief Cache of the last known state of the devices on a CEC bus.
+ *
+ * The cache is filled from the power status reported by the devices and
+ * from the results of the requests sent by the worker thread. It allows
+ * built-in commands like <if> and <waitpower> to avoid a bus round trip
+ * if the answer is already known.
+ *
+ * @note Thread-safe, the libCEC callback thread updates the cache while
+ *       the worker thread reads it.
+ */
+class cCECBusState {
+private:
+    static constexpr const int MAX_DEVICES = cCECBusSnapshot::MAX_DEVICES;
+
+    cMutex mMutex;
+    cec_power_status mPower[MAX_DEVICES];  ///< Last known power status
+    uint64_t mPowerTime[MAX_DEVICES];      ///< Time of the last update (ms)
+    uint16_t mPhysicalAddress[MAX_DEVICES]; ///< Last reported physical address
+    cec_logical_address mActiveSource;     ///< Last reported active source
+    uint16_t mActiveSourcePhysical;        ///< Physical address of active source
+    std::atomic<uint32_t> mGeneration{0};  ///< Incremented on every change
+
+public:
+    static constexpr const uint64_t POWER_CACHE_MS = 5000; ///< Default max age
+
+    /** @brief Constructor - all devices are unknown. */
+    cCECBusState() { Clear(); }
+
+    /** @brief Forgets all cached states, e.g. after a reconnect. */
+    void Clear();
+
+    /**
+     * @brief Stores the power status of a device.
+     * @param addr Logical address of the device.
+     * @param status Reported power status.
+     * @return true if the power status has changed.
+     */
+    bool SetPowerStatus(cec_logical_address addr, cec_power_status status);
+
+    /**
+     * @brief Gets the cached power status of a device.
+     * @param addr Logical address of the device.
+     * @param status Receives the power status.
+     * @param maxage Maximum age of the cached value in ms.
+     * @return true if a stable status not older than maxage is cached.
+     */
+    bool GetPowerStatus(cec_logical_address addr, cec_power_status &status,
+                        uint64_t maxage = POWER_CACHE_MS);
+
+    /**
+     * @brief Stores the physical address reported by a device.
+     * @param addr Logical address of the device.
+     * @param physical Physical address of the device.
+     */
+    void SetPhysicalAddress(cec_logical_address addr, uint16_t physical);
+
+    /**
+     * @brief Gets the cached physical address of a device.
+     * @param addr Logical address of the device.
+     * @return Physical address or cCECBusSnapshot::PHYSICAL_UNKNOWN.
+     */
+    uint16_t GetPhysicalAddress(cec_logical_address addr);
+
+    /**
+     * @brief Stores the active source reported on the bus.
+     * @param addr Logical address of the active source.
+     * @param physical Physical address of the active source.
+     * @return true if the active source has changed.
+     */
+    bool SetActiveSource(cec_logical_address addr, uint16_t physical);
+
+    /**
+     * @brief Stores the active route selected by the TV or a switch.
+     *
+     * Used for ROUTING_CHANGE, ROUTING_INFORMATION and SET_STREAM_PATH,
+     * which only carry the physical address of the new source.
+     * @param physical Physical address of the new source.
+     * @return true if the active source has changed.
+     */
+    bool SetActivePath(uint16_t physical);
+
+    /**
+     * @brief Forgets the active source if it is the given device.
+     * @param addr Logical address of the device leaving.
+     * @return true if the active source has changed.
+     */
+    bool ClearActiveSource(cec_logical_address addr);
+
+    /**
+     * @brief Gets the cached active source.
+     * @param addr Receives the logical address, CECDEVICE_UNKNOWN if unknown.
+     * @param physical Receives the physical address.
+     */
+    void GetActiveSource(cec_logical_address &addr, uint16_t &physical);
+
+    /**
+     * @brief Gets a counter which changes whenever the cached state changes.
+     * @return Generation of the cached state, readers compare it to
+     *         detect changes without locking.
+     */
+    uint32_t GetGeneration() const { return mGeneration.load(); }
+
+    /**
+     * @brief Copies the cached state of all devices.
+     * @param snapshot Receives the state.
+     */
+    void GetSnapshot(cCECBusSnapshot &snapshot);
+
+    /**
+     * @name HDMI topology
+     *
+     * The physical addresses reported by the devices form the HDMI tree:
+     * 1.2.0.0 is connected to input 2 of the switch at 1.0.0.0, which is
+     * connected to input 1 of the TV at 0.0.0.0. The queries work on the
+     * cached addresses and never access the bus.
+     * @{
+     */
+
+    /**
+     * @brief Gets the physical address of the switch a port belongs to.
+     * @param physical Physical address.
+     * @return Parent address, PHYSICAL_UNKNOWN for the TV.
+     */
+    static uint16_t ParentAddress(uint16_t physical);
+
+    /**
+     * @brief Gets the depth of a physical address in the HDMI tree.
+     * @param physical Physical address.
+     * @return 0 for the TV, 1 for 1.0.0.0, up to 4.
+     */
+    static int Depth(uint16_t physical);
+
+    /**
+     * @brief Checks if a physical address is in the subtree of a port.
+     * @param port Physical address of the port.
+     * @param physical Physical address to check.
+     * @return true if physical is port or connected behind port.
+     */
+    static bool IsBelow(uint16_t port, uint16_t physical);
+
+    /**
+     * @brief Finds the device with exactly this physical address.
+     * @param physical Physical address.
+     * @return Logical address or CECDEVICE_UNKNOWN.
+     */
+    cec_logical_address FindDevice(uint16_t physical);
+
+    /**
+     * @brief Finds the nearest device upstream of a port (e.g. an AVR).
+     * @param physical Physical address of the port.
+     * @return Logical address or CECDEVICE_UNKNOWN.
+     */
+    cec_logical_address FindUpstream(uint16_t physical);
+
+    /**
+     * @brief Finds the device nearest to a port at or behind the port.
+     * @param port Physical address of the port.
+     * @return Logical address or CECDEVICE_UNKNOWN if no or more than one
+     *         device has the same minimal depth.
+     */
+    cec_logical_address FindDownstream(uint16_t port);
+
+    /**
+     * @brief Gets the switch ports on the route from the TV to a device.
+     * @param physical Physical address of the device.
+     * @param route Receives the ports from the TV to the device.
+     */
+    static void GetRoute(uint16_t physical, std::vector<uint16_t> &route);
+
+    /**
+     * @brief Gets the ports which have to switch to route a new source.
+     *
+     * Ports on the route to the current source are already selected.
+     * @param from Physical address of the current source.
+     * @param to Physical address of the new source.
+     * @param ports Receives the ports which change.
+     */
+    static void GetRouteChange(uint16_t from, uint16_t to,
+                               std::vector<uint16_t> &ports);
+    /** @} */
+};
+
+} // namespace cecplugin
+
+#endif /* BUSSTATE_H_ */
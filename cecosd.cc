@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <stdexcept>
+#include <vector>
 #include "cecremoteplugin.h"
 #include "cecosd.h"
 #include "ceclog.h"
@@ -20,55 +21,180 @@ using namespace cecplugin;
 
 namespace cecplugin {
 
-std::vector<cCECMenu> cCECOsd::mMenuItems;
+/**
+ * @brief Builds the menu model from the parsed menu list.
+ *
+ * The display texts with the number shortcuts (1-9) are prepared here,
+ * so opening the menu does not need to format them again.
+ *
+ * @param menulist Menu entries of the configuration file
+ */
+cCECMenuModel::cCECMenuModel(const cCECMenuList &menulist)
+{
+    mMenus.reserve(menulist.size());
+    mTexts.reserve(menulist.size());
+    for (const cCECMenu &menu : menulist) {
+        size_t cnt = mMenus.size() + 1;
+        string num = "  ";
+        if (cnt <= 9) {
+            num = *cString::sprintf("%d ", (int)cnt);
+        }
+        mMenus.push_back(menu);
+        mTexts.push_back(num + menu.mMenuTitle);
+    }
+}
 
 /**
  * @brief Constructs the CEC device OSD menu.
  *
- * Creates an OSD menu listing all configured CEC menu items,
+ * Creates an OSD menu listing all entries of the current menu model,
  * with numeric shortcuts for quick selection (1-9).
  *
  * @param plugin Pointer to the parent plugin instance
  */
 cCECOsd::cCECOsd(cPluginCecremote *plugin) :
-                 cOsdMenu(tr("CEC Device")) {
-
-  int cnt = 1;
-  char num[20];
-  cCECMenu menuitem;
-  string menutxt;
-  cCECMenuList *menulist = plugin->GetMenuList();
-
-  for (cCECMenuListIterator i = menulist->begin();
-       i != menulist->end(); i++) {
-      menuitem = *i;
-      if (cnt <= 9) {
-          sprintf(num,"%d ", cnt);
+                 cOsdMenu(tr("CEC Device"), 24),
+                 mPlugin(plugin),
+                 mModel(plugin->GetMenuModel()),
+                 mGeneration(plugin->GetBusGeneration()) {
+
+  for (size_t i = 0; i < mModel->mMenus.size(); i++) {
+      Add(new cCECOsdItem(mModel.get(), i, plugin));
+  }
+  Refresh();
+  // Ask devices with unknown state, the answers update the menu
+  vector<const cCECDevice *> asked;
+  for (cOsdItem *item = First(); item; item = Next(item)) {
+      cCECOsdItem *cecitem = (cCECOsdItem *)item;
+      const cCECDevice &dev = cecitem->GetDevice();
+      if (!cecitem->HasDevice() || cecitem->IsStateKnown()) {
+          continue;
       }
-      else {
-          strcpy (num, "  ");
+      auto same = [&dev](const cCECDevice *d) {
+          return (d->mAdapter == dev.mAdapter) &&
+                 (d->mPhysicalAddress == dev.mPhysicalAddress) &&
+                 (d->mLogicalAddressDefined == dev.mLogicalAddressDefined);
+      };
+      if (std::find_if(asked.begin(), asked.end(), same) == asked.end()) {
+          asked.push_back(&dev);
+          plugin->RequestPowerStatus(dev);
       }
-
-      menutxt = num + menuitem.mMenuTitle;
-      Add(new cCECOsdItem(menuitem, menutxt.c_str(), plugin));
-      mMenuItems.push_back(menuitem);
-      cnt++;
   }
 }
 
+/**
+ * @brief Updates the device states of all items from the cached bus state.
+ *
+ * Only copies the cache, the CEC bus is never accessed.
+ */
+void cCECOsd::Refresh()
+{
+    vector<cCECBusSnapshot> snapshots;
+    bool changed = false;
+
+    for (cOsdItem *item = First(); item; item = Next(item)) {
+        cCECOsdItem *cecitem = (cCECOsdItem *)item;
+        size_t adapter = cecitem->GetDevice().mAdapter;
+        while (snapshots.size() <= adapter) {
+            snapshots.emplace_back();
+            mPlugin->GetBusSnapshot(snapshots.size() - 1, snapshots.back());
+        }
+        changed |= cecitem->Update(snapshots[adapter]);
+    }
+    if (changed) {
+        Display();
+    }
+}
+
+/**
+ * @brief Processes keys and shows changed device states.
+ *
+ * VDR calls this function regularly with kNone while the menu is open,
+ * so changes reported on the bus are shown without user interaction.
+ *
+ * @param key The pressed key
+ * @return State of the menu
+ */
+eOSState cCECOsd::ProcessKey(eKeys key)
+{
+    eOSState state = cOsdMenu::ProcessKey(key);
+    if (state == osUnknown) {
+        uint32_t gen = mPlugin->GetBusGeneration();
+        if (gen != mGeneration) {
+            mGeneration = gen;
+            Refresh();
+        }
+    }
+    return state;
+}
+
 /**
  * @brief Constructs an OSD menu item for a CEC device.
  *
- * @param menuitem Reference to the menu configuration
- * @param menutxt Display text for the menu item
+ * @param model Menu model, owned by the menu containing the item
+ * @param index Index of the entry in the model
  * @param plugin Pointer to the parent plugin instance
  */
-cCECOsdItem::cCECOsdItem(const cCECMenu &menuitem, const char *menutxt,
+cCECOsdItem::cCECOsdItem(const cCECMenuModel *model, size_t index,
                          cPluginCecremote *plugin) :
-        cOsdItem(menutxt), mControl(NULL) {
-    mMenuItem = menuitem;
-    mPlugin = plugin;
-    Dsyslog("Menu %s", menutxt);
+        cOsdItem(model->mTexts[index].c_str()),
+        mPlugin(plugin),
+        mModel(model),
+        mMenuItem(model->mMenus[index]),
+        mText(model->mTexts[index]) {
+    Dsyslog("Menu %s", model->mTexts[index].c_str());
+}
+
+/**
+ * @brief Updates the displayed power state of the device.
+ *
+ * The logical address is taken from the configuration or looked up by
+ * the physical address reported on the bus.
+ *
+ * @param snapshot Cached state of the adapter of the device
+ * @return true if the text of the item has changed
+ */
+bool cCECOsdItem::Update(const cCECBusSnapshot &snapshot)
+{
+    if (!HasDevice()) {
+        return false;
+    }
+    const cCECDevice &dev = mMenuItem.mDevice;
+    int addr = dev.mLogicalAddressDefined;
+    if (dev.mPhysicalAddress != 0) {
+        for (int i = 0; i < cCECBusSnapshot::MAX_DEVICES; i++) {
+            if ((snapshot.mPhysicalAddress[i] == dev.mPhysicalAddress) &&
+                ((addr == CECDEVICE_UNKNOWN) || (addr == i))) {
+                addr = i;
+                break;
+            }
+        }
+    }
+
+    const char *state = "?";
+    mStateKnown = false;
+    if ((addr >= 0) && (addr < cCECBusSnapshot::MAX_DEVICES)) {
+        switch (snapshot.mPower[addr]) {
+        case CEC_POWER_STATUS_ON:
+        case CEC_POWER_STATUS_IN_TRANSITION_STANDBY_TO_ON:
+            state = (snapshot.mActiveSource == addr) ? tr("active") : tr("on");
+            mStateKnown = true;
+            break;
+        case CEC_POWER_STATUS_STANDBY:
+        case CEC_POWER_STATUS_IN_TRANSITION_ON_TO_STANDBY:
+            state = tr("standby");
+            mStateKnown = true;
+            break;
+        default:
+            break;
+        }
+    }
+    if (state == mState) {
+        return false;
+    }
+    mState = state;
+    SetText(cString::sprintf("%s\t%s", mText.c_str(), state));
+    return true;
 }
 
 /**
@@ -89,7 +215,7 @@ eOSState cCECOsdItem::ProcessKey(eKeys key) {
     }
     if ((key > k0) && (key <= k9)) {
         try {
-            mPlugin->StartPlayer(cCECOsd::mMenuItems.at(key-k1));
+            mPlugin->StartPlayer(mModel->mMenus.at(key-k1));
             state = osEnd;
         } catch (const std::out_of_range &oor) {
             Isyslog("StartPlayer Out of range");
@@ -14,21 +14,55 @@
 
 #include <vdr/menu.h>
 #include <vdr/plugin.h>
+#include <memory>
+#include <string>
+#include <vector>
 #include "ceccontrol.h"
 
 namespace cecplugin {
 
+/**
+ * @class cCECMenuModel
+ * @brief Immutable list of the configured menu entries.
+ *
+ * Built once when the configuration is loaded. The OSD menu references
+ * the entries instead of copying them, an open menu keeps its model
+ * alive if the configuration is loaded again.
+ */
+class cCECMenuModel {
+public:
+    std::vector<cCECMenu> mMenus;       ///< Configured menu entries
+    std::vector<std::string> mTexts;    ///< Display text incl. number shortcut
+
+    /**
+     * @brief Builds the model from the parsed menu list.
+     * @param menulist Menu entries of the configuration file.
+     */
+    explicit cCECMenuModel(const cCECMenuList &menulist);
+};
+
+typedef std::shared_ptr<const cCECMenuModel> cCECMenuModelPtr;
+
 /**
  * @class cCECOsd
  * @brief Main OSD menu displaying available CEC control options.
  *
  * Creates a menu with entries for each configured CEC device/action
- * from the XML configuration file.
+ * from the XML configuration file. Each entry shows the cached power
+ * state of its device, which is updated while the menu is open. The
+ * menu never waits for the CEC bus, devices without a known state are
+ * asked in the background when the menu is opened.
  */
 class cCECOsd : public cOsdMenu {
-public:
-    static std::vector<cCECMenu> mMenuItems;  ///< Static storage of menu items
+private:
+    cPluginCecremote *mPlugin;  ///< Parent plugin instance
+    cCECMenuModelPtr mModel;    ///< Menu entries shown by this menu
+    uint32_t mGeneration;       ///< Bus state generation shown
 
+    /** @brief Updates the device states of all items from the cache. */
+    void Refresh();
+
+public:
     /**
      * @brief Constructs the CEC OSD menu.
      * @param plugin Pointer to the parent plugin instance.
@@ -37,6 +71,13 @@ public:
 
     /** @brief Destructor. */
     virtual ~cCECOsd() {}
+
+    /**
+     * @brief Processes keys and refreshes changed device states.
+     * @param key The VDR key that was pressed (kNone while idle).
+     * @return State of the menu.
+     */
+    virtual eOSState ProcessKey(eKeys key);
 };
 
 /**
@@ -48,22 +89,53 @@ public:
  */
 class cCECOsdItem : public cOsdItem {
 private:
-    cCECControl *mControl;        ///< Associated control (for player mode)
-    cPluginCecremote *mPlugin;    ///< Parent plugin instance
-    cCECMenu mMenuItem;           ///< Menu configuration for this item
+    cPluginCecremote *mPlugin;     ///< Parent plugin instance
+    const cCECMenuModel *mModel;   ///< Model, owned by the menu
+    const cCECMenu &mMenuItem;     ///< Menu configuration for this item
+    const std::string &mText;      ///< Text without device state
+    const char *mState = nullptr;  ///< Displayed device state
+    bool mStateKnown = false;      ///< Power state of the device is cached
 
 public:
     /**
      * @brief Constructs a CEC OSD menu item.
-     * @param menuitem Menu configuration from XML.
-     * @param menutxt Display text for the menu item.
+     * @param model Menu model, must outlive the item.
+     * @param index Index of the entry in the model.
      * @param plugin Pointer to the parent plugin instance.
      */
-    cCECOsdItem(const cCECMenu &menuitem, const char *menutxt, cPluginCecremote *plugin);
+    cCECOsdItem(const cCECMenuModel *model, size_t index, cPluginCecremote *plugin);
 
     /** @brief Destructor. */
     ~cCECOsdItem() {}
 
+    /**
+     * @brief Updates the displayed device state.
+     * @param snapshot Cached state of the adapter of the device.
+     * @return true if the text has changed.
+     */
+    bool Update(const cCECBusSnapshot &snapshot);
+
+    /**
+     * @brief Gets the device of the menu entry.
+     * @return The device.
+     */
+    const cCECDevice &GetDevice() const { return mMenuItem.mDevice; }
+
+    /**
+     * @brief Checks if the menu entry has a device.
+     * @return true if a device is configured.
+     */
+    bool HasDevice() const {
+        return (mMenuItem.mDevice.mLogicalAddressDefined != CECDEVICE_UNKNOWN) ||
+               (mMenuItem.mDevice.mPhysicalAddress != 0);
+    }
+
+    /**
+     * @brief Checks if the power state of the device is cached.
+     * @return true if the state is known.
+     */
+    bool IsStateKnown() const { return mStateKnown; }
+
     /**
      * @brief Processes a key press on this menu item.
      * @param key The VDR key that was pressed.
@@ -12,15 +12,13 @@
 #include "cecremote.h"
 #include "ceclog.h"
 #include "cecremoteplugin.h"
-#include <sys/wait.h>
+#include "scriptrunner.h"
+#include "metrics.h"
+#include <string.h>
 #include <unistd.h>
-// close_range() requires glibc >= 2.34 and Linux >= 5.9
-#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
-#include <linux/close_range.h>
-#define HAVE_CLOSE_RANGE 1
-#endif
 // We need this for cecloader.h
 #include <iostream>
+#include <algorithm>
 #include <csignal>
 using namespace std;
 #include <cecloader.h>
@@ -39,25 +37,34 @@ const char *cCECRemote::VDRNAME = "VDR";
  *
  * @param cbParam Pointer to the cCECRemote instance
  * @param key Pointer to the received key press information
- * @note Thread-safe via static mutex for lastkey tracking.
+ * @note Thread-safe via the per adapter mutex for lastkey tracking.
  */
 static void CecKeyPressCallback(void *cbParam, const cec_keypress* key)
 {
-    static cec_user_control_code lastkey = CEC_USER_CONTROL_CODE_UNKNOWN;
-    static cMutex lastkeyMutex;  // Protect static lastkey from concurrent access
     cCECRemote *rem = (cCECRemote *)cbParam;
 
+    rem->CallbackThreadStarted();
+    CEC_PROBE3(key_received, rem->GetAdapterIndex(), key->keycode,
+               key->duration);
     Dsyslog("key pressed %02x (%d)", key->keycode, key->duration);
 
-    cMutexLock lock(&lastkeyMutex);
+    cMutexLock lock(&rem->mLastKeyMutex);
     if (
         ((key->keycode >= 0) && (key->keycode <= CEC_USER_CONTROL_CODE_MAX)) &&
-        ((key->duration == 0) || (key->keycode != lastkey))
+        ((key->duration == 0) || (key->keycode != rem->mLastKey))
        )
     {
-        lastkey = key->keycode;
+        rem->mLastKey = key->keycode;
+        cMetrics::Inc(cMetrics::KEYPRESSES);
         cCmd cmd(CEC_KEYRPRESS, (int)key->keycode);
+        cmd.mCecLogicalAddress =
+                (cec_logical_address)rem->mLastKeyInitiator.load();
         rem->PushCmd(cmd);
+
+        cCECBusEvent event;
+        event.mType = cCECBusEvent::KEY;
+        event.mValue = key->keycode;
+        rem->PublishEvent(event);
     }
 }
 
@@ -74,15 +81,72 @@ static void CecKeyPressCallback(void *cbParam, const cec_keypress* key)
 static void CecCommandCallback(void *cbParam, const cec_command *command)
 {
     cCECRemote *rem = (cCECRemote *)cbParam;
+    rem->CallbackThreadStarted();
     // Safety check: adapter may be disconnected during callback
     if (rem->mCECAdapter == nullptr) {
         Dsyslog("CEC Command ignored - adapter disconnected");
         return;
     }
+    cMetrics::Inc(cMetrics::FRAMES);
     Dsyslog("CEC Command %d : %s Init %d Dest %d", command->opcode,
                                    rem->mCECAdapter->ToString(command->opcode),
                                    command->initiator, command->destination);
+    cCECBusEvent event;
+    event.mType = cCECBusEvent::FRAME;
+    event.mInitiator = command->initiator;
+    event.mDestination = command->destination;
+    event.mOpcode = command->opcode;
+    event.mParamCount = command->parameters.size;
+    memcpy(event.mParams, command->parameters.data, command->parameters.size);
+    rem->PublishEvent(event);
+
+    // Keep the power status cache up to date
+    switch (command->opcode) {
+    case CEC_OPCODE_REPORT_POWER_STATUS:
+        if (command->parameters.size > 0) {
+            rem->UpdatePowerStatus(command->initiator,
+                    (cec_power_status)command->parameters.data[0]);
+        }
+        break;
+    case CEC_OPCODE_REPORT_PHYSICAL_ADDRESS:
+        if (command->parameters.size >= 2) {
+            rem->mBusState.SetPhysicalAddress(command->initiator,
+                    (command->parameters.data[0] << 8) |
+                     command->parameters.data[1]);
+        }
+        break;
+    case CEC_OPCODE_STANDBY:
+        rem->UpdatePowerStatus(command->initiator,
+                               CEC_POWER_STATUS_STANDBY);
+        rem->UpdateRouting(command);
+        break;
+    case CEC_OPCODE_ACTIVE_SOURCE:
+        rem->UpdatePowerStatus(command->initiator,
+                               CEC_POWER_STATUS_ON);
+        rem->UpdateRouting(command);
+        break;
+    case CEC_OPCODE_INACTIVE_SOURCE:
+    case CEC_OPCODE_ROUTING_CHANGE:
+    case CEC_OPCODE_ROUTING_INFORMATION:
+    case CEC_OPCODE_SET_STREAM_PATH:
+        rem->UpdateRouting(command);
+        break;
+    case CEC_OPCODE_IMAGE_VIEW_ON:
+    case CEC_OPCODE_TEXT_VIEW_ON:
+        rem->UpdatePowerStatus(command->initiator,
+                               CEC_POWER_STATUS_ON);
+        break;
+    case CEC_OPCODE_USER_CONTROL_PRESSED:
+        // cec_keypress has no initiator, remember the sender of the
+        // frame for the keymap lookup of the following key
+        rem->mLastKeyInitiator = command->initiator;
+        break;
+    default:
+        break;
+    }
     cCmd cmd(CEC_COMMAND, command->opcode, command->initiator);
+    cmd.mParams.assign(command->parameters.data,
+                       command->parameters.data + command->parameters.size);
     rem->PushCmd(cmd);
 }
 
@@ -102,6 +166,10 @@ static void CecAlertCallback(void *cbParam, const libcec_alert type,
 {
     cCECRemote *rem = (cCECRemote *)cbParam;
     Dsyslog("CecAlert %d", type);
+    cCECBusEvent event;
+    event.mType = cCECBusEvent::ALERT;
+    event.mValue = type;
+    rem->PublishEvent(event);
     switch (type)
     {
     case CEC_ALERT_CONNECTION_LOST:
@@ -181,8 +249,9 @@ static void CecLogMessageCallback(void *cbParam, const cec_log_message *message)
 /**
  * @brief Callback function for libCEC source activation events.
  *
- * Called by libCEC when a device is activated as the active source.
- * Currently used for verbose debug logging only.
+ * Called by libCEC when VDR is activated or deactivated as the active
+ * source. Updates the routing state, as libCEC does not report the
+ * frames sent by VDR itself.
  *
  * @param cbParam Pointer to the cCECRemote instance
  * @param address Logical address of the activated device
@@ -192,7 +261,9 @@ static void CECSourceActivatedCallback (void *cbParam,
                                         const cec_logical_address address,
                                         const uint8_t activated)
 {
+    cCECRemote *rem = (cCECRemote *)cbParam;
     Csyslog("CECSourceActivatedCallback address %d activated %d", address, activated);
+    rem->SourceActivated(address, activated != 0);
 }
 
 /**
@@ -226,32 +297,53 @@ void cCECRemote::Action(void)
     cCECList ceckmap;
     cec_logical_address addr;
 
+    mWorkerTid = cThread::ThreadId();
+    cTracer::ThreadName("CEC worker " + mAdapterId);
+    if (mScheduling.IsSet()) {
+        mScheduling.Apply("CEC receiver");
+    }
     // Allow some delay before the first connection to the CEC Adapter.
     if (mStartupDelay > 0) {
+        mStartupTiming.Begin(cStartupTiming::STARTUPDELAY);
         sleep(mStartupDelay);
+        mStartupTiming.End(cStartupTiming::STARTUPDELAY);
     }
     Connect();
 
     Dsyslog("cCECRemote start worker thread");
     while (Running()) {
         cmd = WaitCmd();
+        CEC_PROBE3(cmd_dequeue, mAdapterIndex, cmd.mCmd, cmd.mSerial);
         Dsyslog ("(%d) Action %d Val %d Phys Addr %d Logical %04x %04x Op %d",
                  cmd.mSerial,
                  cmd.mCmd, cmd.mVal, cmd.mDevice.mPhysicalAddress,
                  cmd.mDevice.mLogicalAddressDefined,
                  cmd.mDevice.mLogicalAddressUsed,
                  cmd.mCecOpcode);
+        if (SkipAfterDeadline(cmd)) {
+            if (cmd.mSerial != -1) {
+                mProcessedSerial = cmd.mSerial;
+                mCmdReady.Signal();
+            }
+            continue;
+        }
+        uint64_t startUs = cMetrics::NowUs();
         switch (cmd.mCmd)
         {
         case CEC_KEYRPRESS:
-            if ((cmd.mVal >= 0) && (cmd.mVal <= CEC_USER_CONTROL_CODE_MAX)) {
-                Isyslog("Key Press %d", cmd.mVal);
-                const cKeyList &inputKeys =
-                        mPlugin->mKeyMaps.CECtoVDRKey((cec_user_control_code)cmd.mVal);
-                cKeyListIterator ikeys;
-                for (const auto k : inputKeys) {
-                    Put(k);
-                    Dsyslog ("   Put(%d)", k);
+            // VDR is not ready for keys before Start()
+            if (!mStarted) {
+                Dsyslog("Key Press %d ignored during startup", cmd.mVal);
+            }
+            else if ((cmd.mVal >= 0) && (cmd.mVal <= CEC_USER_CONTROL_CODE_MAX)) {
+                Isyslog("Key Press %d from %d", cmd.mVal, cmd.mCecLogicalAddress);
+                eKeys inputKeys[cKeyMaps::MAXKEYS];
+                int count = mPlugin->mKeyMaps.CECtoVDRKey(
+                        (cec_user_control_code)cmd.mVal,
+                        cmd.mCecLogicalAddress, inputKeys);
+                for (int i = 0; i < count; i++) {
+                    Put(inputKeys[i]);
+                    Dsyslog ("   Put(%d)", inputKeys[i]);
                 }
             }
             break;
@@ -259,8 +351,13 @@ void cCECRemote::Action(void)
             if (mCECAdapter != nullptr) {
                 Isyslog("Power on");
                 addr = getLogical(cmd.mDevice);
-                if ((addr != CECDEVICE_UNKNOWN) &&
-                    (!mCECAdapter->PowerOnDevices(addr))) {
+                bool ok = false;
+                if (addr != CECDEVICE_UNKNOWN) {
+                    cLibCECCall call(this, "PowerOnDevices");
+                    ok = cMetrics::Transmitted(
+                            mCECAdapter->PowerOnDevices(addr));
+                }
+                if ((addr != CECDEVICE_UNKNOWN) && !ok) {
                     Esyslog("PowerOnDevice failed for %s",
                             mCECAdapter->ToString(addr));
                 }
@@ -276,8 +373,13 @@ void cCECRemote::Action(void)
             if (mCECAdapter != nullptr) {
                 Isyslog("Power off");
                 addr = getLogical(cmd.mDevice);
-                if ((addr != CECDEVICE_UNKNOWN) &&
-                    (!mCECAdapter->StandbyDevices(addr))) {
+                bool ok = false;
+                if (addr != CECDEVICE_UNKNOWN) {
+                    cLibCECCall call(this, "StandbyDevices");
+                    ok = cMetrics::Transmitted(
+                            mCECAdapter->StandbyDevices(addr));
+                }
+                if ((addr != CECDEVICE_UNKNOWN) && !ok) {
                     Esyslog("StandbyDevices failed for %s",
                             mCECAdapter->ToString(addr));
                 }
@@ -305,10 +407,7 @@ void cCECRemote::Action(void)
             break;
         case CEC_MAKEACTIVE:
             if (mCECAdapter != nullptr) {
-                Isyslog ("Make active");
-                if (!mCECAdapter->SetActiveSource()) {
-                    Esyslog("SetActiveSource failed");
-                }
+                ActionMakeActive();
             }
             else {
                 Esyslog("SetActiveSource ignored");
@@ -316,10 +415,7 @@ void cCECRemote::Action(void)
             break;
         case CEC_MAKEINACTIVE:
             if (mCECAdapter != nullptr) {
-                Isyslog ("Make inactive");
-                if (!mCECAdapter->SetInactiveView()) {
-                    Esyslog("SetInactiveView failed");
-                }
+                ActionMakeInactive();
             }
             else {
                 Esyslog("SetInactiveView ignored");
@@ -333,17 +429,79 @@ void cCECRemote::Action(void)
                 Esyslog("Keypress ignored");
             }
             break;
+        case CEC_GLOBALKEYPRESS:
+            if (mCECAdapter != nullptr) {
+                ActionGlobalKeyPress(cmd);
+            }
+            else {
+                Esyslog("Global keypress ignored");
+            }
+            break;
+        case CEC_WAITPOWER:
+            if (mCECAdapter != nullptr) {
+                addr = getLogical(cmd.mDevice);
+                if (addr != CECDEVICE_UNKNOWN) {
+                    WaitForPowerStatus(addr, (cec_power_status)cmd.mVal,
+                                       cmd.mTimeoutMs);
+                }
+            }
+            else {
+                Esyslog("Waitpower ignored");
+            }
+            break;
+        case CEC_DELAY:
+            Dsyslog("Delay %d ms", cmd.mVal);
+            cCondWait::SleepMs(StopBudget(cmd.mVal));
+            break;
+        case CEC_SEND:
+            if (mCECAdapter != nullptr) {
+                ActionSend(cmd);
+            }
+            else {
+                Esyslog("Send ignored");
+            }
+            break;
+        case CEC_IF:
+            ActionIf(cmd);
+            break;
+        case CEC_KEYMAP:
+            ActionKeymap(cmd);
+            break;
+        case CEC_STANDBYGROUP:
+            if (mCECAdapter != nullptr) {
+                ActionStandbyGroup(cmd);
+            }
+            else {
+                Esyslog("StandbyDevices ignored");
+            }
+            break;
+        case CEC_ROUTE:
+            if (mCECAdapter != nullptr) {
+                ActionRoute(cmd);
+            }
+            else {
+                Esyslog("Route ignored");
+            }
+            break;
         case CEC_EXECSHELL:
             Isyslog ("Exec: %s", cmd.mExec.c_str());
             Exec(cmd);
             break;
         case CEC_EXIT:
             Isyslog("cCECRemote exit worker thread");
+            if (!mStopSkipped.empty()) {
+                Esyslog("Adapter %s: %d commands not completed at shutdown",
+                        mAdapterId.c_str(), (int)mStopSkipped.size());
+                for (const std::string &s : mStopSkipped) {
+                    Esyslog("   %s", s.c_str());
+                }
+            }
             Cancel(-1);
             Disconnect();
             break;
         case CEC_RECONNECT:
             Isyslog("cCECRemote reconnect");
+            cMetrics::Inc(cMetrics::RECONNECTS);
             Disconnect();
             sleep(1);
             Connect();
@@ -364,10 +522,24 @@ void cCECRemote::Action(void)
             Isyslog("cCECRemote exec_toggle");
             ExecToggle(cmd.mDevice, cmd.mPoweron, cmd.mPoweroff);
             break;
+        case CEC_SOURCECHANGED:
+            ActionSourceChanged(cmd);
+            break;
         default:
             Esyslog("Unknown action %d Val %d", cmd.mCmd, cmd.mVal);
             break;
         }
+        uint64_t durUs = cMetrics::NowUs() - startUs;
+        cMetrics::Command(cmd.mCmd, durUs);
+        CEC_PROBE4(cmd_done, mAdapterIndex, cmd.mCmd, cmd.mSerial, durUs);
+        CheckStartupDone(cmd);
+        cTracer::Complete("worker", cMetrics::CommandName(cmd.mCmd + 1),
+                          startUs, durUs, cmd.mSerial);
+        // The watchdog closed the adapter while a call hung
+        if (mStalled) {
+            RecoverAdapter();
+        }
+        mPlugin->StatusChanged();
         Csyslog ("(%d) Action finished", cmd.mSerial);
         if (cmd.mSerial != -1) {
             mProcessedSerial = cmd.mSerial;
@@ -386,52 +558,135 @@ void cCECRemote::Action(void)
  *
  * @param options Global CEC configuration options from the XML config file
  * @param plugin Pointer to the parent plugin instance
+ * @param adapter Index of the adapter in the options adapter list
  */
-cCECRemote::cCECRemote(const cCECGlobalOptions &options, cPluginCecremote *plugin):
+cCECRemote::cCECRemote(const cCECGlobalOptions &options, cPluginCecremote *plugin,
+                       int adapter):
         cRemote("CEC"),
         cThread("CEC receiver"),
         mPlugin(plugin)
 {
-    mHDMIPort = options.mHDMIPort;
-    mBaseDevice = options.mBaseDevice;
+    mStartupTiming.Begin(cStartupTiming::CONSTRUCT);
+    const cCECAdapterOptions &adapteroptions = options.mAdapters.at(adapter);
+    mAdapterIndex = adapter;
+    mAdapterId = adapteroptions.mId;
+    mAdapterPort = adapteroptions.mPort;
+    mHDMIPort = adapteroptions.mHDMIPort;
+    mBaseDevice = adapteroptions.mBaseDevice;
+    mPhysAddress = adapteroptions.mPhysicalAddress;
     mCECLogLevel = options.cec_debug;
-    mOnStart = options.mOnStart;
-    mOnStop = options.mOnStop;
-    mOnVolumeUp = options.mOnVolumeUp;
-    mOnVolumeDown = options.mOnVolumeDown;
-    mOnManualStart = options.mOnManualStart;
+    FilterAdapter(options.mOnStart, mOnStart);
+    FilterAdapter(options.mOnStop, mOnStop);
+    FilterAdapter(options.mOnVolumeUp, mOnVolumeUp);
+    FilterAdapter(options.mOnVolumeDown, mOnVolumeDown);
+    FilterAdapter(options.mOnManualStart, mOnManualStart);
     mComboKeyTimeoutMs = options.mComboKeyTimeoutMs;
     mDeviceTypes = options.mDeviceTypes;
     mShutdownOnStandby = options.mShutdownOnStandby;
     mPowerOffOnStandby = options.mPowerOffOnStandby;
     mStartupDelay = options.mStartupDelay;
-    mPhysAddress = options.mPhysicalAddress;
-    SetDescription("CEC Thread");
+    mScheduling = options.mThreadScheduling;
+    SetDescription("CEC Thread %s", mAdapterId.c_str());
+    mStartupTiming.End(cStartupTiming::CONSTRUCT);
+}
+
+/**
+ * @brief Copies all commands of a queue which are routed to this adapter.
+ *
+ * @param in Command queue from the global configuration
+ * @param out Command queue receiving the commands for this adapter
+ */
+void cCECRemote::FilterAdapter(const cCmdQueue &in, cCmdQueue &out)
+{
+    out.clear();
+    for (const cCmd &cmd : in) {
+        if (cmd.mDevice.mAdapter == mAdapterIndex) {
+            out.push_back(cmd);
+        }
+    }
 }
 
 /**
  * @brief Starts the CEC remote worker thread and executes startup commands.
  *
  * Starts the background worker thread and executes configured startup
- * command queues. If the CEC adapter is not yet connected (deferred
- * startup), the startup commands will be executed after connection.
+ * command queues. If the CEC adapter is not yet connected, the startup
+ * commands are queued by Connect() after the adapter is open.
  */
 void cCECRemote::Startup()
 {
-    Start();
+    mStarted = true;
+    {
+        cMutexLock lock(&mPendingStartupMutex);
+        // With <earlyconnect> <onmanualstart> is already pending or queued
+        if (!mEarlyStartup && mPlugin->GetStartManually()) {
+            mPendingManualStart = true;
+        }
+        mPendingStart = true;
+    }
+    if (mEarlyStartup) {
+        Csyslog("cCECRemote Startup after early connect");
+    }
+    else {
+        Csyslog("cCECRemote Init");
+        Start();
+    }
+    QueuePendingStartup(false);
+}
 
-    Csyslog("cCECRemote Init");
+/**
+ * @brief Opens the CEC adapter while VDR is still starting up.
+ *
+ * The worker thread connects in the background while the other plugins
+ * are initialized. The <onmanualstart> commands are queued as soon as the
+ * adapter is open; <onstart> follows in Startup().
+ */
+void cCECRemote::EarlyStartup()
+{
+    Csyslog("cCECRemote Early Startup");
+    mEarlyStartup = true;
+    if (mPlugin->GetStartManually()) {
+        cMutexLock lock(&mPendingStartupMutex);
+        mPendingManualStart = true;
+    }
+    Start();
+}
 
-    if (mCECAdapter == nullptr) {
+/**
+ * @brief Queues the pending startup command lists.
+ *
+ * Called by Startup() and EarlyStartup(), and by the worker at the end of
+ * Connect(). The lists are queued only after the first successful open of
+ * the adapter, so they are not dropped while the adapter is still opening
+ * during the <startupdelay>. Each list is queued once.
+ *
+ * @param connected true if called by Connect() after a successful open
+ */
+void cCECRemote::QueuePendingStartup(bool connected)
+{
+    cMutexLock lock(&mPendingStartupMutex);
+    if (connected) {
+        mAdapterOpened = true;
+    }
+    if (!mAdapterOpened) {
         Csyslog("cCECRemote Delayed Startup");
-        mDeferredStartup = true;
+        return;
     }
-    else {
-        Csyslog("cCECRemote Startup");
-        if (mPlugin->GetStartManually()) {
-            PushCmdQueue(mOnManualStart);
+    if (mPendingManualStart) {
+        mPendingManualStart = false;
+        Isyslog("Queue <onmanualstart> with %zu commands", mOnManualStart.size());
+        cCECEvent event("manualstart");
+        PushCmdQueue(mOnManualStart, &event);
+    }
+    if (mPendingStart) {
+        mPendingStart = false;
+        Isyslog("Queue <onstart> with %zu commands", mOnStart.size());
+        cCECEvent event("start");
+        mStartupTiming.Begin(cStartupTiming::ONSTART);
+        PushCmdQueue(mOnStart, &event);
+        if (mOnStart.empty()) {
+            FinishStartupTiming();
         }
-        PushCmdQueue(mOnStart);
     }
 }
 
@@ -439,8 +694,8 @@ void cCECRemote::Startup()
  * @brief Connects to the CEC adapter and initializes libCEC.
  *
  * Sets up CEC callbacks, configuration, and attempts to open the
- * first detected CEC adapter. Scans for active CEC devices on the
- * bus and logs their information.
+ * detected CEC adapter configured for this instance. Scans for active
+ * CEC devices on the bus and logs their information.
  *
  * @note Safe to call multiple times; returns immediately if already connected.
  */
@@ -490,39 +745,73 @@ void cCECRemote::Connect()
     mCECConfig.callbackParam = this;
     mCECConfig.callbacks = &mCECCallbacks;
     // Initialize libcec
-    mCECAdapter = LibCecInitialise(&mCECConfig);
+    mStartupTiming.Begin(cStartupTiming::LIBCECINIT);
+    {
+        cMutexLock lock(&mAdapterMutex);
+        mCECAdapter = LibCecInitialise(&mCECConfig);
+    }
+    mStartupTiming.End(cStartupTiming::LIBCECINIT);
     if (mCECAdapter == nullptr) {
         Esyslog("Can not initialize libcec");
         return;
     }
     // init video on targets that need this
+    mStartupTiming.Begin(cStartupTiming::INITVIDEO);
     mCECAdapter->InitVideoStandalone();
+    mStartupTiming.End(cStartupTiming::INITVIDEO);
     Dsyslog("LibCEC %s", mCECAdapter->GetLibInfo());
 
+    mStartupTiming.Begin(cStartupTiming::DETECT);
     mDevicesFound = mCECAdapter->DetectAdapters(mCECAdapterDescription,
                                                 MAX_CEC_ADAPTERS, nullptr, true);
+    mStartupTiming.End(cStartupTiming::DETECT);
     if (mDevicesFound <= 0)
     {
         Esyslog("No adapter found");
-        UnloadLibCec(mCECAdapter);
-        mCECAdapter = nullptr;
+        UnloadAdapter();
         mDevicesFound = 0;
         return;
     }
 
+    // Without a configured port the n-th adapter is used for the n-th
+    // <adapter> definition.
+    mDescriptorIndex = -1;
     for (int i = 0; i < mDevicesFound; i++)
     {
         Dsyslog("Device %d path: %s port: %s", i,
                 mCECAdapterDescription[i].strComPath,
                 mCECAdapterDescription[i].strComName);
+        if (mAdapterPort.empty()) {
+            if (i == mAdapterIndex) {
+                mDescriptorIndex = i;
+            }
+        }
+        else if ((mAdapterPort == mCECAdapterDescription[i].strComName) ||
+                 (mAdapterPort == mCECAdapterDescription[i].strComPath)) {
+            mDescriptorIndex = i;
+        }
+    }
+    if (mDescriptorIndex < 0)
+    {
+        Esyslog("No adapter found for %s", mAdapterId.c_str());
+        UnloadAdapter();
+        mDevicesFound = 0;
+        return;
     }
 
-    if (!mCECAdapter->Open(mCECAdapterDescription[0].strComName, 5000))
+    bool opened;
+    mStartupTiming.Begin(cStartupTiming::OPEN);
+    {
+        cLibCECCall call(this, "Open");
+        opened = mCECAdapter->Open(
+                mCECAdapterDescription[mDescriptorIndex].strComName, 5000);
+    }
+    mStartupTiming.End(cStartupTiming::OPEN);
+    if (!opened)
     {
         Esyslog("Unable to open the device on port %s",
-                mCECAdapterDescription[0].strComName);
-        UnloadLibCec(mCECAdapter);
-        mCECAdapter = nullptr;
+                mCECAdapterDescription[mDescriptorIndex].strComName);
+        UnloadAdapter();
         mDevicesFound = 0;
         return;
     }
@@ -530,10 +819,13 @@ void cCECRemote::Connect()
 
     if (mPhysAddress != 0) {
         Dsyslog("Set new physical address %d", mPhysAddress);
+        mStartupTiming.Begin(cStartupTiming::PHYSADDR);
         if (!mCECAdapter->SetPhysicalAddress(mPhysAddress)) {
             Esyslog("Unable to set new physical address %d", mPhysAddress);
         }
+        mStartupTiming.End(cStartupTiming::PHYSADDR);
     }
+    mStartupTiming.Begin(cStartupTiming::DEVICES);
     cec_logical_addresses devices = mCECAdapter->GetActiveDevices();
     for (int j = 0; j < 16; j++)
     {
@@ -542,6 +834,7 @@ void cCECRemote::Connect()
             cec_logical_address logical_addres = (cec_logical_address) j;
 
             uint16_t phaddr = mCECAdapter->GetDevicePhysicalAddress(logical_addres);
+            mBusState.SetPhysicalAddress(logical_addres, phaddr);
 
             cec_vendor_id vendor = (cec_vendor_id)mCECAdapter->GetDeviceVendorId(logical_addres);
             string name = mCECAdapter->GetDeviceOSDName(logical_addres);
@@ -550,12 +843,10 @@ void cCECRemote::Connect()
                     phaddr, name.c_str(), mCECAdapter->ToString(vendor));
         }
     }
+    mStartupTiming.End(cStartupTiming::DEVICES);
     Csyslog("END cCECRemote::Initialize");
 
-    if (mDeferredStartup) {
-        mDeferredStartup = false;
-        Startup();
-    }
+    QueuePendingStartup(true);
 }
 
 /**
@@ -567,28 +858,149 @@ void cCECRemote::Connect()
 void cCECRemote::Disconnect()
 {
     if (mCECAdapter != nullptr) {
+        cLibCECCall call(this, "Close");
         mCECAdapter->SetInactiveView();
         mCECAdapter->Close();
-        UnloadLibCec(mCECAdapter);
     }
-    mCECAdapter = nullptr;
+    UnloadAdapter();
+    mBusState.Clear();
     Dsyslog("cCECRemote::Disconnect");
 }
 
 /**
- * @brief Gracefully stops the CEC remote handler.
+ * @brief Unloads libCEC and clears the adapter pointer.
  *
- * Executes the configured onStop command queue and sends an exit
- * command to the worker thread, waiting for it to complete.
+ * All unloads of the worker go through here. The watchdog closes a
+ * stalled adapter with mAdapterMutex locked, so the adapter can not be
+ * unloaded while it is closed.
  */
-void cCECRemote::Stop()
+void cCECRemote::UnloadAdapter()
+{
+    cMutexLock lock(&mAdapterMutex);
+    if (mCECAdapter != nullptr) {
+        UnloadLibCec(mCECAdapter);
+        mCECAdapter = nullptr;
+    }
+}
+
+/**
+ * @brief Queues the shutdown of the CEC remote handler.
+ *
+ * Queues the planned <onstop> commands and the exit command, without
+ * waiting. From now on all waits of the worker are limited by the
+ * deadline, and commands still pending at the deadline are skipped.
+ *
+ * @param deadline Time (cTimeMs::Now()) the shutdown must be done
+ */
+void cCECRemote::BeginStop(uint64_t deadline)
 {
     Dsyslog("Executing onStop");
-    PushCmdQueue(mOnStop);
+    mStopDeadline = deadline;
+    cCmdQueue plan;
+    PlanStop(mOnStop, plan);
+    cCECEvent event("stop");
+    PushCmdQueue(plan, &event);
     // Send exit command to worker thread
     cCmd cmd(CEC_EXIT);
-    PushWaitCmd(cmd);
+    cmd.mSerial = cmd.getSerial();
+    mExitSerial = cmd.mSerial;
+    PushCmd(cmd);
+}
+
+/**
+ * @brief Waits until the worker processed the exit command.
+ *
+ * @param deadline Latest time to wait for
+ * @return false if the worker did not finish in time
+ */
+bool cCECRemote::WaitStopped(uint64_t deadline)
+{
+    while (mProcessedSerial.load() != mExitSerial.load()) {
+        if (!Active()) {
+            return true;
+        }
+        uint64_t now = cTimeMs::Now();
+        if (now >= deadline) {
+            Esyslog("Adapter %s: shutdown not finished in time",
+                    mAdapterId.c_str());
+            return false;
+        }
+        mCmdReady.Wait(std::min<uint64_t>(deadline - now, 100));
+    }
     Csyslog("onStop OK");
+    return true;
+}
+
+/**
+ * @brief Builds the shutdown plan from the <onstop> commands.
+ *
+ * @param in <onstop> commands
+ * @param out Receives the planned commands
+ */
+void cCECRemote::PlanStop(const cCmdQueue &in, cCmdQueue &out)
+{
+    out.clear();
+    for (const cCmd &cmd : in) {
+        if (cmd.mCmd != CEC_POWEROFF) {
+            out.push_back(cmd);
+        }
+        else if (!out.empty() && (out.back().mCmd == CEC_STANDBYGROUP)) {
+            out.back().mPoweroff.push_back(cmd);
+        }
+        else {
+            cCmd group(CEC_STANDBYGROUP);
+            group.mDevice = cmd.mDevice;
+            group.mPoweroff.push_back(cmd);
+            out.push_back(group);
+        }
+    }
+}
+
+/**
+ * @brief Limits a timeout to the time left until the shutdown deadline.
+ *
+ * @param timeoutMs Timeout in ms, <= 0 for none
+ * @return timeoutMs, or the remaining time (at least 1 ms) during shutdown
+ */
+int cCECRemote::StopBudget(int timeoutMs)
+{
+    uint64_t deadline = mStopDeadline.load();
+    if (deadline == 0) {
+        return timeoutMs;
+    }
+    uint64_t now = cTimeMs::Now();
+    int remaining = (deadline > now) ? (int)(deadline - now) : 1;
+    if ((timeoutMs <= 0) || (timeoutMs > remaining)) {
+        return remaining;
+    }
+    return timeoutMs;
+}
+
+/**
+ * @brief Skips a command if the shutdown deadline has passed.
+ *
+ * The exit command is always executed. Skipped commands are collected
+ * and reported when the worker exits.
+ *
+ * @param cmd Command to execute next
+ * @return true if the command must not be executed
+ */
+bool cCECRemote::SkipAfterDeadline(const cCmd &cmd)
+{
+    uint64_t deadline = mStopDeadline.load();
+    if ((deadline == 0) || (cmd.mCmd == CEC_EXIT) ||
+        (cTimeMs::Now() < deadline)) {
+        return false;
+    }
+    if (cmd.mCmd == CEC_EXECSHELL) {
+        mStopSkipped.push_back("exec " + cmd.mExec);
+    }
+    else {
+        mStopSkipped.push_back(*cString::sprintf("action %d device %04x/%d",
+                               cmd.mCmd, cmd.mDevice.mPhysicalAddress,
+                               cmd.mDevice.mLogicalAddressDefined));
+    }
+    return true;
 }
 
 /**
@@ -636,7 +1048,8 @@ int cCECRemote::GetExecQueueSize()
  */
 cString cCECRemote::ListDevices()
 {
-    cString s = "Available CEC Devices:";
+    cString s = cString::sprintf("Adapter %s\nAvailable CEC Devices:",
+                                 mAdapterId.c_str());
     uint16_t phaddr;
     string name;
     cec_vendor_id vendor;
@@ -644,17 +1057,18 @@ cString cCECRemote::ListDevices()
 
     if (mCECAdapter == nullptr) {
         Esyslog ("ListDevices CEC Adapter disconnected");
-        s = "CEC Adapter disconnected";
+        s = cString::sprintf("Adapter %s\nCEC Adapter disconnected",
+                             mAdapterId.c_str());
         return s;
     }
 
     for (int i = 0; i < mDevicesFound; i++)
     {
-        s = cString::sprintf("%s\n  Device %d path: %s port: %s Firmware %04d",
-                             *s, i,
-                             mCECAdapterDescription[0].strComPath,
-                             mCECAdapterDescription[0].strComName,
-                             mCECAdapterDescription[0].iFirmwareVersion);
+        s = cString::sprintf("%s\n  %c Device %d path: %s port: %s Firmware %04d",
+                             *s, (i == mDescriptorIndex) ? '*' : ' ', i,
+                             mCECAdapterDescription[i].strComPath,
+                             mCECAdapterDescription[i].strComName,
+                             mCECAdapterDescription[i].iFirmwareVersion);
     }
 
     s = cString::sprintf("%s\n\nActive Devices:", *s);
@@ -693,11 +1107,51 @@ cString cCECRemote::ListDevices()
     return s;
 }
 
+/**
+ * @brief Lists the HDMI tree for SVDRP.
+ *
+ * Every device is listed with its physical address, indented by its
+ * depth in the tree, and the nearest device upstream.
+ *
+ * @return cString containing the topology
+ */
+cString cCECRemote::ListTopology()
+{
+    cCECBusSnapshot snapshot;
+    std::vector<std::pair<uint16_t, int> > nodes;
+
+    mBusState.GetSnapshot(snapshot);
+    for (int i = CECDEVICE_TV; i < CECDEVICE_BROADCAST; i++) {
+        if (snapshot.mPhysicalAddress[i] != cCECBusSnapshot::PHYSICAL_UNKNOWN) {
+            nodes.push_back(std::make_pair(snapshot.mPhysicalAddress[i], i));
+        }
+    }
+    // Sorting by physical address lists every device after its switch
+    std::sort(nodes.begin(), nodes.end());
+
+    cString s = cString::sprintf("Adapter %s\nTopology:", mAdapterId.c_str());
+    for (const std::pair<uint16_t, int> &n : nodes) {
+        uint16_t ph = n.first;
+        cec_logical_address up = mBusState.FindUpstream(ph);
+        cString upstream = (up == CECDEVICE_UNKNOWN) ? cString("-") :
+                           cString::sprintf("%d", up);
+        s = cString::sprintf("%s\n  %*s%d.%d.%d.%d Logical %d Upstream %s%s",
+                             *s, 2 * cCECBusState::Depth(ph), "",
+                             (ph >> 12) & 0xF, (ph >> 8) & 0xF,
+                             (ph >> 4) & 0xF, ph & 0xF, n.second, *upstream,
+                             (ph == snapshot.mActiveSourcePhysical) ?
+                             " (active)" : "");
+    }
+    return s;
+}
+
 /**
  * @brief Resolves a device to its logical CEC address.
  *
  * Attempts to find the logical address for a device, using physical
  * address mapping first, then falling back to configured logical address.
+ * Only if no logical address is configured, the nearest device connected
+ * behind the physical address is used (see cCECBusState::FindDownstream).
  * Verifies that the resolved address is not the VDR's own address.
  *
  * @param dev Reference to the device structure (may be modified with found logical address)
@@ -724,8 +1178,10 @@ cec_logical_address cCECRemote::getLogical(cCECDevice &dev)
             if (devices[j])
             {
                 cec_logical_address logical_addres = (cec_logical_address)j;
-                if (dev.mPhysicalAddress ==
-                        mCECAdapter->GetDevicePhysicalAddress(logical_addres)) {
+                uint16_t phaddr =
+                        mCECAdapter->GetDevicePhysicalAddress(logical_addres);
+                mBusState.SetPhysicalAddress(logical_addres, phaddr);
+                if (dev.mPhysicalAddress == phaddr) {
                     dev.mLogicalAddressUsed = logical_addres;
                     Dsyslog ("Mapping Physical %04x->Logical %d",
                             dev.mPhysicalAddress, logical_addres);
@@ -741,23 +1197,34 @@ cec_logical_address cCECRemote::getLogical(cCECDevice &dev)
     if (found != CECDEVICE_UNKNOWN) {
         return found;
     }
+    cec_logical_addresses own = mCECAdapter->GetLogicalAddresses();
 
-    // No mapping available, so try as last attempt the defined logical address,
-    // if available.
+    // No device at the physical address and no logical address configured,
+    // so the address may be a port with an AVR or switch in between. Use
+    // the nearest device behind it.
     if (dev.mLogicalAddressDefined == CECDEVICE_UNKNOWN) {
+        if (dev.mPhysicalAddress != 0) {
+            found = mBusState.FindDownstream(dev.mPhysicalAddress);
+            if ((found != CECDEVICE_UNKNOWN) && !own[found]) {
+                Dsyslog ("Mapping Port %04x->Logical %d",
+                        dev.mPhysicalAddress, found);
+                dev.mLogicalAddressUsed = found;
+                return found;
+            }
+        }
         Esyslog("No fallback logical address for %04x configured", dev.mPhysicalAddress);
         return CECDEVICE_UNKNOWN;
     }
-    // Ensure that we don't send accidentally to the own VDR address.
-
-    cec_logical_addresses own = mCECAdapter->GetLogicalAddresses();
+    // No mapping available, so try as last attempt the defined logical
+    // address. Ensure that we don't send accidentally to the own VDR address.
     if (own[dev.mLogicalAddressDefined]) {
         Esyslog("Logical address of physical %04x is the VDR", dev.mPhysicalAddress);
         return CECDEVICE_UNKNOWN;
     }
     // Check if device is available.
+    cLibCECCall call(this, "PollDevice");
     if (!mCECAdapter->PollDevice(dev.mLogicalAddressDefined)) {
-        Esyslog("Logical address not available", dev.mLogicalAddressDefined);
+        Esyslog("Logical address %d not available", dev.mLogicalAddressDefined);
         return CECDEVICE_UNKNOWN;
     }
 
@@ -769,31 +1236,404 @@ cec_logical_address cCECRemote::getLogical(cCECDevice &dev)
 /**
  * @brief Waits for a device to reach a specific power status.
  *
- * Polls the device power status at 100ms intervals until the
- * expected status is reached or a timeout occurs.
+ * Returns at once if the device already reported the status, otherwise
+ * polls the device power status at 100ms intervals until the expected
+ * status is reached or the timeout occurs.
  *
  * @param addr Logical address of the device to monitor
  * @param newstatus The expected power status to wait for
+ * @param timeout Maximum wait time in milliseconds
  */
-void cCECRemote::WaitForPowerStatus(cec_logical_address addr, cec_power_status newstatus)
+void cCECRemote::WaitForPowerStatus(cec_logical_address addr, cec_power_status newstatus,
+                                    int timeout)
 {
     cec_power_status status;
-    int cnt = 0;
+    cTimeMs t(StopBudget(timeout));
     cCondWait w;
+    cTraceSpan span("worker", "WaitForPowerStatus", addr);
 
+    // Device already reported the requested status
+    if (mBusState.GetPowerStatus(addr, status) && (status == newstatus)) {
+        return;
+    }
     do {
         w.Wait(100);
+        {
+            cLibCECCall call(this, "GetDevicePowerStatus");
+            status = mCECAdapter->GetDevicePowerStatus(addr);
+        }
+        UpdatePowerStatus(addr, status);
+    } while ((status != newstatus) && !t.TimedOut() && (status != CEC_POWER_STATUS_UNKNOWN));
+}
+
+/**
+ * @brief Stores a power status in the cache and publishes changes.
+ *
+ * @param addr Logical address of the device
+ * @param status Reported power status
+ */
+void cCECRemote::UpdatePowerStatus(cec_logical_address addr,
+                                   cec_power_status status)
+{
+    if (mBusState.SetPowerStatus(addr, status)) {
+        cCECBusEvent event;
+        event.mType = cCECBusEvent::POWER;
+        event.mInitiator = addr;
+        event.mValue = status;
+        PublishEvent(event);
+    }
+}
+
+/**
+ * @brief Publishes an event of this adapter.
+ *
+ * @param event The event, the adapter index is set here
+ */
+void cCECRemote::PublishEvent(cCECBusEvent &event)
+{
+    event.mAdapter = mAdapterIndex;
+    mPlugin->PublishEvent(event);
+}
+
+/**
+ * @brief Feeds a received frame into the routing state machine.
+ *
+ * - ACTIVE_SOURCE: the initiator is the new source.
+ * - INACTIVE_SOURCE: the source is unknown if the initiator was active.
+ * - ROUTING_CHANGE, ROUTING_INFORMATION, SET_STREAM_PATH: the device at
+ *   the new physical address is the source.
+ * - STANDBY: a broadcast of the TV ends all routes, otherwise the
+ *   source is unknown if the initiator was active.
+ *
+ * Called from the libCEC callback thread, the handlers of the change
+ * are executed by the worker thread.
+ *
+ * @param command The received CEC frame
+ */
+void cCECRemote::UpdateRouting(const cec_command *command)
+{
+    const uint8_t *p = command->parameters.data;
+    uint8_t size = command->parameters.size;
+    bool changed = false;
+
+    switch (command->opcode) {
+    case CEC_OPCODE_ACTIVE_SOURCE:
+        if (size >= 2) {
+            uint16_t physical = (p[0] << 8) | p[1];
+            mBusState.SetPhysicalAddress(command->initiator, physical);
+            changed = mBusState.SetActiveSource(command->initiator, physical);
+        }
+        break;
+    case CEC_OPCODE_INACTIVE_SOURCE:
+        changed = mBusState.ClearActiveSource(command->initiator);
+        break;
+    case CEC_OPCODE_ROUTING_CHANGE:
+        if (size >= 4) {
+            changed = mBusState.SetActivePath((p[2] << 8) | p[3]);
+        }
+        break;
+    case CEC_OPCODE_ROUTING_INFORMATION:
+    case CEC_OPCODE_SET_STREAM_PATH:
+        if (size >= 2) {
+            changed = mBusState.SetActivePath((p[0] << 8) | p[1]);
+        }
+        break;
+    case CEC_OPCODE_STANDBY:
+        if ((command->initiator == CECDEVICE_TV) &&
+            (command->destination == CECDEVICE_BROADCAST)) {
+            changed = mBusState.SetActiveSource(CECDEVICE_UNKNOWN,
+                                        cCECBusSnapshot::PHYSICAL_UNKNOWN);
+        }
+        else {
+            changed = mBusState.ClearActiveSource(command->initiator);
+        }
+        break;
+    default:
+        break;
+    }
+    if (changed) {
+        SourceChanged(command->opcode);
+    }
+}
+
+/**
+ * @brief Updates the routing state when libCEC (de)activated VDR.
+ *
+ * @param addr Own logical address
+ * @param activated true if VDR became the active source
+ */
+void cCECRemote::SourceActivated(cec_logical_address addr, bool activated)
+{
+    bool changed;
+    if (activated) {
+        changed = mBusState.SetActiveSource(addr,
+                                            mBusState.GetPhysicalAddress(addr));
+    }
+    else {
+        changed = mBusState.ClearActiveSource(addr);
+    }
+    if (changed) {
+        SourceChanged(activated ? CEC_OPCODE_ACTIVE_SOURCE :
+                                  CEC_OPCODE_INACTIVE_SOURCE);
+    }
+}
+
+/**
+ * @brief Publishes a change of the active source and queues the
+ *        <onactivesource> handlers.
+ *
+ * @param opcode Opcode which caused the change
+ */
+void cCECRemote::SourceChanged(cec_opcode opcode)
+{
+    cec_logical_address addr;
+    uint16_t physical;
+
+    mBusState.GetActiveSource(addr, physical);
+    mSourceChanges++;
+    Isyslog("Active source %d %04x (opcode %02x)", addr, physical, opcode);
+
+    cCECBusEvent event;
+    event.mType = cCECBusEvent::SOURCE;
+    event.mInitiator = (addr == CECDEVICE_UNKNOWN) ? 0xFF : addr;
+    event.mOpcode = opcode;
+    event.mValue = physical;
+    PublishEvent(event);
+
+    cCmd cmd(CEC_SOURCECHANGED, opcode, addr);
+    cmd.mVal = physical;
+    PushCmd(cmd);
+}
+
+/**
+ * @brief Gets the routing state for STAT.
+ *
+ * @return Active source and number of switches
+ */
+cString cCECRemote::GetRoutingStatus()
+{
+    cec_logical_address addr;
+    uint16_t physical;
+    cString source = "unknown";
+
+    mBusState.GetActiveSource(addr, physical);
+    if (physical != cCECBusSnapshot::PHYSICAL_UNKNOWN) {
+        source = cString::sprintf("%d.%d.%d.%d",
+                                  (physical >> 12) & 0xF, (physical >> 8) & 0xF,
+                                  (physical >> 4) & 0xF, physical & 0xF);
+    }
+    if (addr != CECDEVICE_UNKNOWN) {
+        source = cString::sprintf("%d (%s)", addr, *source);
+    }
+    return cString::sprintf("  Active Source %s\n  Source Changes %u Suppressed %u",
+                            *source, mSourceChanges.load(),
+                            mSourceSuppressed.load());
+}
+
+/**
+ * @brief Checks if the libCEC call in flight is stalled.
+ *
+ * Called by the watchdog thread. If the call takes longer than the
+ * timeout, the adapter is closed, which makes libCEC abort the pending
+ * communication. The worker reconnects when the call has returned and
+ * then continues with the queued commands. A hung Close() is only
+ * reported, as closing again would race with the unload of the worker.
+ *
+ * The reconnect is not moved to a helper thread: the worker is blocked
+ * inside the adapter instance, so a second instance can not be opened
+ * on the same port before the first one has been unloaded, and unloading
+ * it under the blocked worker would free the code it is running. If the
+ * call does not return within another timeout after Close(), the adapter
+ * is reported as unrecoverable.
+ *
+ * @param timeoutMs Maximum duration of a libCEC call in ms
+ */
+void cCECRemote::CheckWatchdog(int timeoutMs)
+{
+    const char *name = mCallName.load();
+    if (name == nullptr) {
+        return;
+    }
+    uint64_t now = cTimeMs::Now();
+    if (mStalled) {
+        if (!mStallUnrecoverable &&
+            ((now - mStallTime.load()) > (uint64_t)timeoutMs)) {
+            mStallUnrecoverable = true;
+            Esyslog("Adapter %s: libCEC %s still hangs after Close, "
+                    "the adapter can not be recovered without a restart",
+                    mAdapterId.c_str(), name);
+        }
+        return;
+    }
+    uint64_t start = mCallStart.load();
+    uint64_t duration = now - start;
+    if (duration < (uint64_t)timeoutMs) {
+        return;
+    }
+    // The worker can not unload the adapter while it is closed here
+    cMutexLock lock(&mAdapterMutex);
+    // The call may have finished meanwhile
+    if ((mCallName.load() != name) || (mCallStart.load() != start) ||
+        (mCECAdapter == nullptr)) {
+        return;
+    }
+    mStallTime = now;
+    mStalled = true;
+    mStalls++;
+    Esyslog("Adapter %s: libCEC %s hangs for %d ms, resetting adapter",
+            mAdapterId.c_str(), name, (int)duration);
+    cCECBusEvent event;
+    event.mType = cCECBusEvent::ALERT;
+    event.mValue = CEC_ALERT_CONNECTION_LOST;
+    PublishEvent(event);
+    if (strcmp(name, "Close") != 0) {
+        mCECAdapter->Close();
+    }
+}
+
+/**
+ * @brief Reconnects after the watchdog closed a stalled adapter.
+ *
+ * Executed by the worker thread once the hung call has returned. The
+ * adapter is already closed, so it is only unloaded before connecting.
+ */
+void cCECRemote::RecoverAdapter()
+{
+    Isyslog("Adapter %s: recovering after stalled libCEC call",
+            mAdapterId.c_str());
+    UnloadAdapter();
+    mBusState.Clear();
+    mStalled = false;
+    mStallUnrecoverable = false;
+    cMetrics::Inc(cMetrics::RECONNECTS);
+    Connect();
+    if (mCECAdapter != nullptr) {
+        mRecoveries++;
+        Isyslog("Adapter %s: recovered", mAdapterId.c_str());
+    }
+}
+
+/**
+ * @brief Gets the watchdog state for STAT.
+ *
+ * @return Call in flight, number of stalls and recoveries
+ */
+cString cCECRemote::GetWatchdogStatus()
+{
+    const char *name = mCallName.load();
+    cString call = "idle";
+    if (name != nullptr) {
+        call = cString::sprintf("%s since %d ms%s", name,
+                                (int)(cTimeMs::Now() - mCallStart.load()),
+                                mStallUnrecoverable ? " (stalled, not recoverable)" :
+                                mStalled ? " (stalled)" : "");
+    }
+    return cString::sprintf("  libCEC Call %s\n  Stalls %u Recoveries %u",
+                            *call, mStalls.load(), mRecoveries.load());
+}
+
+/**
+ * @brief Applies the configured scheduling to a libCEC callback thread.
+ *
+ * libCEC delivers keys and commands from its own thread, which is
+ * created on Open(), so the options are applied on the first callback
+ * of every new thread.
+ */
+void cCECRemote::CallbackThreadStarted()
+{
+    static thread_local bool started = false;
+    if (started) {
+        return;
+    }
+    started = true;
+    mCallbackTid = cThread::ThreadId();
+    cTracer::ThreadName("libCEC callback " + mAdapterId);
+    if (mScheduling.IsSet()) {
+        mScheduling.Apply("libCEC callback");
+    }
+}
+
+/**
+ * @brief Ends the startup timing once all <onstart> commands are done.
+ *
+ * Executed by the worker after each command. Commands of <onstart> are
+ * recognized by their event, nested commands (e.g. of <if>) are queued
+ * with the same event, so the list is done when none of them is left.
+ *
+ * @param cmd The command just executed
+ */
+void cCECRemote::CheckStartupDone(const cCmd &cmd)
+{
+    if (mStartupTiming.IsFinished() || (cmd.mEvent.mName != "start")) {
+        return;
+    }
+    {
+        cMutexLock lock(&mWorkerQueueMutex);
+        for (const cCmd &c : mWorkerQueue) {
+            if (c.mEvent.mName == "start") {
+                return;
+            }
+        }
+    }
+    FinishStartupTiming();
+}
+
+/**
+ * @brief Ends the startup timing and logs the summary.
+ */
+void cCECRemote::FinishStartupTiming()
+{
+    if (mStartupTiming.IsFinished()) {
+        return;
+    }
+    mStartupTiming.End(cStartupTiming::ONSTART);
+    mStartupTiming.Finish();
+    Isyslog("Startup timing (ms) adapter %s: %s %s", mAdapterId.c_str(),
+            mPlugin->GetStartupTiming().Summary().c_str(),
+            mStartupTiming.Summary().c_str());
+}
+
+/**
+ * @brief Gets the effective scheduling of the threads for STAT.
+ *
+ * The values are read from the kernel, so failed settings are visible.
+ *
+ * @return Scheduling of the worker and the libCEC callback thread
+ */
+cString cCECRemote::GetSchedulingStatus()
+{
+    return cString::sprintf("  Worker %s\n  libCEC Callback %s",
+                            *cThreadScheduling::Describe(mWorkerTid.load()),
+                            *cThreadScheduling::Describe(mCallbackTid.load()));
+}
+
+/**
+ * @brief Gets the power status of a device.
+ *
+ * Uses the cached status reported by the device, only if nothing
+ * recent is known the device is asked.
+ *
+ * @param addr Logical address of the device
+ * @return The power status of the device
+ */
+cec_power_status cCECRemote::GetPowerStatus(cec_logical_address addr)
+{
+    cec_power_status status;
+    if (!mBusState.GetPowerStatus(addr, status)) {
+        cLibCECCall call(this, "GetDevicePowerStatus");
         status = mCECAdapter->GetDevicePowerStatus(addr);
-        cnt++;
-    } while ((status != newstatus) && (cnt < 50) && (status != CEC_POWER_STATUS_UNKNOWN));
+        UpdatePowerStatus(addr, status);
+    }
+    return status;
 }
 
 /**
  * @brief Executes a shell command with special SVDRP handling.
  *
- * Forks a child process to execute the command. While the script
- * runs, monitors the exec queue for SVDRP CONN/DISC commands
- * that may come from the script itself.
+ * The script is started by the script runner, which logs its output and
+ * terminates it on timeout. While the script runs, monitors the exec
+ * queue for SVDRP CONN/DISC commands that may come from the script
+ * itself. Asynchronous scripts are only queued in the script pool.
  *
  * @param execcmd Reference to the command containing the shell script to execute
  */
@@ -802,31 +1642,23 @@ void cCECRemote::Exec(cCmd &execcmd)
     cCmd cmd;
     Dsyslog("Execute script %s", execcmd.mExec.c_str());
 
-    pid_t pid = fork();
-    if (pid < 0) {
-        Esyslog("fork failed");
+    std::vector<std::string> env;
+    BuildExecEnv(execcmd, env);
+
+    cScriptRunner *runner = mPlugin->GetScriptRunner();
+    if (runner == nullptr) {
+        Esyslog("Script runner not available");
         return;
     }
-    else if (pid == 0) {
-    	pid = setsid();
-    	if (pid < 0) {
-    		Esyslog("Sid failed");
-    		abort();
-    	}
-    	// Close all file descriptors >= 4 to prevent leaking to child process
-#ifdef HAVE_CLOSE_RANGE
-    	close_range(4, UINT_MAX, CLOSE_RANGE_UNSHARE);
-#else
-    	// Fallback for older glibc (< 2.34) / Linux (< 5.9)
-    	int maxfd = sysconf(_SC_OPEN_MAX);
-    	if (maxfd < 0) maxfd = 1024;
-    	for (int fd = 4; fd < maxfd; fd++) {
-    	    close(fd);
-    	}
-#endif
-        execl("/bin/sh", "sh", "-c", execcmd.mExec.c_str(), nullptr);
-        Esyslog("Exec failed");
-        abort();
+    // Asynchronous scripts can not control the worker
+    if (execcmd.mAsync) {
+        runner->Queue(execcmd.mExec, env, StopBudget(execcmd.mTimeoutMs));
+        return;
+    }
+    pid_t pid = runner->Run(execcmd.mExec, env,
+                            StopBudget(execcmd.mTimeoutMs), &mExecQueueWait);
+    if (pid < 0) {
+        return;
     }
 
     mInExec = true;
@@ -840,6 +1672,7 @@ void cCECRemote::Exec(cCmd &execcmd)
             break;
         case CEC_RECONNECT:
             Dsyslog("cCECRemote Exec reconnect");
+            cMetrics::Inc(cMetrics::RECONNECTS);
             Disconnect();
             sleep(1);
             Connect();
@@ -856,6 +1689,7 @@ void cCECRemote::Exec(cCmd &execcmd)
             Esyslog("cCECRemote Exec Unexpected action %d Val %d", cmd.mCmd, cmd.mVal);
             break;
         }
+        mPlugin->StatusChanged();
         Csyslog ("(%d) Action finished", cmd.mSerial);
         if (cmd.mSerial != -1) {
             mProcessedSerial = cmd.mSerial;
@@ -865,11 +1699,89 @@ void cCECRemote::Exec(cCmd &execcmd)
     mInExec = false;
 }
 
+/**
+ * @brief Builds the environment of a script started by <exec>.
+ *
+ * The environment of VDR is extended by the event which triggered the
+ * command list and by the cached state of the CEC bus, so a script does
+ * not need to query the bus itself:
+ * - CEC_EVENT, CEC_ADAPTER: Event name and adapter id
+ * - CEC_OPCODE, CEC_INITIATOR, CEC_PARAMS: Received CEC command
+ * - CEC_DEVICES: Logical addresses with a known state
+ * - CEC_POWER_<n>, CEC_PHYSICAL_<n>: Last reported state of device n
+ *
+ * @param cmd The exec command with the triggering event
+ * @param env Receives the environment in the form NAME=value
+ */
+void cCECRemote::BuildExecEnv(const cCmd &cmd, std::vector<std::string> &env)
+{
+    for (char **e = environ; (e != nullptr) && (*e != nullptr); e++) {
+        if (strncmp(*e, "CEC_", 4) != 0) {
+            env.push_back(*e);
+        }
+    }
+    env.push_back("CEC_ADAPTER=" + mAdapterId);
+    if (!cmd.mEvent.mName.empty()) {
+        env.push_back("CEC_EVENT=" + cmd.mEvent.mName);
+    }
+    if (cmd.mEvent.mOpcode != CEC_OPCODE_NONE) {
+        env.push_back(*cString::sprintf("CEC_OPCODE=0x%02x", cmd.mEvent.mOpcode));
+        env.push_back(*cString::sprintf("CEC_INITIATOR=%d", cmd.mEvent.mInitiator));
+        std::string params;
+        for (uint8_t p : cmd.mEvent.mParams) {
+            if (!params.empty()) {
+                params += " ";
+            }
+            params += *cString::sprintf("%02x", p);
+        }
+        env.push_back("CEC_PARAMS=" + params);
+    }
+
+    cCECBusSnapshot snapshot;
+    mBusState.GetSnapshot(snapshot);
+    std::string devices;
+    for (int i = 0; i < cCECBusSnapshot::MAX_DEVICES; i++) {
+        bool known = false;
+        if (snapshot.mPower[i] == CEC_POWER_STATUS_ON) {
+            env.push_back(*cString::sprintf("CEC_POWER_%d=on", i));
+            known = true;
+        }
+        else if (snapshot.mPower[i] == CEC_POWER_STATUS_STANDBY) {
+            env.push_back(*cString::sprintf("CEC_POWER_%d=standby", i));
+            known = true;
+        }
+        uint16_t phys = snapshot.mPhysicalAddress[i];
+        if (phys != cCECBusSnapshot::PHYSICAL_UNKNOWN) {
+            env.push_back(*cString::sprintf("CEC_PHYSICAL_%d=%d.%d.%d.%d", i,
+                          (phys >> 12) & 0xF, (phys >> 8) & 0xF,
+                          (phys >> 4) & 0xF, phys & 0xF));
+            known = true;
+        }
+        if (known) {
+            if (!devices.empty()) {
+                devices += " ";
+            }
+            devices += *cString::sprintf("%d", i);
+        }
+    }
+    env.push_back("CEC_DEVICES=" + devices);
+    if (snapshot.mActiveSource != CECDEVICE_UNKNOWN) {
+        env.push_back(*cString::sprintf("CEC_ACTIVE_SOURCE=%d",
+                                        snapshot.mActiveSource));
+    }
+    uint16_t phys = snapshot.mActiveSourcePhysical;
+    if (phys != cCECBusSnapshot::PHYSICAL_UNKNOWN) {
+        env.push_back(*cString::sprintf("CEC_ACTIVE_PHYSICAL=%d.%d.%d.%d",
+                      (phys >> 12) & 0xF, (phys >> 8) & 0xF,
+                      (phys >> 4) & 0xF, phys & 0xF));
+    }
+}
+
 /**
  * @brief Waits for a command in the exec queue during script execution.
  *
  * Monitors both the exec queue and the running process. Returns when
- * either a command is received or the process terminates.
+ * either a command is received or the script runner reaped the process.
  *
  * @param pid Process ID of the running script
  * @return The received command, or CEC_EXIT if the process terminated
@@ -877,20 +1789,18 @@ void cCECRemote::Exec(cCmd &execcmd)
 cCmd cCECRemote::WaitExec(pid_t pid)
 {
     Csyslog("WaitExec");
-    int stat_loc = 0;
     mExecQueueMutex.Lock();
     while (mExecQueue.empty()) {
         mExecQueueMutex.Unlock();
+        // The script runner reaps the script and signals mExecQueueWait
+        if (!mPlugin->GetScriptRunner()->IsRunning(pid)) {
+            Dsyslog("  Script %d finished", pid);
+            cCmd cmd(CEC_EXIT);
+            return cmd;
+        }
         if (mExecQueueWait.Wait(250)) {
             Csyslog("  Signal");
         }
-        else {
-            if (waitpid (pid, &stat_loc, WNOHANG) == pid) {
-                Dsyslog("  Script exit with %d", WEXITSTATUS(stat_loc));
-                cCmd cmd(CEC_EXIT);
-                return cmd;
-            }
-        }
         mExecQueueMutex.Lock();
     }
 
@@ -908,19 +1818,70 @@ cCmd cCECRemote::WaitExec(pid_t pid)
  * for sequential execution. Thread-safe.
  *
  * @param cmdList Reference to the command queue to push
+ * @param event Optional event passed to the scripts of the commands
  */
-void cCECRemote::PushCmdQueue(const cCmdQueue &cmdList)
+void cCECRemote::PushCmdQueue(const cCmdQueue &cmdList, const cCECEvent *event)
 {
     if (mCECAdapter == nullptr) {
         Esyslog ("PushCmdQueue CEC Adapter disconnected");
         return;
     }
     Csyslog("cCECRemote::PushCmdQueue");
+    cTracer::Instant("queue", "commandlist", cmdList.size());
     mWorkerQueueMutex.Lock();
     for (cCmdQueueIterator i = cmdList.begin();
            i != cmdList.end(); i++) {
         mWorkerQueue.push_back(*i);
+        CEC_PROBE3(cmd_enqueue, mAdapterIndex, i->mCmd, i->mSerial);
+        if (event != nullptr) {
+            mWorkerQueue.back().mEvent = *event;
+        }
+    }
+    mWorkerQueueMutex.Unlock();
+    mWorkerQueueWait.Signal();
+
+    if (event != nullptr) {
+        cCECBusEvent busevent;
+        busevent.mType = cCECBusEvent::COMMANDLIST;
+        busevent.mValue = cmdList.size();
+        strncpy(busevent.mName, event->mName.c_str(),
+                sizeof(busevent.mName) - 1);
+        PublishEvent(busevent);
     }
+}
+
+/**
+ * @brief Inserts commands before the pending commands of the worker.
+ *
+ * Used for the branches of <if>, which have to be executed before the
+ * commands following the <if> in the same list. Commands for other
+ * adapters are routed to their worker.
+ *
+ * @param cmdList Commands to execute next
+ * @param event Event which triggered the <if>
+ */
+void cCECRemote::PushCmdQueueFront(const cCmdQueue &cmdList,
+                                   const cCECEvent &event)
+{
+    cCmdQueue own;
+    cCmdQueue other;
+    for (const cCmd &cmd : cmdList) {
+        if (cmd.mDevice.mAdapter == mAdapterIndex) {
+            own.push_back(cmd);
+            own.back().mEvent = event;
+        }
+        else {
+            other.push_back(cmd);
+        }
+    }
+    for (const cCmd &cmd : own) {
+        CEC_PROBE3(cmd_enqueue, mAdapterIndex, cmd.mCmd, cmd.mSerial);
+    }
+    if (!other.empty()) {
+        mPlugin->PushCmdQueue(other, &event);
+    }
+    mWorkerQueueMutex.Lock();
+    mWorkerQueue.insert(mWorkerQueue.begin(), own.begin(), own.end());
     mWorkerQueueMutex.Unlock();
     mWorkerQueueWait.Signal();
 }
@@ -937,6 +1898,8 @@ void cCECRemote::PushCmdQueue(const cCmdQueue &cmdList)
 void cCECRemote::PushCmd(const cCmd &cmd)
 {
     Csyslog("cCECRemote::PushCmd %d (size %d)", cmd.mCmd, mWorkerQueue.size());
+    cTracer::Instant("queue", cMetrics::CommandName(cmd.mCmd + 1), cmd.mVal);
+    CEC_PROBE3(cmd_enqueue, mAdapterIndex, cmd.mCmd, cmd.mSerial);
 
     mWorkerQueueMutex.Lock();
     mWorkerQueue.push_back(cmd);
@@ -962,6 +1925,7 @@ void cCECRemote::PushWaitCmd(cCmd &cmd, int timeout)
 
     Csyslog("cCECRemote::PushWaitCmd %d ID %d (WQ %d EQ %d)",
             cmd.mCmd, serial, mWorkerQueue.size(), mExecQueue.size());
+    CEC_PROBE3(cmd_enqueue, mAdapterIndex, cmd.mCmd, serial);
 
     // Special handling for CEC_CONNECT and CEC_DISCONNECT when called
     // from exec state (used for out of band processing of svdrp commands
@@ -28,11 +28,18 @@
 
 #include "keymaps.h"
 #include "cmd.h"
+#include "tracer.h"
+#include "startuptiming.h"
+#include "probes.h"
+#include "busstate.h"
+#include "busevent.h"
+#include "threadsched.h"
 
 namespace cecplugin {
 
 class cPluginCecremote;
 class cCECGlobalOptions;
+class cCECCommandHandler;
 
 /**
  * @class cCECRemote
@@ -45,6 +52,9 @@ class cCECGlobalOptions;
  * Commands are processed through two queues:
  * - mWorkerQueue: Normal command processing queue
  * - mExecQueue: Special queue used during shell script execution
+ *
+ * One instance is created per configured <adapter>, so every CEC bus has
+ * its own connection, worker thread and queues.
  */
 class cCECRemote : public cRemote, private cThread {
 public:
@@ -52,8 +62,10 @@ public:
      * @brief Constructs the CEC remote handler.
      * @param options Global configuration options from XML config file.
      * @param plugin Pointer to the main plugin instance.
+     * @param adapter Index of the adapter in cCECGlobalOptions::mAdapters.
      */
-    cCECRemote(const cCECGlobalOptions &options, cPluginCecremote *plugin);
+    cCECRemote(const cCECGlobalOptions &options, cPluginCecremote *plugin,
+               int adapter = 0);
 
     /**
      * @brief Destructor - stops the thread and disconnects from CEC adapter.
@@ -75,8 +87,9 @@ public:
     /**
      * @brief Pushes multiple commands to the worker queue.
      * @param cmdList List of commands to execute in order.
+     * @param event Optional event which triggered the commands.
      */
-    void PushCmdQueue(const cCmdQueue &cmdList);
+    void PushCmdQueue(const cCmdQueue &cmdList, const cCECEvent *event = nullptr);
 
     /**
      * @brief Pushes a command and waits for its completion.
@@ -97,21 +110,48 @@ public:
      */
     cString ListDevices();
 
+    /**
+     * @brief Lists the HDMI tree built from the reported physical addresses.
+     * @return Formatted topology for SVDRP.
+     */
+    cString ListTopology();
+
     /**
      * @brief Reconnects to the CEC adapter (disconnect then connect).
      */
     void Reconnect();
 
     /**
-     * @brief Stops the background thread and disconnects from CEC adapter.
+     * @brief Queues the <onstop> commands and the exit of the worker.
+     *
+     * Returns at once, so all adapters shut down in parallel. Commands
+     * still pending at the deadline are skipped and reported.
+     * @param deadline Time (cTimeMs::Now()) the shutdown must be done.
      */
-    void Stop();
+    void BeginStop(uint64_t deadline);
+
+    /**
+     * @brief Waits until the worker processed the exit command.
+     * @param deadline Latest time to wait for.
+     * @return false if the worker did not finish in time.
+     */
+    bool WaitStopped(uint64_t deadline);
 
     /**
      * @brief Starts the CEC adapter connection and background thread.
      */
     void Startup();
 
+    /**
+     * @brief Opens the CEC adapter while VDR is still starting up.
+     *
+     * Starts the worker thread from Initialize(), <onmanualstart> is queued
+     * as soon as the adapter is open, so the TV is powered on as early as
+     * possible. Keys are passed to VDR
+     * only after Startup() was called.
+     */
+    void EarlyStartup();
+
     /**
      * @brief Gets the number of pending commands in worker queue.
      * @return Number of commands waiting to be processed.
@@ -132,7 +172,93 @@ public:
      */
     bool IsConnected() {return (mCECAdapter != nullptr);}
 
+    /**
+     * @brief Publishes an event of this adapter to the subscribers.
+     * @param event The event, the adapter index is set by this function.
+     */
+    void PublishEvent(cCECBusEvent &event);
+
+    /**
+     * @brief Stores a power status and publishes it if it has changed.
+     * @param addr Logical address of the device.
+     * @param status Reported power status.
+     */
+    void UpdatePowerStatus(cec_logical_address addr, cec_power_status status);
+
+    /**
+     * @brief Feeds a received frame into the routing state machine.
+     *
+     * Handles ACTIVE_SOURCE, INACTIVE_SOURCE, ROUTING_CHANGE,
+     * ROUTING_INFORMATION, SET_STREAM_PATH and STANDBY.
+     * @param command The received CEC frame.
+     */
+    void UpdateRouting(const cec_command *command);
+
+    /**
+     * @brief Updates the routing state when libCEC (de)activated VDR.
+     * @param addr Own logical address.
+     * @param activated true if VDR became the active source.
+     */
+    void SourceActivated(cec_logical_address addr, bool activated);
+
+    /**
+     * @brief Gets the routing state for STAT.
+     * @return Active source and number of switches.
+     */
+    cString GetRoutingStatus();
+
+    /**
+     * @brief Checks if the libCEC call in flight is stalled.
+     *
+     * Called by the watchdog thread. A stalled adapter is closed, so the
+     * call returns and the worker reconnects before the next command.
+     * @param timeoutMs Maximum duration of a libCEC call in ms.
+     */
+    void CheckWatchdog(int timeoutMs);
+
+    /**
+     * @brief Gets the watchdog state for STAT.
+     * @return Call in flight, stalls and recoveries.
+     */
+    cString GetWatchdogStatus();
+
+    /**
+     * @brief Applies the configured scheduling to a libCEC callback thread.
+     *
+     * Called at the start of every callback, the options are applied
+     * once per thread.
+     */
+    void CallbackThreadStarted();
+
+    /**
+     * @brief Gets the effective scheduling of the threads for STAT.
+     * @return Policy, priority, nice value and CPUs of the threads.
+     */
+    cString GetSchedulingStatus();
+
+    /**
+     * @brief Gets the name of the adapter handled by this instance.
+     * @return Adapter id from the <adapter> definition.
+     */
+    const std::string &GetAdapterId() const {return mAdapterId;}
+
+    /**
+     * @brief Gets the index of the adapter handled by this instance.
+     * @return Index of the <adapter> definition.
+     */
+    int GetAdapterIndex() const {return mAdapterIndex;}
+
+    /**
+     * @brief Gets the timing of the startup phases of this adapter.
+     * @return Phases from the construction to the completion of <onstart>.
+     */
+    const cStartupTiming &GetStartupTiming() const {return mStartupTiming;}
+
     ICECAdapter            *mCECAdapter = nullptr;  ///< libCEC adapter interface
+    cec_user_control_code  mLastKey = CEC_USER_CONTROL_CODE_UNKNOWN; ///< Last key for repeat filter
+    cMutex                 mLastKeyMutex;           ///< Protects mLastKey
+    std::atomic<int>       mLastKeyInitiator{CECDEVICE_UNKNOWN}; ///< Initiator of the last USER_CONTROL_PRESSED
+    cCECBusState           mBusState;               ///< Cached state of the bus
 private:
     static constexpr const int MAX_CEC_ADAPTERS = 10;
     static const char      *VDRNAME;
@@ -144,6 +270,10 @@ private:
     cec_logical_address    mBaseDevice;
     uint32_t               mPhysAddress = 0;
     uint32_t               mComboKeyTimeoutMs;
+    int                    mAdapterIndex;       ///< Index of the configured adapter
+    std::string            mAdapterId;          ///< Name of the configured adapter
+    std::string            mAdapterPort;        ///< Configured com port (empty = by index)
+    int                    mDescriptorIndex = 0; ///< Detected adapter opened
     libcec_configuration   mCECConfig;
     ICECCallbacks          mCECCallbacks;
     cec_adapter_descriptor mCECAdapterDescription[MAX_CEC_ADAPTERS];
@@ -163,9 +293,85 @@ private:
     bool                   mShutdownOnStandby;
     bool                   mPowerOffOnStandby;
     std::atomic<bool>      mInExec{false};        ///< Thread-safe exec state flag
-    std::atomic<bool>      mDeferredStartup{false}; ///< Thread-safe deferred startup flag
+    cMutex                 mPendingStartupMutex;  ///< Protects the pending startup state
+    bool                   mPendingManualStart = false; ///< <onmanualstart> waits for the adapter
+    bool                   mPendingStart = false; ///< <onstart> waits for the adapter
+    bool                   mAdapterOpened = false; ///< Connect() succeeded at least once
+    std::atomic<bool>      mEarlyStartup{false};  ///< Worker started by EarlyStartup()
+    std::atomic<bool>      mStarted{false};       ///< Startup() was called, VDR is running
+    std::atomic<uint64_t>  mStopDeadline{0};      ///< Shutdown deadline, 0 = running
+    std::atomic<int>       mExitSerial{-1};       ///< Serial of the exit command
+    std::vector<std::string> mStopSkipped;        ///< Commands skipped at shutdown (worker only)
+    std::atomic<unsigned>  mSourceChanges{0};     ///< Changes of the active source
+    std::atomic<unsigned>  mSourceSuppressed{0};  ///< Redundant switches not sent
+    std::atomic<const char *> mCallName{nullptr}; ///< libCEC call in flight
+    std::atomic<uint64_t>  mCallStart{0};         ///< Start of the call (ms)
+    std::atomic<bool>      mStalled{false};       ///< Adapter closed by the watchdog
+    std::atomic<uint64_t>  mStallTime{0};         ///< Time the watchdog closed the adapter (ms)
+    std::atomic<bool>      mStallUnrecoverable{false}; ///< The call hangs also after Close()
+    cMutex                 mAdapterMutex;         ///< Protects the adapter against unload while the watchdog closes it
+    std::atomic<unsigned>  mStalls{0};            ///< Detected hung calls
+    std::atomic<unsigned>  mRecoveries{0};        ///< Reconnects after a stall
+    cThreadScheduling      mScheduling;           ///< Scheduling of the threads
+    std::atomic<pid_t>     mWorkerTid{0};         ///< Kernel id of the worker
+    std::atomic<pid_t>     mCallbackTid{0};       ///< Kernel id of the libCEC callbacks
+    cStartupTiming         mStartupTiming;        ///< Phases of the first connect
     cPluginCecremote       *mPlugin;
 
+    /**
+     * @class cLibCECCall
+     * @brief Records a blocking libCEC call of the worker for the watchdog
+     *        and the trace.
+     */
+    class cLibCECCall {
+    private:
+        cCECRemote *mRemote;
+        cTraceSpan mSpan;  ///< Span of the call in the trace
+    public:
+        /**
+         * @brief Marks the start of a call.
+         * @param remote Handler executing the call.
+         * @param name Name of the call, must be a string literal.
+         */
+        cLibCECCall(cCECRemote *remote, const char *name) :
+                mRemote(remote), mSpan("libcec", name) {
+            CEC_PROBE2(libcec_entry, mRemote->mAdapterIndex, name);
+            mRemote->mCallStart = cTimeMs::Now();
+            mRemote->mCallName = name;
+        }
+        /** @brief Marks the end of the call. */
+        ~cLibCECCall() {
+            CEC_PROBE2(libcec_return, mRemote->mAdapterIndex,
+                       mRemote->mCallName.load());
+            mRemote->mCallName = nullptr;
+        }
+    };
+
+    /**
+     * @brief Ends the startup timing once all <onstart> commands are done.
+     * @param cmd The command just executed by the worker.
+     */
+    void CheckStartupDone(const cCmd &cmd);
+
+    /** @brief Ends the startup timing and logs the summary. */
+    void FinishStartupTiming();
+
+    /**
+     * @brief Queues <onmanualstart> and <onstart> once the adapter is open.
+     * @param connected true if called by Connect() after a successful open.
+     */
+    void QueuePendingStartup(bool connected);
+
+    /** @brief Reconnects after the watchdog closed a stalled adapter. */
+    void RecoverAdapter();
+
+    /**
+     * @brief Unloads libCEC and clears mCECAdapter.
+     * @note Locks mAdapterMutex, so the watchdog never closes an unloaded
+     *       adapter.
+     */
+    void UnloadAdapter();
+
     /** @brief Establishes connection to the CEC adapter. */
     void Connect();
 
@@ -178,6 +384,116 @@ private:
      */
     void ActionKeyPress(cCmd &cmd);
 
+    /**
+     * @brief Forwards a VDR key using the active global key map.
+     * @param cmd Command containing the VDR key and target device.
+     */
+    void ActionGlobalKeyPress(const cCmd &cmd);
+
+    /**
+     * @brief Transmits a raw CEC frame (<send>).
+     * @param cmd Command containing destination, opcode and parameters.
+     */
+    void ActionSend(const cCmd &cmd);
+
+    /**
+     * @brief Makes VDR the active source unless it already is (<makeactive>).
+     */
+    void ActionMakeActive();
+
+    /**
+     * @brief Removes VDR as active source if it is active (<makeinactive>).
+     */
+    void ActionMakeInactive();
+
+    /**
+     * @brief Executes the <onactivesource> handlers matching the new source.
+     * @param cmd Command with the new source and the triggering opcode.
+     */
+    void ActionSourceChanged(const cCmd &cmd);
+
+    /**
+     * @brief Executes the actions of a handler.
+     * @param handler <onceccommand> or <onactivesource> handler.
+     * @param event Event passed to the command list.
+     */
+    void RunHandler(const cCECCommandHandler &handler, const cCECEvent &event);
+
+    /**
+     * @brief Publishes a change of the active source and queues the handlers.
+     * @param opcode Opcode which caused the change.
+     */
+    void SourceChanged(cec_opcode opcode);
+
+    /**
+     * @brief Executes the branch of an <if> matching the power status.
+     * @param cmd Command containing device, status and both branches.
+     */
+    void ActionIf(const cCmd &cmd);
+
+    /**
+     * @brief Switches the active key maps (<keymap>).
+     * @param cmd Command containing the key map ids.
+     */
+    void ActionKeymap(const cCmd &cmd);
+
+    /**
+     * @brief Routes the HDMI switches to a device (<route>).
+     * @param cmd Command containing the target device.
+     */
+    void ActionRoute(const cCmd &cmd);
+
+    /**
+     * @brief Sets several devices to standby without waiting in between.
+     * @param cmd Command with the <poweroff> commands in mPoweroff.
+     */
+    void ActionStandbyGroup(const cCmd &cmd);
+
+    /**
+     * @brief Builds the shutdown plan from the <onstop> commands.
+     *
+     * Consecutive <poweroff> commands are merged into one
+     * CEC_STANDBYGROUP, so the devices are switched off in parallel.
+     * @param in <onstop> commands.
+     * @param out Receives the planned commands.
+     */
+    static void PlanStop(const cCmdQueue &in, cCmdQueue &out);
+
+    /**
+     * @brief Limits a timeout to the time left until the shutdown deadline.
+     * @param timeoutMs Timeout in ms, <= 0 for none.
+     * @return timeoutMs, or the remaining time during shutdown.
+     */
+    int StopBudget(int timeoutMs);
+
+    /**
+     * @brief Skips a command if the shutdown deadline has passed.
+     * @param cmd Command to execute next.
+     * @return true if the command must not be executed.
+     */
+    bool SkipAfterDeadline(const cCmd &cmd);
+
+    /**
+     * @brief Gets the power status, from the cache if possible.
+     * @param addr Logical address of the CEC device.
+     * @return The power status of the device.
+     */
+    cec_power_status GetPowerStatus(cec_logical_address addr);
+
+    /**
+     * @brief Inserts commands before all pending commands of the worker.
+     * @param cmdList Commands to execute next.
+     * @param event Event which triggered the commands.
+     */
+    void PushCmdQueueFront(const cCmdQueue &cmdList, const cCECEvent &event);
+
+    /**
+     * @brief Builds the environment of a script started by <exec>.
+     * @param cmd The exec command with the triggering event.
+     * @param env Receives the environment in the form NAME=value.
+     */
+    void BuildExecEnv(const cCmd &cmd, std::vector<std::string> &env);
+
     /** @brief Main thread action loop - processes commands from queues. */
     void Action();
 
@@ -220,8 +536,10 @@ private:
      * @brief Waits for a device to reach a specific power status.
      * @param addr Logical address of the CEC device.
      * @param newstatus The expected power status to wait for.
+     * @param timeout Maximum wait time in milliseconds.
      */
-    void WaitForPowerStatus(cec_logical_address addr, cec_power_status newstatus);
+    void WaitForPowerStatus(cec_logical_address addr, cec_power_status newstatus,
+                            int timeout = 5000);
 
     /**
      * @brief Sends TextViewOn command to a CEC device.
@@ -237,6 +555,13 @@ private:
      */
     cec_logical_address getLogical(cCECDevice &dev);
 
+    /**
+     * @brief Copies the commands of a queue routed to this adapter.
+     * @param in Command queue from the configuration.
+     * @param out Receives the commands for this adapter.
+     */
+    void FilterAdapter(const cCmdQueue &in, cCmdQueue &out);
+
     cCmdQueue mOnStart;        ///< Commands to execute on plugin start
     cCmdQueue mOnStop;         ///< Commands to execute on plugin stop
     cCmdQueue mOnVolumeUp;     ///< Commands to execute on volume up
@@ -12,6 +12,10 @@
 
 #include <getopt.h>
 #include <stdlib.h>
+#include <sys/time.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
 
 #include "cecremoteplugin.h"
 #include "ceclog.h"
@@ -20,6 +24,13 @@
 #include "keymaps.h"
 #include "configmenu.h"
 #include "rtcwakeup.h"
+#include "controlsocket.h"
+#include "statuspage.h"
+#include "eventsocket.h"
+#include "scriptrunner.h"
+#include "watchdog.h"
+#include "metrics.h"
+#include "tracer.h"
 
 namespace cecplugin {
 
@@ -31,14 +42,26 @@ using namespace std;
 /**
  * @brief Destructor that cleans up CEC resources.
  *
- * Deletes the CEC remote handler and status monitor if they exist.
+ * Deletes the CEC remote handlers and status monitor if they exist.
  */
 cPluginCecremote::~cPluginCecremote()
 {
-    if (mCECRemote != nullptr) {
-        delete mCECRemote;
-        mCECRemote = nullptr;
+    delete mControlSocket;
+    mControlSocket = nullptr;
+    delete mMetrics;
+    mMetrics = nullptr;
+    delete mStatusPage;
+    mStatusPage = nullptr;
+    delete mEventSocket;
+    mEventSocket = nullptr;
+    delete mScriptRunner;
+    mScriptRunner = nullptr;
+    delete mWatchdog;
+    mWatchdog = nullptr;
+    for (cCECRemote *remote : mCECRemotes) {
+        delete remote;
     }
+    mCECRemotes.clear();
     if (mStatusMonitor != nullptr) {
         delete mStatusMonitor;
         mStatusMonitor = nullptr;
@@ -135,7 +158,9 @@ bool cPluginCecremote::ProcessArgs(int argc, char *argv[])
  * @brief Initializes the plugin.
  *
  * Parses the configuration file, determines startup mode (manual vs timed),
- * creates the CEC remote handler, and sets default keymaps.
+ * creates a CEC remote handler per adapter, and sets default keymaps.
+ * With <earlyconnect> the adapters are opened in the background while
+ * VDR continues its startup.
  *
  * @return true on success, false if config parsing fails
  */
@@ -144,14 +169,24 @@ bool cPluginCecremote::Initialize(void)
     string file = GetConfigFile();
     rtcwakeup::RTC_WAKEUP_TYPE rtcwakeup = rtcwakeup::RTC_ERROR;
 
+    cStartupTiming::SetOrigin();
+    mStartupTiming.Begin(cStartupTiming::PARSE);
     if (!mConfigFileParser.Parse(file, mKeyMaps)) {
         Esyslog("Error on parsing config file file %s", file.c_str());
+        CEC_PROBE2(config_load, file.c_str(), 0);
         return false;
     }
+    CEC_PROBE2(config_load, file.c_str(), 1);
+    mStartupTiming.End(cStartupTiming::PARSE);
+    mMenuModel = std::make_shared<const cCECMenuModel>(
+            mConfigFileParser.mMenuList);
     mCECLogLevel = mConfigFileParser.mGlobalOptions.cec_debug;
+    cTracer::Enable(mConfigFileParser.mGlobalOptions.mTraceBuffer);
     if (mConfigFileParser.mGlobalOptions.mRTCDetect) {
         Dsyslog("Use RTC wakeup detection");
+        mStartupTiming.Begin(cStartupTiming::RTCWAKEUP);
         rtcwakeup = rtcwakeup::check();
+        mStartupTiming.End(cStartupTiming::RTCWAKEUP);
         mStartManually = (rtcwakeup != rtcwakeup::RTC_WAKEUP);
     }
     // Either rtc wakeup is disabled or not available, so fall back
@@ -172,8 +207,25 @@ bool cPluginCecremote::Initialize(void)
     else {
         Dsyslog("timed start");
     }
-    mCECRemote = new cCECRemote(mConfigFileParser.mGlobalOptions, this);
+    for (size_t i = 0; i < mConfigFileParser.mGlobalOptions.mAdapters.size(); i++) {
+        mCECRemotes.push_back(new cCECRemote(mConfigFileParser.mGlobalOptions,
+                                             this, i));
+    }
     SetDefaultKeymaps();
+    if (mConfigFileParser.mGlobalOptions.mEarlyConnect) {
+        // <onmanualstart> may already start scripts
+        mScriptRunner = new cScriptRunner(
+                mConfigFileParser.mGlobalOptions.mExecTimeoutMs,
+                mConfigFileParser.mGlobalOptions.mExecParallel);
+        mScriptRunner->Open();
+        for (cCECRemote *remote : mCECRemotes) {
+            remote->EarlyStartup();
+        }
+        if (mConfigFileParser.mGlobalOptions.mWatchdogTimeoutMs > 0) {
+            mWatchdog = new cCECWatchdog(mCECRemotes,
+                    mConfigFileParser.mGlobalOptions.mWatchdogTimeoutMs);
+        }
+    }
 
     return true;
 }
@@ -181,31 +233,224 @@ bool cPluginCecremote::Initialize(void)
 /**
  * @brief Starts the plugin operation.
  *
- * Starts the CEC remote worker thread and creates the status monitor.
+ * Starts the CEC remote worker threads and their watchdog, creates the
+ * status monitor and opens the event socket, control socket and status
+ * page if configured.
  *
  * @return true always
  */
 bool cPluginCecremote::Start(void)
 {
-    mCECRemote->Startup();
+    // The <onstart> commands may already start scripts
+    if (mScriptRunner == nullptr) {
+        mScriptRunner = new cScriptRunner(
+                mConfigFileParser.mGlobalOptions.mExecTimeoutMs,
+                mConfigFileParser.mGlobalOptions.mExecParallel);
+        mScriptRunner->Open();
+    }
+    // Open the event socket first, so the start events are published
+    if (!mConfigFileParser.mGlobalOptions.mEventSocket.empty()) {
+        cEventSocket *socket = new cEventSocket(
+                mConfigFileParser.mGlobalOptions.mEventSocket);
+        if (!socket->Open()) {
+            delete socket;
+            socket = nullptr;
+        }
+        // Early connected workers may already publish events
+        cMutexLock lock(&mEventCallbackMutex);
+        mEventSocket = socket;
+    }
+    for (cCECRemote *remote : mCECRemotes) {
+        remote->Startup();
+    }
+    if ((mWatchdog == nullptr) &&
+        (mConfigFileParser.mGlobalOptions.mWatchdogTimeoutMs > 0)) {
+        mWatchdog = new cCECWatchdog(mCECRemotes,
+                mConfigFileParser.mGlobalOptions.mWatchdogTimeoutMs);
+    }
+    if (!mConfigFileParser.mGlobalOptions.mMetricsFile.empty()) {
+        mMetrics = new cMetricsExporter(mCECRemotes,
+                mConfigFileParser.mGlobalOptions.mMetricsFile,
+                mConfigFileParser.mGlobalOptions.mMetricsInterval);
+    }
     mStatusMonitor = new cStatusMonitor(this);
+    if (!mConfigFileParser.mGlobalOptions.mControlSocket.empty()) {
+        mControlSocket = new cControlSocket(this,
+                mConfigFileParser.mGlobalOptions.mControlSocket);
+        if (!mControlSocket->Open()) {
+            delete mControlSocket;
+            mControlSocket = nullptr;
+        }
+    }
+    if (!mConfigFileParser.mGlobalOptions.mStatusPage.empty()) {
+        mStatusPage = new cStatusPage(this,
+                mConfigFileParser.mGlobalOptions.mStatusPage);
+        if (!mStatusPage->Open()) {
+            delete mStatusPage;
+            mStatusPage = nullptr;
+        }
+    }
     return true;
 }
 
 /**
  * @brief Stops the plugin operation.
  *
- * Stops the status monitor and CEC remote handler, executing
+ * Stops the status monitor and CEC remote handlers, executing
  * any configured onStop commands.
  */
 void cPluginCecremote::Stop(void)
 {
     Dsyslog("Stop Plugin");
+    delete mControlSocket;
+    mControlSocket = nullptr;
     delete mStatusMonitor;
     mStatusMonitor = nullptr;
-    mCECRemote->Stop();
-    delete mCECRemote;
-    mCECRemote = nullptr;
+    // All adapters shut down in parallel with a common deadline
+    uint64_t deadline = cTimeMs::Now() +
+                        mConfigFileParser.mGlobalOptions.mStopTimeoutMs;
+    for (cCECRemote *remote : mCECRemotes) {
+        remote->BeginStop(deadline);
+    }
+    for (cCECRemote *remote : mCECRemotes) {
+        remote->WaitStopped(deadline + STOP_GRACE_MS);
+    }
+    // The worker threads are stopped, so they no longer trigger updates
+    delete mMetrics;
+    mMetrics = nullptr;
+    delete mStatusPage;
+    mStatusPage = nullptr;
+    delete mEventSocket;
+    mEventSocket = nullptr;
+    delete mScriptRunner;
+    mScriptRunner = nullptr;
+    delete mWatchdog;
+    mWatchdog = nullptr;
+    // Service calls of other plugins may still arrive
+    cMutexLock lock(&mRemotesMutex);
+    for (cCECRemote *remote : mCECRemotes) {
+        delete remote;
+    }
+    mCECRemotes.clear();
+}
+
+/**
+ * @brief Notifies the status page about a changed plugin state.
+ *
+ * Called by the worker threads after each processed command.
+ */
+void cPluginCecremote::StatusChanged(void)
+{
+    if (mStatusPage != nullptr) {
+        mStatusPage->Trigger();
+    }
+}
+
+/**
+ * @brief Publishes an event to the event socket and the callbacks
+ *        registered by other plugins.
+ *
+ * May be called from any thread, including the libCEC callbacks.
+ *
+ * @param event The event, the time stamp is set here
+ */
+void cPluginCecremote::PublishEvent(cCECBusEvent &event)
+{
+    cMutexLock lock(&mEventCallbackMutex);
+    if ((mEventSocket == nullptr) && mEventCallbacks.empty()) {
+        return;
+    }
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    event.mTimeMs = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    if (mEventSocket != nullptr) {
+        mEventSocket->Publish(event);
+    }
+    for (const auto &cb : mEventCallbacks) {
+        cb.first(&event, cb.second);
+    }
+}
+
+/**
+ * @brief Gets the cached state of an adapter.
+ *
+ * @param adapter Index of the adapter
+ * @param status Receives the state
+ * @return false if the adapter does not exist
+ */
+bool cPluginCecremote::GetAdapterStatus(int adapter,
+                                        cCECStatusPageAdapter &status)
+{
+    if ((adapter < 0) || (adapter >= (int)mCECRemotes.size())) {
+        return false;
+    }
+    cCECRemote *remote = mCECRemotes[adapter];
+    cCECBusSnapshot snapshot;
+
+    memset(&status, 0, sizeof(status));
+    strncpy(status.mId, remote->GetAdapterId().c_str(), sizeof(status.mId) - 1);
+    status.mConnected = remote->IsConnected() ? 1 : 0;
+    status.mWorkQueue = remote->GetWorkQueueSize();
+    status.mExecQueue = remote->GetExecQueueSize();
+    remote->mBusState.GetSnapshot(snapshot);
+    for (int i = 0; i < cCECBusSnapshot::MAX_DEVICES; i++) {
+        status.mPower[i] = (uint8_t)snapshot.mPower[i];
+        status.mPhysicalAddress[i] = snapshot.mPhysicalAddress[i];
+    }
+    status.mActiveSource = (int8_t)snapshot.mActiveSource;
+    status.mActiveSourcePhysical = snapshot.mActiveSourcePhysical;
+    return true;
+}
+
+/**
+ * @brief Pushes a command list to the adapters addressed by the commands.
+ *
+ * The list is split per adapter, so each adapter keeps the configured
+ * order while different CEC buses are handled in parallel.
+ *
+ * @param cmdList List of commands to execute
+ * @param event Optional event which triggered the commands
+ */
+void cPluginCecremote::PushCmdQueue(const cCmdQueue &cmdList,
+                                    const cCECEvent *event)
+{
+    if (mCECRemotes.size() == 1) {
+        mCECRemotes[0]->PushCmdQueue(cmdList, event);
+        return;
+    }
+    std::vector<cCmdQueue> split(mCECRemotes.size());
+    for (const cCmd &cmd : cmdList) {
+        int adapter = cmd.mDevice.mAdapter;
+        if ((adapter < 0) || (adapter >= (int)split.size())) {
+            adapter = 0;
+        }
+        split[adapter].push_back(cmd);
+    }
+    for (size_t i = 0; i < split.size(); i++) {
+        if (!split[i].empty()) {
+            mCECRemotes[i]->PushCmdQueue(split[i], event);
+        }
+    }
+}
+
+/**
+ * @brief Selects the CEC remote handlers addressed by a SVDRP option.
+ *
+ * @param option Adapter id, nullptr or empty string selects all adapters
+ * @param remotes Receives the selected handlers
+ * @return false if no adapter with the given id exists
+ */
+bool cPluginCecremote::SelectRemotes(const char *option,
+                                     std::vector<cCECRemote *> &remotes)
+{
+    remotes.clear();
+    for (cCECRemote *remote : mCECRemotes) {
+        if ((option == nullptr) || (*option == '\0') ||
+            (strcasecmp(option, remote->GetAdapterId().c_str()) == 0)) {
+            remotes.push_back(remote);
+        }
+    }
+    return !remotes.empty();
 }
 
 /**
@@ -288,8 +533,8 @@ void cPluginCecremote::StartPlayer(const cCECMenu &menuitem)
  */
 cOsdObject *cPluginCecremote::MainMenuAction(void)
 {
-    if (cCECOsd::mMenuItems.size() == 1) {
-        StartPlayer(cCECOsd::mMenuItems[0]);
+    if (mMenuModel->mMenus.size() == 1) {
+        StartPlayer(mMenuModel->mMenus[0]);
         return nullptr;
     }
     return new cCECOsd(this);
@@ -318,18 +563,171 @@ bool cPluginCecremote::SetupParse(const char *Name, const char *Value)
 }
 
 /**
- * @brief Handles custom service requests from other plugins.
+ * @brief Handles service requests from other plugins.
+ *
+ * The ids and structures are defined in cecremoteservice.h.
  *
  * @param Id Service identifier
- * @param Data Service data
- * @return false (no services implemented)
+ * @param Data Service data, nullptr to check if the id is supported
+ * @return true if the id is supported
  */
 bool cPluginCecremote::Service(const char *Id, void *Data)
 {
-    // Handle custom service requests from other plugins
+    if (Id == nullptr) {
+        return false;
+    }
+    if (strcmp(Id, CECREMOTE_SERVICE_COMMAND_V1) == 0) {
+        if (Data != nullptr) {
+            ServiceCommand(*(cCECServiceCommand_v1 *)Data);
+        }
+        return true;
+    }
+    if (strcmp(Id, CECREMOTE_SERVICE_MENU_V1) == 0) {
+        if (Data != nullptr) {
+            ServiceMenu(*(cCECServiceMenu_v1 *)Data);
+        }
+        return true;
+    }
+    if (strcmp(Id, CECREMOTE_SERVICE_STATUS_V1) == 0) {
+        if (Data != nullptr) {
+            cCECServiceStatus_v1 *req = (cCECServiceStatus_v1 *)Data;
+            cMutexLock lock(&mRemotesMutex);
+            req->mAdapterCount = mCECRemotes.size();
+            req->mResult = GetAdapterStatus(req->mAdapter, req->mStatus);
+        }
+        return true;
+    }
+    if (strcmp(Id, CECREMOTE_SERVICE_SUBSCRIBE_V1) == 0) {
+        if (Data != nullptr) {
+            ServiceSubscribe(*(cCECServiceSubscribe_v1 *)Data);
+        }
+        return true;
+    }
     return false;
 }
 
+/**
+ * @brief Queues a command requested by another plugin.
+ *
+ * @param req The request
+ */
+void cPluginCecremote::ServiceCommand(cCECServiceCommand_v1 &req)
+{
+    cCECDevice dev;
+    cCmd cmd;
+
+    req.mResult = false;
+    if ((req.mDevice == nullptr) ||
+        !mConfigFileParser.FindDevice(req.mDevice, dev)) {
+        Esyslog("Service: device %s not found",
+                req.mDevice ? req.mDevice : "(null)");
+        return;
+    }
+    switch (req.mCommand) {
+    case cCECServiceCommand_v1::POWERON:
+        cmd = cCmd(CEC_POWERON, 0, &dev);
+        break;
+    case cCECServiceCommand_v1::POWEROFF:
+        cmd = cCmd(CEC_POWEROFF, 0, &dev);
+        break;
+    case cCECServiceCommand_v1::VDRKEY:
+        if ((req.mValue < 0) || (req.mValue >= kNone)) {
+            Esyslog("Service: invalid key %d", req.mValue);
+            return;
+        }
+        cmd = cCmd(CEC_VDRKEYPRESS, req.mValue, &dev);
+        break;
+    case cCECServiceCommand_v1::TEXTVIEWON:
+        cmd = cCmd(CEC_TEXTVIEWON, 0, &dev);
+        break;
+    case cCECServiceCommand_v1::MAKEACTIVE:
+        cmd = cCmd(CEC_MAKEACTIVE, 0, &dev);
+        break;
+    case cCECServiceCommand_v1::MAKEINACTIVE:
+        cmd = cCmd(CEC_MAKEINACTIVE, 0, &dev);
+        break;
+    default:
+        Esyslog("Service: invalid command %d", req.mCommand);
+        return;
+    }
+    cMutexLock lock(&mRemotesMutex);
+    if ((dev.mAdapter < 0) || (dev.mAdapter >= (int)mCECRemotes.size())) {
+        Esyslog("Service: adapter %d not available", dev.mAdapter);
+        return;
+    }
+    if (req.mWait) {
+        mCECRemotes[dev.mAdapter]->PushWaitCmd(cmd);
+    }
+    else {
+        mCECRemotes[dev.mAdapter]->PushCmd(cmd);
+    }
+    req.mResult = true;
+}
+
+/**
+ * @brief Queues the commands of a menu requested by another plugin.
+ *
+ * @param req The request
+ */
+void cPluginCecremote::ServiceMenu(cCECServiceMenu_v1 &req)
+{
+    cCECMenu menu;
+
+    req.mResult = false;
+    if ((req.mMenu == nullptr) || !FindMenu(req.mMenu, menu)) {
+        Esyslog("Service: menu %s not found",
+                req.mMenu ? req.mMenu : "(null)");
+        return;
+    }
+    cMutexLock lock(&mRemotesMutex);
+    if (mCECRemotes.empty()) {
+        Esyslog("Service: no adapter available");
+        return;
+    }
+    if (menu.isMenuPowerToggle()) {
+        int adapter = menu.mDevice.mAdapter;
+        if ((adapter < 0) || (adapter >= (int)mCECRemotes.size())) {
+            Esyslog("Service: adapter %d not available", adapter);
+            return;
+        }
+        cCmd cmd(CEC_EXECTOGGLE, menu.mDevice, menu.mOnPowerOn,
+                 menu.mOnPowerOff);
+        mCECRemotes[adapter]->PushCmd(cmd);
+    }
+    else {
+        cCECEvent event("service");
+        PushCmdQueue(menu.mOnStart, &event);
+    }
+    req.mResult = true;
+}
+
+/**
+ * @brief Registers or unregisters an event callback of another plugin.
+ *
+ * @param req The request
+ */
+void cPluginCecremote::ServiceSubscribe(cCECServiceSubscribe_v1 &req)
+{
+    cMutexLock lock(&mEventCallbackMutex);
+    auto cb = std::make_pair(req.mCallback, req.mContext);
+    auto i = std::find(mEventCallbacks.begin(), mEventCallbacks.end(), cb);
+
+    req.mResult = false;
+    if (req.mCallback == nullptr) {
+        return;
+    }
+    if (req.mSubscribe) {
+        if (i == mEventCallbacks.end()) {
+            mEventCallbacks.push_back(cb);
+        }
+        req.mResult = true;
+    }
+    else if (i != mEventCallbacks.end()) {
+        mEventCallbacks.erase(i);
+        req.mResult = true;
+    }
+}
+
 /**
  * @brief Returns SVDRP help pages.
  * @return Array of help strings for each SVDRP command
@@ -339,13 +737,16 @@ const char **cPluginCecremote::SVDRPHelpPages(void)
     static const char *HelpPages[] = {
             "LSTK\nList known CEC keycodes\n",
             "LSTD\nList CEC devices\n",
+            "TOPO [adapter]\nList the HDMI tree (all adapters if none is given)",
             "KEYM\nList available key map\n",
             "VDRK [id]\nDisplay VDR->CEC key map with id\n",
             "CECK [id]\nDisplay CEC->VDR key map with id\n",
             "GLOK [id]\nDisplay Global VDR -> CEC key map with id\n",
-            "DISC\nDisconnect CEC",
-            "CONN\nConnect CEC",
+            "DISC [adapter]\nDisconnect CEC (all adapters if none is given)",
+            "CONN [adapter]\nConnect CEC (all adapters if none is given)",
             "STAT\nPlugin status",
+            "TRCE [FILE]\nDump the trace as Chrome trace JSON (with FILE to trace.json\n"
+            "    in the plugin cache directory)",
             nullptr
     };
     return HelpPages;
@@ -354,7 +755,8 @@ const char **cPluginCecremote::SVDRPHelpPages(void)
 /**
  * @brief Processes SVDRP commands.
  *
- * Handles LSTD, LSTK, KEYM, VDRK, CECK, GLOK, DISC, CONN, and STAT commands.
+ * Handles LSTD, TOPO, LSTK, KEYM, VDRK, CECK, GLOK, DISC, CONN, STAT and TRCE
+ * commands.
  *
  * @param Command Command name
  * @param Option Command option/argument
@@ -368,7 +770,25 @@ cString cPluginCecremote::SVDRPCommand(const char *Command, const char *Option,
         return getStatus();
     }
     else if (strcasecmp(Command, "LSTD") == 0) {
-        return mCECRemote->ListDevices();
+        cString s = "";
+        for (cCECRemote *remote : mCECRemotes) {
+            s = cString::sprintf("%s%s%s", *s, (**s == '\0') ? "" : "\n",
+                                 *remote->ListDevices());
+        }
+        return s;
+    }
+    else if (strcasecmp(Command, "TOPO") == 0) {
+        std::vector<cCECRemote *> remotes;
+        if (!SelectRemotes(Option, remotes)) {
+            ReplyCode = 901;
+            return cString::sprintf("Error: Adapter %s not found", Option);
+        }
+        cString s = "";
+        for (cCECRemote *remote : remotes) {
+            s = cString::sprintf("%s%s%s", *s, (**s == '\0') ? "" : "\n",
+                                 *remote->ListTopology());
+        }
+        return s;
     }
     else if (strcasecmp(Command, "KEYM") == 0) {
         return mKeyMaps.ListKeymaps();
@@ -400,15 +820,40 @@ cString cPluginCecremote::SVDRPCommand(const char *Command, const char *Option,
         string s = Option;
         return mKeyMaps.ListGLOBALKeyMap(s);
     }
-    else if (strcasecmp(Command, "DISC") == 0) {
-        cCmd cmd(CEC_DISCONNECT);
-        mCECRemote->PushWaitCmd(cmd);
-        return "Disconnected";
+    else if ((strcasecmp(Command, "DISC") == 0) ||
+             (strcasecmp(Command, "CONN") == 0)) {
+        bool conn = (strcasecmp(Command, "CONN") == 0);
+        std::vector<cCECRemote *> remotes;
+        if (!SelectRemotes(Option, remotes)) {
+            ReplyCode = 901;
+            return cString::sprintf("Error: Adapter %s not found", Option);
+        }
+        for (cCECRemote *remote : remotes) {
+            cCmd cmd(conn ? CEC_CONNECT : CEC_DISCONNECT);
+            remote->PushWaitCmd(cmd);
+        }
+        return conn ? "Connected" : "Disconnected";
     }
-    else if (strcasecmp(Command, "CONN") == 0) {
-        cCmd cmd(CEC_CONNECT);
-        mCECRemote->PushWaitCmd(cmd);
-        return "Connected";
+    else if (strcasecmp(Command, "TRCE") == 0) {
+        if (!cTracer::IsEnabled()) {
+            ReplyCode = 901;
+            return "Error: Trace not enabled, see <tracebuffer>";
+        }
+        if ((Option == nullptr) || (*Option == '\0')) {
+            return cString(cTracer::Dump().c_str());
+        }
+        if (strcasecmp(Option, "FILE") != 0) {
+            ReplyCode = 901;
+            return "Error: Unexpected option";
+        }
+        // Never write to a path given over SVDRP
+        cString path = AddDirectory(CacheDirectory(PLUGIN_NAME_I18N),
+                                    "trace.json");
+        if (!cTracer::Write(path)) {
+            ReplyCode = 901;
+            return cString::sprintf("Error: Can not write %s", *path);
+        }
+        return cString::sprintf("Trace written to %s", *path);
     }
 
     ReplyCode = 901;
@@ -418,38 +863,59 @@ cString cPluginCecremote::SVDRPCommand(const char *Command, const char *Option,
 /**
  * @brief Sets the default keymaps from configuration.
  *
- * Activates the globally configured VDR, CEC, and GLOBAL keymaps.
+ * Activates the globally configured VDR, CEC, and GLOBAL keymaps and
+ * the CEC keymaps of the initiators from <initiatorkeymap>.
  */
 void cPluginCecremote::SetDefaultKeymaps()
 {
     mKeyMaps.SetActiveKeymaps(mConfigFileParser.mGlobalOptions.mVDRKeymap,
                               mConfigFileParser.mGlobalOptions.mCECKeymap,
                               mConfigFileParser.mGlobalOptions.mGLOBALKeymap);
+    for (const auto &i : mConfigFileParser.mGlobalOptions.mInitiatorKeymaps) {
+        try {
+            mKeyMaps.SetInitiatorKeymap(i.first, i.second);
+        }
+        catch (const std::out_of_range &e) {
+            Esyslog("Unknown CEC keymap %s for initiator %d",
+                    i.second.c_str(), i.first);
+        }
+    }
 }
 
 /**
  * @brief Returns plugin status information.
  *
- * Returns log level, queue sizes, and adapter connection state.
+ * Returns log level, the startup timing, and queue sizes and connection
+ * state of each adapter.
  *
  * @return Formatted status string
  */
 cString cPluginCecremote::getStatus(void)
 {
-    cString s;
-    const char *buf;
-    if (mCECRemote->IsConnected()) {
-        buf = "Connected";
+    cString s = cString::sprintf("Log Level %d\nStartup\n%s", SysLogLevel,
+                                 *mStartupTiming.Describe());
+
+    for (cCECRemote *remote : mCECRemotes) {
+        const char *buf;
+        if (remote->IsConnected()) {
+            buf = "Connected";
+        }
+        else {
+            buf = "Disconnected";
+        }
+        s = cString::sprintf("%s\nAdapter %s\n  Work Queue %d\n  Exec Queue %d\n  State %s\n%s",
+                *s, remote->GetAdapterId().c_str(),
+                remote->GetWorkQueueSize(),
+                remote->GetExecQueueSize(),
+                buf, *remote->GetRoutingStatus());
+        s = cString::sprintf("%s\n%s\n%s", *s, *remote->GetWatchdogStatus(),
+                             *remote->GetSchedulingStatus());
+        s = cString::sprintf("%s\n  Startup\n%s", *s,
+                             *remote->GetStartupTiming().Describe());
     }
-    else {
-        buf = "Disconnected";
+    if (mScriptRunner != nullptr) {
+        s = cString::sprintf("%s\n%s", *s, *mScriptRunner->GetStatistics());
     }
-    s = cString::sprintf("Log Level %d\nWork Queue %d\nExec Queue %d\nAdapter %s",
-            SysLogLevel,
-            mCECRemote->GetWorkQueueSize(),
-            mCECRemote->GetExecQueueSize(),
-            buf);
-
     return s;
 }
 
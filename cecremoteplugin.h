@@ -12,18 +12,29 @@
 #ifndef CECREMOTEPLUGIN_H
 #define CECREMOTEPLUGIN_H
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <vdr/plugin.h>
 #include "cecremote.h"
 #include "configmenu.h"
 #include "configfileparser.h"
 #include "statusmonitor.h"
+#include "busevent.h"
+#include "cecremoteservice.h"
 
 namespace cecplugin {
 
 class cCECOsd;
+class cCECMenuModel;
 class cStatusMonitor;
+class cControlSocket;
+class cStatusPage;
+class cEventSocket;
+class cScriptRunner;
+class cCECWatchdog;
+class cMetricsExporter;
 
 /**
  * @class cPluginCecremote
@@ -34,11 +45,14 @@ class cStatusMonitor;
  * - Configuration file parsing
  * - OSD menu integration
  * - SVDRP command interface
- * - Command routing to the CEC remote handler
+ * - Command routing to the CEC remote handler of the addressed adapter
  */
 class cPluginCecremote : public cPlugin {
     friend class cStatusMonitor;
+    friend class cControlSocket;
 protected:
+    /** @brief Time for a libCEC call in progress at the shutdown deadline. */
+    static constexpr const int STOP_GRACE_MS = 1000;
 
     int mCECLogLevel = CEC_LOG_ERROR | CEC_LOG_WARNING | CEC_LOG_DEBUG;
 
@@ -46,9 +60,21 @@ protected:
     std::string mCfgFile = "cecremote.xml";  ///< Configuration file name
 
     cConfigFileParser mConfigFileParser;  ///< XML configuration parser
-    cCECRemote *mCECRemote = nullptr;     ///< CEC communication handler
+    std::shared_ptr<const cCECMenuModel> mMenuModel; ///< Menu entries for the OSD
+    std::vector<cCECRemote *> mCECRemotes; ///< CEC communication handler per adapter
     cStatusMonitor *mStatusMonitor = nullptr;  ///< VDR status event monitor
+    cControlSocket *mControlSocket = nullptr;  ///< Local control socket for scripts
+    cStatusPage *mStatusPage = nullptr;  ///< Shared memory status page
+    cEventSocket *mEventSocket = nullptr;  ///< Event subscription socket
+    cScriptRunner *mScriptRunner = nullptr;  ///< Supervisor of <exec> scripts
+    cCECWatchdog *mWatchdog = nullptr;     ///< Detects hung libCEC calls
+    cMetricsExporter *mMetrics = nullptr;  ///< Writes the Prometheus metrics file
+    cMutex mRemotesMutex;                  ///< Protects mCECRemotes against Stop() during service calls
+    cMutex mEventCallbackMutex;            ///< Protects mEventCallbacks
+    /** @brief Event callbacks registered by other plugins, with context. */
+    std::vector<std::pair<cCECServiceCallback_v1, void *>> mEventCallbacks;
     bool mStartManually = true;  ///< true if VDR was started manually (not by timer)
+    cStartupTiming mStartupTiming;  ///< Phases of Initialize()
 
     /**
      * @brief Gets the full path to the configuration directory.
@@ -77,14 +103,52 @@ protected:
      */
     void ExecToggle(cCECMenu menu) {
         cCmd cmd(CEC_EXECTOGGLE, menu.mDevice, menu.mOnPowerOn, menu.mOnPowerOff);
-        mCECRemote->PushWaitCmd(cmd);
+        GetRemote(menu.mDevice.mAdapter)->PushWaitCmd(cmd);
     }
 
+    /**
+     * @brief Gets the CEC remote handler of an adapter.
+     * @param adapter Index of the adapter, invalid values select adapter 0.
+     * @return The CEC remote handler.
+     */
+    cCECRemote *GetRemote(int adapter) {
+        if ((adapter < 0) || (adapter >= (int)mCECRemotes.size())) {
+            adapter = 0;
+        }
+        return mCECRemotes[adapter];
+    }
+
+    /**
+     * @brief Selects the CEC remote handlers addressed by a SVDRP option.
+     * @param option Adapter id or nullptr/empty for all adapters.
+     * @param remotes Receives the selected handlers.
+     * @return false if no adapter with this id exists.
+     */
+    bool SelectRemotes(const char *option, std::vector<cCECRemote *> &remotes);
+
     /**
      * @brief Gets the current plugin status as a string.
      * @return Status information including queue sizes and connection state.
      */
     cString getStatus(void);
+
+    /**
+     * @brief Executes a CECREMOTE_SERVICE_COMMAND_V1 request.
+     * @param req The request.
+     */
+    void ServiceCommand(cCECServiceCommand_v1 &req);
+
+    /**
+     * @brief Executes a CECREMOTE_SERVICE_MENU_V1 request.
+     * @param req The request.
+     */
+    void ServiceMenu(cCECServiceMenu_v1 &req);
+
+    /**
+     * @brief Executes a CECREMOTE_SERVICE_SUBSCRIBE_V1 request.
+     * @param req The request.
+     */
+    void ServiceSubscribe(cCECServiceSubscribe_v1 &req);
 public:
     cKeyMaps mKeyMaps;  ///< Key mapping tables (CEC <-> VDR)
 
@@ -203,22 +267,101 @@ public:
     void StartPlayer(const cCECMenu &menuitem);
 
     /**
-     * @brief Pushes a command to the CEC remote queue.
+     * @brief Pushes a command to the queue of the addressed adapter.
      * @param cmd Command to execute.
      */
-    void PushCmd(const cCmd &cmd) {mCECRemote->PushCmd(cmd);}
+    void PushCmd(const cCmd &cmd) {GetRemote(cmd.mDevice.mAdapter)->PushCmd(cmd);}
 
     /**
-     * @brief Pushes multiple commands to the CEC remote queue.
+     * @brief Pushes multiple commands to the queues of the addressed adapters.
+     *
+     * The order of the commands is preserved for each adapter, the adapters
+     * process their part of the list in parallel.
      * @param cmdList List of commands to execute.
+     * @param event Optional event which triggered the commands.
+     */
+    void PushCmdQueue(const cCmdQueue &cmdList, const cCECEvent *event = nullptr);
+
+    /**
+     * @brief Notifies the status page that the plugin state has changed.
+     */
+    void StatusChanged(void);
+
+    /**
+     * @brief Publishes an event to the subscribers, never blocks.
+     * @param event The event, the time is set by this function.
+     */
+    void PublishEvent(cCECBusEvent &event);
+
+    /**
+     * @brief Gets the supervisor of the <exec> scripts.
+     * @return The script runner, valid while the plugin is started.
+     */
+    cScriptRunner *GetScriptRunner() {return mScriptRunner;}
+
+    /**
+     * @brief Gets the cached state of an adapter.
+     * @param adapter Index of the adapter.
+     * @param status Receives the state.
+     * @return false if the adapter does not exist.
+     */
+    bool GetAdapterStatus(int adapter, cCECStatusPageAdapter &status);
+
+    /**
+     * @brief Forwards a VDR key to the <audiodevice> via the global key map.
+     *
+     * Keys without an entry in the active global key map are dropped
+     * before any command is queued.
+     * @param key VDR key to forward.
+     */
+    void ForwardGlobalKey(eKeys key) {
+        if (!mKeyMaps.IsGlobalKeyMapped(key)) {
+            return;
+        }
+        cCmd cmd(CEC_GLOBALKEYPRESS, (int)key,
+                 &mConfigFileParser.mGlobalOptions.mAudioDevice);
+        PushCmd(cmd);
+    }
+
+    /**
+     * @brief Gets a counter which changes with the cached state of any bus.
+     * @return Sum of the generations of all adapters.
      */
-    void PushCmdQueue(const cCmdQueue &cmdList) {mCECRemote->PushCmdQueue(cmdList);}
+    uint32_t GetBusGeneration() {
+        uint32_t gen = 0;
+        for (cCECRemote *remote : mCECRemotes) {
+            gen += remote->mBusState.GetGeneration();
+        }
+        return gen;
+    }
 
     /**
-     * @brief Gets the list of configured menu items.
-     * @return Pointer to the menu list.
+     * @brief Copies the cached state of an adapter without bus access.
+     * @param adapter Index of the adapter.
+     * @param snapshot Receives the cached state.
      */
-    cCECMenuList *GetMenuList() {return &mConfigFileParser.mMenuList;}
+    void GetBusSnapshot(int adapter, cCECBusSnapshot &snapshot) {
+        GetRemote(adapter)->mBusState.GetSnapshot(snapshot);
+    }
+
+    /**
+     * @brief Asks a device for its power status without waiting.
+     *
+     * The answer updates the cached state when it is received.
+     * @param device The device to ask.
+     */
+    void RequestPowerStatus(const cCECDevice &device) {
+        cCmd cmd(CEC_SEND);
+        cmd.mDevice = device;
+        cmd.mCecOpcode = CEC_OPCODE_GIVE_DEVICE_POWER_STATUS;
+        PushCmd(cmd);
+    }
+
+    /**
+     * @brief Gets the model of the configured menu items.
+     * @return The model, shared with open menus.
+     */
+    std::shared_ptr<const cCECMenuModel> GetMenuModel() {return mMenuModel;}
 
     /**
      * @brief Checks if VDR was started manually.
@@ -227,13 +370,27 @@ public:
     bool GetStartManually() {return mStartManually;}
 
     /**
-     * @brief Gets the map of CEC command handlers.
-     * @return Pointer to the command handler map.
+     * @brief Gets the timing of the plugin startup phases.
+     * @return Phases recorded by Initialize().
      */
-    mapCommandHandler *GetCECCommandHandlers() {
+    const cStartupTiming &GetStartupTiming() const {return mStartupTiming;}
+
+    /**
+     * @brief Gets the table of CEC command handlers.
+     * @return Pointer to the command handler table.
+     */
+    const cCECCommandHandlerTable *GetCECCommandHandlers() {
         return &mConfigFileParser.mGlobalOptions.mCECCommandHandlers;
     }
 
+    /**
+     * @brief Gets the list of <onactivesource> handlers.
+     * @return Pointer to the handler list.
+     */
+    cCECCommandHandlerList *GetActiveSourceHandlers() {
+        return &mConfigFileParser.mGlobalOptions.mActiveSourceHandlers;
+    }
+
     /**
      * @brief Finds a menu configuration by name.
      * @param menuname Name of the menu to find.
@@ -0,0 +1,114 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This file defines the Service() interface for other plugins.
+ */
+
+#ifndef CECREMOTESERVICE_H_
+#define CECREMOTESERVICE_H_
+
+#include <stdint.h>
+
+#include "busevent.h"
+#include "statuspage.h"
+
+namespace cecplugin {
+
+/**
+ * @brief Service ids of the plugin.
+ *
+ * The ids are versioned, an incompatible change of a structure gets a new
+ * id. Calling Service() with Data == nullptr checks if an id is supported.
+ * All requests are handled without waiting for the CEC bus, unless
+ * explicitly requested.
+ *
+ * Example:
+ * @code
+ * cCECServiceCommand_v1 cmd = {};
+ * cmd.mDevice = "TV";
+ * cmd.mCommand = cCECServiceCommand_v1::POWERON;
+ * cPluginManager::CallFirstService(CECREMOTE_SERVICE_COMMAND_V1, &cmd);
+ * @endcode
+ */
+static constexpr char const *CECREMOTE_SERVICE_COMMAND_V1   = "CECRemote-Command-v1";
+static constexpr char const *CECREMOTE_SERVICE_MENU_V1      = "CECRemote-Menu-v1";
+static constexpr char const *CECREMOTE_SERVICE_STATUS_V1    = "CECRemote-Status-v1";
+static constexpr char const *CECREMOTE_SERVICE_SUBSCRIBE_V1 = "CECRemote-Subscribe-v1";
+
+/**
+ * @brief Sends a command to a device (CECREMOTE_SERVICE_COMMAND_V1).
+ */
+struct cCECServiceCommand_v1 {
+    /** @brief Command to execute. */
+    enum eCommand {
+        POWERON,       ///< Power on the device
+        POWEROFF,      ///< Set the device to standby
+        VDRKEY,        ///< Send the VDR key mValue using the active VDR key map
+        TEXTVIEWON,    ///< Send TEXT_VIEW_ON to the device
+        MAKEACTIVE,    ///< Make VDR the active source
+        MAKEINACTIVE   ///< Remove VDR as active source
+    };
+    const char *mDevice = nullptr;  ///< In: device id or logical address
+    int mCommand = POWERON;         ///< In: eCommand
+    int mValue = 0;                 ///< In: eKeys for VDRKEY
+    bool mWait = false;             ///< In: wait until the command is processed
+    bool mResult = false;           ///< Out: true if the command was queued
+};
+
+/**
+ * @brief Queues the commands of a <menu> (CECREMOTE_SERVICE_MENU_V1).
+ *
+ * For a menu using <onpoweron>/<onpoweroff> the power status is toggled,
+ * otherwise the <onstart> commands are queued. The still picture player
+ * is not started.
+ */
+struct cCECServiceMenu_v1 {
+    const char *mMenu = nullptr;    ///< In: menu name
+    bool mResult = false;           ///< Out: true if the menu was found
+};
+
+/**
+ * @brief Reads the cached state of an adapter (CECREMOTE_SERVICE_STATUS_V1).
+ *
+ * The same data as published on the status page, no request is sent to
+ * the CEC bus.
+ */
+struct cCECServiceStatus_v1 {
+    int mAdapter = 0;                ///< In: index of the adapter
+    int mAdapterCount = 0;           ///< Out: number of configured adapters
+    cCECStatusPageAdapter mStatus;   ///< Out: state of the adapter
+    bool mResult = false;            ///< Out: true if the adapter exists
+};
+
+/**
+ * @brief Callback for events, called from the plugin threads.
+ *
+ * The callback must return quickly and must not call Service() of
+ * this plugin.
+ * @param event The event.
+ * @param context Context given at registration.
+ */
+typedef void (*cCECServiceCallback_v1)(const cCECBusEvent *event, void *context);
+
+/**
+ * @brief Registers an event callback (CECREMOTE_SERVICE_SUBSCRIBE_V1).
+ *
+ * A callback is unregistered with mSubscribe = false and the same
+ * callback and context. After unregistering, the callback is no longer
+ * called, so the context may be freed.
+ */
+struct cCECServiceSubscribe_v1 {
+    cCECServiceCallback_v1 mCallback = nullptr; ///< In: function to call
+    void *mContext = nullptr;       ///< In: passed to the callback
+    bool mSubscribe = true;         ///< In: true to register, false to unregister
+    bool mResult = false;           ///< Out: true on success
+};
+
+} // namespace cecplugin
+
+#endif /* CECREMOTESERVICE_H_ */
@@ -23,18 +23,21 @@ namespace cecplugin {
  *
  * Stores device addressing information from the <device> XML tag.
  * A device can be identified by either its physical address (HDMI topology)
- * or logical address (CEC device type).
+ * or logical address (CEC device type). The adapter index selects the
+ * CEC bus (see <adapter>) on which the device is reached.
  */
 class cCECDevice {
 public:
     uint16_t mPhysicalAddress;  ///< Physical HDMI address (e.g., 0x1000 for HDMI port 1)
     cec_logical_address mLogicalAddressDefined;  ///< Logical address from config
     cec_logical_address mLogicalAddressUsed;     ///< Actually resolved logical address
+    int mAdapter;               ///< Index of the CEC adapter the device is connected to
 
     /** @brief Default constructor - initializes to unknown device. */
     cCECDevice() : mPhysicalAddress(0),
                    mLogicalAddressDefined(CECDEVICE_UNKNOWN),
-                   mLogicalAddressUsed(CECDEVICE_UNKNOWN) {};
+                   mLogicalAddressUsed(CECDEVICE_UNKNOWN),
+                   mAdapter(0) {};
 
     /**
      * @brief Assignment operator.
@@ -45,6 +48,7 @@ public:
         mPhysicalAddress = c.mPhysicalAddress;
         mLogicalAddressDefined = c.mLogicalAddressDefined;
         mLogicalAddressUsed = c.mLogicalAddressUsed;
+        mAdapter = c.mAdapter;
         return *this;
     }
 };
@@ -71,9 +75,42 @@ typedef enum {
     CEC_RECONNECT,         ///< Reconnect to CEC adapter
     CEC_CONNECT,           ///< Connect to CEC adapter
     CEC_DISCONNECT,        ///< Disconnect from CEC adapter
-    CEC_COMMAND            ///< Generic CEC command
+    CEC_COMMAND,           ///< Generic CEC command
+    CEC_GLOBALKEYPRESS,    ///< Forward a VDR key using the global key map
+    CEC_WAITPOWER,         ///< Wait until a device reaches a power status
+    CEC_DELAY,             ///< Pause the command list
+    CEC_SEND,              ///< Transmit a raw CEC frame
+    CEC_IF,                ///< Execute commands depending on the power status
+    CEC_KEYMAP,            ///< Switch the active key maps
+    CEC_SOURCECHANGED,     ///< The active source on the bus has changed
+    CEC_ROUTE,             ///< Route the HDMI switches to a device
+    CEC_STANDBYGROUP       ///< Standby several devices in parallel (mPoweroff)
 } CECCommand;
 
+/**
+ * @class cCECEvent
+ * @brief Describes the event which triggered a command list.
+ *
+ * Passed to scripts started by <exec>, so they do not need to query the
+ * CEC bus to find out why they were started.
+ */
+class cCECEvent {
+public:
+    std::string mName;                         ///< Event name (e.g. "ceccommand")
+    cec_opcode mOpcode = CEC_OPCODE_NONE;      ///< Received CEC opcode
+    cec_logical_address mInitiator = CECDEVICE_UNKNOWN; ///< Sender of the opcode
+    std::vector<uint8_t> mParams;              ///< Parameters of the opcode
+
+    /** @brief Default constructor. */
+    cCECEvent() = default;
+
+    /**
+     * @brief Constructs an event without CEC opcode.
+     * @param name Event name.
+     */
+    explicit cCECEvent(const std::string &name) : mName(name) {};
+};
+
 class cCmd;
 
 typedef std::list<cCmd> cCmdQueue;
@@ -97,9 +134,19 @@ public:
     std::string mExec;               ///< Shell command string (for CEC_EXECSHELL)
     int mSerial = -1;                ///< Serial number for synchronous commands
     cCmdQueue mPoweron;              ///< Commands to run on power on (for toggle)
-    cCmdQueue mPoweroff;             ///< Commands to run on power off (for toggle)
+    cCmdQueue mPoweroff;             ///< Commands to run on power off (for toggle),
+                                     ///< devices for CEC_STANDBYGROUP
     cec_opcode mCecOpcode = CEC_OPCODE_NONE;  ///< CEC opcode (for CEC_COMMAND)
     cec_logical_address mCecLogicalAddress = CECDEVICE_UNKNOWN;  ///< Source device
+    std::vector<uint8_t> mParams;    ///< CEC parameters (for CEC_SEND)
+    int mTimeoutMs = 0;              ///< Timeout (for CEC_WAITPOWER, CEC_EXECSHELL)
+    bool mAsync = false;             ///< Run in the script pool (for CEC_EXECSHELL)
+    cCmdQueue mThen;                 ///< Commands if condition matches (for CEC_IF)
+    cCmdQueue mElse;                 ///< Commands otherwise (for CEC_IF)
+    std::string mVDRKeymap;          ///< VDR key map id (for CEC_KEYMAP)
+    std::string mCECKeymap;          ///< CEC key map id (for CEC_KEYMAP)
+    std::string mGLOBALKeymap;       ///< Global key map id (for CEC_KEYMAP)
+    cCECEvent mEvent;                ///< Event which triggered the command
 
     /** @brief Default constructor. */
     cCmd() = default;
@@ -153,6 +200,15 @@ public:
         mPoweroff = c.mPoweroff;
         mCecOpcode = c.mCecOpcode;
         mCecLogicalAddress = c.mCecLogicalAddress;
+        mParams = c.mParams;
+        mTimeoutMs = c.mTimeoutMs;
+        mAsync = c.mAsync;
+        mThen = c.mThen;
+        mElse = c.mElse;
+        mVDRKeymap = c.mVDRKeymap;
+        mCECKeymap = c.mCECKeymap;
+        mGLOBALKeymap = c.mGLOBALKeymap;
+        mEvent = c.mEvent;
         return *this;
     }
 };
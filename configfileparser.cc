@@ -11,6 +11,11 @@
 
 #include <vdr/plugin.h>
 #include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <sched.h>
+#include <algorithm>
 #include <stdexcept>
 #include "ceclog.h"
 #include "configfileparser.h"
@@ -51,9 +56,50 @@ void cConfigFileParser::parseOnCecCommand(const xml_node node) {
 
     const char *device = node.attribute(XML_INITIATOR).as_string("");
     getDevice(device, h.mDevice, getLineNumber(node.offset_debug()));
-    Dsyslog("Handle Command %d Device %d %d\n", h.mCecOpCode,
-            h.mDevice.mLogicalAddressDefined, h.mDevice.mLogicalAddressUsed);
+    getParamMatch(node.attribute(XML_PARAMS).as_string(""), h.mParams,
+                  getLineNumber(node.offset_debug()));
+    Dsyslog("Handle Command %d Device %d %d (%d params)\n", h.mCecOpCode,
+            h.mDevice.mLogicalAddressDefined, h.mDevice.mLogicalAddressUsed,
+            h.mParams.mLength);
+
+    parseHandlerActions(node, h);
+    mGlobalOptions.mCECCommandHandlers.Add(h);
+}
+
+/**
+ * @brief Parses an <onactivesource> XML element.
+ *
+ * The handler is executed when the active source on the bus changes to
+ * the device given in the device attribute, or on every change if no
+ * device is given.
+ *
+ * @param node The XML node containing the onactivesource definition
+ * @throws cCECConfigException on parsing errors
+ */
+void cConfigFileParser::parseOnActiveSource(const xml_node node) {
+    cCECCommandHandler h;
 
+    h.mCecOpCode = CEC_OPCODE_ACTIVE_SOURCE;
+    const char *device = node.attribute(XML_DEVICE).as_string("");
+    if (device[0] != '\0') {
+        getDevice(device, h.mDevice, getLineNumber(node.offset_debug()));
+    }
+    Dsyslog("Handle active source Device %d %04x\n",
+            h.mDevice.mLogicalAddressDefined, h.mDevice.mPhysicalAddress);
+
+    parseHandlerActions(node, h);
+    mGlobalOptions.mActiveSourceHandlers.push_back(h);
+}
+
+/**
+ * @brief Parses the actions of an <onceccommand> or <onactivesource>.
+ *
+ * @param node The XML node of the handler
+ * @param h Handler receiving the command list and menus
+ * @throws cCECConfigException on parsing errors
+ */
+void cConfigFileParser::parseHandlerActions(const xml_node node,
+                                            cCECCommandHandler &h) {
     for (xml_node currentNode = node.first_child(); currentNode; currentNode =
             currentNode.next_sibling()) {
 
@@ -76,9 +122,6 @@ void cConfigFileParser::parseOnCecCommand(const xml_node node) {
             }
         }
     }
-
-    mGlobalOptions.mCECCommandHandlers.insert(
-            std::pair<cec_opcode, cCECCommandHandler>(h.mCecOpCode, h));
 }
 
 /**
@@ -281,8 +324,19 @@ void cConfigFileParser::parseList(const xml_node node, cCmdQueue &cmdlist)
         if (currentNode.type() == node_element)  // is element
         {
             Dsyslog("     %s %s\n", node.name(), currentNode.name());
-            checkSubElement(currentNode);
-            if (strcasecmp(currentNode.name(), XML_POWERON) == 0) {
+            // <else> of an <if> is parsed by parseBuiltin
+            if ((strcasecmp(node.name(), XML_IF) == 0) &&
+                (strcasecmp(currentNode.name(), XML_ELSE) == 0)) {
+                continue;
+            }
+            // <if> contains a command list
+            if (strcasecmp(currentNode.name(), XML_IF) != 0) {
+                checkSubElement(currentNode);
+            }
+            if (parseBuiltin(currentNode, cmd)) {
+                cmdlist.push_back(cmd);
+            }
+            else if (strcasecmp(currentNode.name(), XML_POWERON) == 0) {
                 cmd.mCmd = CEC_POWERON;
                 getDevice(currentNode.text().as_string(""), cmd.mDevice,
                         getLineNumber(currentNode.offset_debug()));
@@ -299,11 +353,19 @@ void cConfigFileParser::parseList(const xml_node node, cCmdQueue &cmdlist)
                 cmdlist.push_back(cmd);
             } else if (strcasecmp(currentNode.name(), XML_MAKEACTIVE) == 0) {
                 cmd.mCmd = CEC_MAKEACTIVE;
+                cmd.mDevice = cCECDevice();
+                cmd.mDevice.mAdapter = getAdapter(
+                        currentNode.attribute(XML_ADAPTER).as_string(""),
+                        getLineNumber(currentNode.offset_debug()));
                 cmd.mExec = "";
                 Dsyslog("         MAKEACTIVE\n");
                 cmdlist.push_back(cmd);
             } else if (strcasecmp(currentNode.name(),XML_MAKEINACTIVE) == 0) {
                 cmd.mCmd = CEC_MAKEINACTIVE;
+                cmd.mDevice = cCECDevice();
+                cmd.mDevice.mAdapter = getAdapter(
+                        currentNode.attribute(XML_ADAPTER).as_string(""),
+                        getLineNumber(currentNode.offset_debug()));
                 cmd.mExec = "";
                 Dsyslog("         MAKEINACTIVE\n");
                 cmdlist.push_back(cmd);
@@ -317,7 +379,20 @@ void cConfigFileParser::parseList(const xml_node node, cCmdQueue &cmdlist)
             } else if (strcasecmp(currentNode.name(), XML_EXEC) == 0) {
                 cmd.mCmd = CEC_EXECSHELL;
                 cmd.mExec = currentNode.text().as_string();
-                Dsyslog("         EXEC %s\n", cmd.mExec.c_str());
+                if (!textToInt(currentNode.attribute(XML_TIMEOUT).as_string("0"),
+                               cmd.mTimeoutMs) || (cmd.mTimeoutMs < 0)) {
+                    string s = "Invalid timeout in exec";
+                    throw cCECConfigException(
+                            getLineNumber(currentNode.offset_debug()), s);
+                }
+                if (!textToBool(currentNode.attribute(XML_ASYNC).as_string("false"),
+                                cmd.mAsync)) {
+                    string s = "Only true or false allowed for async";
+                    throw cCECConfigException(
+                            getLineNumber(currentNode.offset_debug()), s);
+                }
+                Dsyslog("         EXEC %s timeout %d async %d\n", cmd.mExec.c_str(),
+                        cmd.mTimeoutMs, cmd.mAsync);
                 cmdlist.push_back(cmd);
             }
             else {
@@ -329,6 +404,215 @@ void cConfigFileParser::parseList(const xml_node node, cCmdQueue &cmdlist)
     }
 }
 
+/**
+ * @brief Parses the built-in commands of a command list.
+ *
+ * Handles <waitpower>, <delay>, <send>, <if>, <keymap> and <route>, which are
+ * executed by the worker thread without starting a shell.
+ *
+ * @param node The XML node of the command
+ * @param cmd Reference to the command to fill
+ * @return true if the node is a built-in command
+ * @throws cCECConfigException on parsing errors
+ */
+bool cConfigFileParser::parseBuiltin(const xml_node node, cCmd &cmd)
+{
+    ptrdiff_t line = getLineNumber(node.offset_debug());
+
+    cmd = cCmd();
+    if (strcasecmp(node.name(), XML_WAITPOWER) == 0) {
+        cmd.mCmd = CEC_WAITPOWER;
+        getDevice(node.attribute(XML_DEVICE).as_string(""), cmd.mDevice, line);
+        cmd.mVal = getPowerStatus(node.attribute(XML_POWER).as_string("on"),
+                                  line);
+        if (!textToInt(node.attribute(XML_TIMEOUT).as_string("5000"),
+                       cmd.mTimeoutMs) || (cmd.mTimeoutMs < 0)) {
+            string s = "Invalid timeout for waitpower";
+            throw cCECConfigException(line, s);
+        }
+        Dsyslog("         WAITPOWER %d %d\n", cmd.mVal, cmd.mTimeoutMs);
+    }
+    else if (strcasecmp(node.name(), XML_DELAY) == 0) {
+        cmd.mCmd = CEC_DELAY;
+        cmd.mDevice.mAdapter = getAdapter(
+                node.attribute(XML_ADAPTER).as_string(""), line);
+        if (!textToInt(node.text().as_string("x"), cmd.mVal) ||
+            (cmd.mVal < 0)) {
+            string s = "Invalid delay";
+            throw cCECConfigException(line, s);
+        }
+        Dsyslog("         DELAY %d\n", cmd.mVal);
+    }
+    else if (strcasecmp(node.name(), XML_SEND) == 0) {
+        cmd.mCmd = CEC_SEND;
+        getDevice(node.attribute(XML_DEVICE).as_string(""), cmd.mDevice, line);
+        string opcode = node.attribute(XML_OPCODE).as_string("");
+        if (!textToInt(opcode, cmd.mCecOpcode)) {
+            if (!opcodeMap::getOpcode(opcode, cmd.mCecOpcode)) {
+                string s = "Invalid opcode " + opcode;
+                throw cCECConfigException(line, s);
+            }
+        }
+        getParams(node.attribute(XML_PARAMS).as_string(""), cmd.mParams, line);
+        Dsyslog("         SEND %02x (%d params)\n", cmd.mCecOpcode,
+                (int)cmd.mParams.size());
+    }
+    else if (strcasecmp(node.name(), XML_IF) == 0) {
+        cmd.mCmd = CEC_IF;
+        getDevice(node.attribute(XML_DEVICE).as_string(""), cmd.mDevice, line);
+        cmd.mVal = getPowerStatus(node.attribute(XML_POWER).as_string(""),
+                                  line);
+        Dsyslog("         IF %d\n", cmd.mVal);
+        // Commands before <else> are executed if the condition matches
+        xml_node elseNode = node.child(XML_ELSE);
+        parseList(node, cmd.mThen);
+        if (elseNode) {
+            parseList(elseNode, cmd.mElse);
+        }
+    }
+    else if (strcasecmp(node.name(), XML_KEYMAP) == 0) {
+        cmd.mCmd = CEC_KEYMAP;
+        string id = node.attribute(XML_ID).as_string(cKeyMaps::DEFAULTKEYMAP);
+        cmd.mVDRKeymap = node.attribute(XML_VDR).as_string(id.c_str());
+        cmd.mCECKeymap = node.attribute(XML_CEC).as_string(id.c_str());
+        cmd.mGLOBALKeymap = node.attribute(XML_GLOBALVDR).as_string(id.c_str());
+        Dsyslog("         KEYMAP VDR %s CEC %s GLOBAL %s\n",
+                cmd.mVDRKeymap.c_str(), cmd.mCECKeymap.c_str(),
+                cmd.mGLOBALKeymap.c_str());
+    }
+    else if (strcasecmp(node.name(), XML_ROUTE) == 0) {
+        cmd.mCmd = CEC_ROUTE;
+        getDevice(node.attribute(XML_DEVICE).as_string(""), cmd.mDevice, line);
+        Dsyslog("         ROUTE %04x\n", cmd.mDevice.mPhysicalAddress);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Converts a power state name to the CEC power status.
+ *
+ * @param text "on", or "standby"/"off"
+ * @param linenumber Line number for error reporting
+ * @return The CEC power status
+ * @throws cCECConfigException on invalid names
+ */
+cec_power_status cConfigFileParser::getPowerStatus(const char *text,
+                                                   ptrdiff_t linenumber)
+{
+    if (strcasecmp(text, "on") == 0) {
+        return CEC_POWER_STATUS_ON;
+    }
+    else if ((strcasecmp(text, "standby") == 0) ||
+             (strcasecmp(text, "off") == 0)) {
+        return CEC_POWER_STATUS_STANDBY;
+    }
+    string s = "Invalid power state ";
+    s += text;
+    throw cCECConfigException(linenumber, s);
+}
+
+/**
+ * @brief Converts a list of hex bytes to CEC parameters.
+ *
+ * @param text Bytes in hex separated by space, colon or comma (e.g. "10:00")
+ * @param params Receives the parameters
+ * @param linenumber Line number for error reporting
+ * @throws cCECConfigException on invalid bytes or too many parameters
+ */
+void cConfigFileParser::getParams(const char *text, std::vector<uint8_t> &params,
+                                  ptrdiff_t linenumber)
+{
+    params.clear();
+    const char *p = text;
+    while (*p != '\0') {
+        if ((*p == ' ') || (*p == ':') || (*p == ',') || (*p == '\t')) {
+            p++;
+            continue;
+        }
+        char *endp = nullptr;
+        long val = strtol(p, &endp, 16);
+        if ((endp == p) || (val < 0) || (val > 0xFF) ||
+            ((*endp != '\0') && (strchr(" :,\t", *endp) == nullptr))) {
+            string s = "Invalid CEC parameter in ";
+            s += text;
+            throw cCECConfigException(linenumber, s);
+        }
+        params.push_back((uint8_t)val);
+        p = endp;
+    }
+    if (params.size() > CEC_MAX_DATA_PACKET_SIZE) {
+        string s = "Too many CEC parameters in ";
+        s += text;
+        throw cCECConfigException(linenumber, s);
+    }
+}
+
+/**
+ * @brief Compiles a parameter pattern of <onceccommand>.
+ *
+ * Each byte is given by two hex digits, a digit x matches every value of
+ * this nibble (e.g. "1x" matches 10 to 1f). A byte followed by /mask is
+ * only compared in the bits of the mask (e.g. "80/80").
+ *
+ * @param text Bytes separated by space, colon or comma (e.g. "10:xx")
+ * @param match Receives the compiled pattern
+ * @param linenumber Line number for error reporting
+ * @throws cCECConfigException on invalid bytes or too many parameters
+ */
+void cConfigFileParser::getParamMatch(const char *text, cCECParamMatch &match,
+                                      ptrdiff_t linenumber)
+{
+    match = cCECParamMatch();
+    const char *p = text;
+    while (*p != '\0') {
+        if (strchr(" :,\t", *p) != nullptr) {
+            p++;
+            continue;
+        }
+        uint8_t value = 0;
+        uint8_t mask = 0;
+        bool ok = true;
+        for (int i = 0; (i < 2) && ok; i++, p++) {
+            value <<= 4;
+            mask <<= 4;
+            if ((*p == 'x') || (*p == 'X')) {
+                continue;
+            }
+            if (!isxdigit((unsigned char)*p)) {
+                ok = false;
+                break;
+            }
+            value |= isdigit((unsigned char)*p) ? (*p - '0') :
+                                                  (tolower(*p) - 'a' + 10);
+            mask |= 0xF;
+        }
+        if (ok && (*p == '/')) {
+            char *endp = nullptr;
+            long m = strtol(p + 1, &endp, 16);
+            ok = (endp != p + 1) && (m >= 0) && (m <= 0xFF);
+            mask &= (uint8_t)m;
+            value &= mask;
+            p = endp;
+        }
+        if (!ok || ((*p != '\0') && (strchr(" :,\t", *p) == nullptr))) {
+            string s = "Invalid CEC parameter pattern in ";
+            s += text;
+            throw cCECConfigException(linenumber, s);
+        }
+        if (match.mLength >= CEC_MAX_DATA_PACKET_SIZE) {
+            string s = "Too many CEC parameters in ";
+            s += text;
+            throw cCECConfigException(linenumber, s);
+        }
+        match.mValue[match.mLength] = value;
+        match.mMask[match.mLength] = mask;
+        match.mLength++;
+    }
+}
+
 /**
  * @brief Parses a <menu> XML element.
  *
@@ -467,10 +751,14 @@ cec_device_type cConfigFileParser::getDeviceType(const string &s)
  * HDMI port, keymaps, startup/shutdown commands, and event handlers.
  *
  * @param node The XML node containing the global section
+ * @param keymaps The keymaps parsed so far, to check the referenced ids
  * @throws cCECConfigException on parsing errors
  */
-void cConfigFileParser::parseGlobal(const pugi::xml_node node)
+void cConfigFileParser::parseGlobal(const pugi::xml_node node,
+                                    const cKeyMaps &keymaps)
 {
+    ptrdiff_t policyOffset = node.offset_debug();
+
     for (xml_node currentNode = node.first_child(); currentNode;
          currentNode = currentNode.next_sibling()) {
 
@@ -533,6 +821,126 @@ void cConfigFileParser::parseGlobal(const pugi::xml_node node)
             else if (strcasecmp(currentNode.name(), XML_AUDIODEVICE) == 0) {
                 getDevice(currentNode.text().as_string(""), mGlobalOptions.mAudioDevice, getLineNumber(currentNode.offset_debug()));
             }
+            // <controlsocket>
+            else if (strcasecmp(currentNode.name(), XML_CONTROLSOCKET) == 0) {
+                mGlobalOptions.mControlSocket = currentNode.text().as_string("");
+                Dsyslog("ControlSocket = %s \n", mGlobalOptions.mControlSocket.c_str());
+            }
+            // <statuspage>
+            else if (strcasecmp(currentNode.name(), XML_STATUSPAGE) == 0) {
+                mGlobalOptions.mStatusPage = currentNode.text().as_string("");
+                Dsyslog("StatusPage = %s \n", mGlobalOptions.mStatusPage.c_str());
+            }
+            // <exectimeout>
+            else if (strcasecmp(currentNode.name(), XML_EXECTIMEOUT) == 0) {
+                if (!textToInt(currentNode.text().as_string("0"),
+                               mGlobalOptions.mExecTimeoutMs) ||
+                    (mGlobalOptions.mExecTimeoutMs < 0)) {
+                    string s = "Invalid numeric in exectimeout";
+                    throw cCECConfigException(getLineNumber(currentNode.offset_debug()), s);
+                }
+                Dsyslog("ExecTimeout = %d \n", mGlobalOptions.mExecTimeoutMs);
+            }
+            // <execparallel>
+            else if (strcasecmp(currentNode.name(), XML_EXECPARALLEL) == 0) {
+                if (!textToInt(currentNode.text().as_string("2"),
+                               mGlobalOptions.mExecParallel) ||
+                    (mGlobalOptions.mExecParallel < 1)) {
+                    string s = "Invalid numeric in execparallel";
+                    throw cCECConfigException(getLineNumber(currentNode.offset_debug()), s);
+                }
+                Dsyslog("ExecParallel = %d \n", mGlobalOptions.mExecParallel);
+            }
+            // <watchdogtimeout>
+            else if (strcasecmp(currentNode.name(), XML_WATCHDOGTIMEOUT) == 0) {
+                if (!textToInt(currentNode.text().as_string("10000"),
+                               mGlobalOptions.mWatchdogTimeoutMs) ||
+                    (mGlobalOptions.mWatchdogTimeoutMs < 0)) {
+                    string s = "Invalid numeric in watchdogtimeout";
+                    throw cCECConfigException(getLineNumber(currentNode.offset_debug()), s);
+                }
+                Dsyslog("WatchdogTimeout = %d \n", mGlobalOptions.mWatchdogTimeoutMs);
+            }
+            // <stoptimeout>
+            else if (strcasecmp(currentNode.name(), XML_STOPTIMEOUT) == 0) {
+                if (!textToInt(currentNode.text().as_string("10000"),
+                               mGlobalOptions.mStopTimeoutMs) ||
+                    (mGlobalOptions.mStopTimeoutMs < 0)) {
+                    string s = "Invalid numeric in stoptimeout";
+                    throw cCECConfigException(getLineNumber(currentNode.offset_debug()), s);
+                }
+                Dsyslog("StopTimeout = %d \n", mGlobalOptions.mStopTimeoutMs);
+            }
+            // <metricsfile>
+            else if (strcasecmp(currentNode.name(), XML_METRICSFILE) == 0) {
+                mGlobalOptions.mMetricsFile = currentNode.text().as_string("");
+                Dsyslog("MetricsFile = %s \n", mGlobalOptions.mMetricsFile.c_str());
+            }
+            // <metricsinterval>
+            else if (strcasecmp(currentNode.name(), XML_METRICSINTERVAL) == 0) {
+                if (!textToInt(currentNode.text().as_string("15"),
+                               mGlobalOptions.mMetricsInterval) ||
+                    (mGlobalOptions.mMetricsInterval < 1)) {
+                    string s = "Invalid numeric in metricsinterval";
+                    throw cCECConfigException(getLineNumber(currentNode.offset_debug()), s);
+                }
+                Dsyslog("MetricsInterval = %d \n", mGlobalOptions.mMetricsInterval);
+            }
+            // <tracebuffer>
+            else if (strcasecmp(currentNode.name(), XML_TRACEBUFFER) == 0) {
+                if (!textToInt(currentNode.text().as_string("0"),
+                               mGlobalOptions.mTraceBuffer) ||
+                    (mGlobalOptions.mTraceBuffer < 0)) {
+                    string s = "Invalid numeric in tracebuffer";
+                    throw cCECConfigException(getLineNumber(currentNode.offset_debug()), s);
+                }
+                Dsyslog("TraceBuffer = %d \n", mGlobalOptions.mTraceBuffer);
+            }
+            // <schedpolicy>
+            else if (strcasecmp(currentNode.name(), XML_SCHEDPOLICY) == 0) {
+                if (!cThreadScheduling::ParsePolicy(currentNode.text().as_string(""),
+                        mGlobalOptions.mThreadScheduling.mPolicy)) {
+                    string s = "Only other, fifo or rr allowed for schedpolicy";
+                    throw cCECConfigException(getLineNumber(currentNode.offset_debug()), s);
+                }
+                policyOffset = currentNode.offset_debug();
+                Dsyslog("SchedPolicy = %d \n", mGlobalOptions.mThreadScheduling.mPolicy);
+            }
+            // <schedpriority>
+            else if (strcasecmp(currentNode.name(), XML_SCHEDPRIORITY) == 0) {
+                int &prio = mGlobalOptions.mThreadScheduling.mPriority;
+                if (!textToInt(currentNode.text().as_string(""), prio) ||
+                    (prio < 1) || (prio > 99)) {
+                    string s = "Invalid numeric in schedpriority (1-99)";
+                    throw cCECConfigException(getLineNumber(currentNode.offset_debug()), s);
+                }
+                Dsyslog("SchedPriority = %d \n", prio);
+            }
+            // <nice>
+            else if (strcasecmp(currentNode.name(), XML_NICE) == 0) {
+                int &nice = mGlobalOptions.mThreadScheduling.mNice;
+                if (!textToInt(currentNode.text().as_string(""), nice) ||
+                    (nice < -20) || (nice > 19)) {
+                    string s = "Invalid numeric in nice (-20-19)";
+                    throw cCECConfigException(getLineNumber(currentNode.offset_debug()), s);
+                }
+                mGlobalOptions.mThreadScheduling.mNiceSet = true;
+                Dsyslog("Nice = %d \n", nice);
+            }
+            // <cpuaffinity>
+            else if (strcasecmp(currentNode.name(), XML_CPUAFFINITY) == 0) {
+                if (!cThreadScheduling::ParseCpus(currentNode.text().as_string(""),
+                        mGlobalOptions.mThreadScheduling.mCpus)) {
+                    string s = "Invalid CPU list in cpuaffinity";
+                    throw cCECConfigException(getLineNumber(currentNode.offset_debug()), s);
+                }
+                Dsyslog("CpuAffinity = %s \n", currentNode.text().as_string(""));
+            }
+            // <eventsocket>
+            else if (strcasecmp(currentNode.name(), XML_EVENTSOCKET) == 0) {
+                mGlobalOptions.mEventSocket = currentNode.text().as_string("");
+                Dsyslog("EventSocket = %s \n", mGlobalOptions.mEventSocket.c_str());
+            }
             // <onSwitchToRadio>
             else if (strcasecmp(currentNode.name(), XML_ONSWITCHTORADIO) == 0) {
                 parseList(currentNode, mGlobalOptions.mOnSwitchToRadio);
@@ -572,6 +980,27 @@ void cConfigFileParser::parseGlobal(const pugi::xml_node node)
                         mGlobalOptions.mVDRKeymap.c_str(),
                         mGlobalOptions.mCECKeymap.c_str(),
                         mGlobalOptions.mGLOBALKeymap.c_str());
+            } else if (strcasecmp(currentNode.name(), XML_INITIATORKEYMAP) == 0) {
+                ptrdiff_t line = getLineNumber(currentNode.offset_debug());
+                cCECDevice device;
+                getDevice(currentNode.attribute(XML_INITIATOR).as_string(""),
+                          device, line);
+                cec_logical_address addr = device.mLogicalAddressDefined;
+                if ((addr < CECDEVICE_TV) || (addr > CECDEVICE_BROADCAST)) {
+                    string s = "Initiator in initiatorkeymap needs a logical address";
+                    throw cCECConfigException(line, s);
+                }
+                string id = currentNode.attribute(XML_CEC).as_string("");
+                if (id.empty()) {
+                    string s = "Missing cec in initiatorkeymap";
+                    throw cCECConfigException(line, s);
+                }
+                if (!keymaps.HasCECKeymap(id)) {
+                    string s = "Unknown ceckeymap " + id + " in initiatorkeymap";
+                    throw cCECConfigException(line, s);
+                }
+                mGlobalOptions.mInitiatorKeymaps[addr] = id;
+                Dsyslog("Keymap CEC %s for initiator %d", id.c_str(), addr);
             } else if (strcasecmp(currentNode.name(), XML_HDMIPORT) == 0) {
                 if (!textToInt(currentNode.text().as_string("1000"),
                         mGlobalOptions.mHDMIPort)) {
@@ -621,6 +1050,13 @@ void cConfigFileParser::parseGlobal(const pugi::xml_node node)
                     throw cCECConfigException(
                             getLineNumber(currentNode.offset_debug()), s);
                 }
+            } else if (strcasecmp(currentNode.name(), XML_EARLYCONNECT) == 0) {
+                if (!textToBool(currentNode.text().as_string(""),
+                        mGlobalOptions.mEarlyConnect)) {
+                    string s = "Only true or false allowed";
+                    throw cCECConfigException(
+                            getLineNumber(currentNode.offset_debug()), s);
+                }
             } else if (strcasecmp(currentNode.name(), XML_STARTUPDELAY) == 0) {
                 if (!textToInt(currentNode.text().as_string("0"),
                                         mGlobalOptions.mStartupDelay)) {
@@ -645,6 +1081,13 @@ void cConfigFileParser::parseGlobal(const pugi::xml_node node)
             }
         }
     }
+    // Real-time policies need a priority, the kernel rejects 0
+    const cThreadScheduling &sched = mGlobalOptions.mThreadScheduling;
+    if (((sched.mPolicy == SCHED_FIFO) || (sched.mPolicy == SCHED_RR)) &&
+        (sched.mPriority == 0)) {
+        string s = "schedpriority required for schedpolicy fifo or rr";
+        throw cCECConfigException(getLineNumber(policyOffset), s);
+    }
 }
 
 /**
@@ -843,6 +1286,7 @@ void cConfigFileParser::parseCECKeymap(const xml_node node, cKeyMaps &keymaps)
             keymaps.ClearCECKey(id, c);
 
             // Parse vdr key values
+            int count = 0;
             for (xml_node vdrkeynode = currentNode.first_child(); vdrkeynode;
                     vdrkeynode = vdrkeynode.next_sibling()) {
                 if (vdrkeynode.type() == node_element)  // is element
@@ -860,6 +1304,13 @@ void cConfigFileParser::parseCECKeymap(const xml_node node, cKeyMaps &keymaps)
                         Esyslog(s.c_str());
                         throw cCECConfigException(getLineNumber(vdrkeynode.offset_debug()), s);
                     }
+                    if (++count > cKeyMaps::MAXKEYS) {
+                        string s = "More than " +
+                                std::to_string(cKeyMaps::MAXKEYS) +
+                                " VDR keys for CEC key " + code;
+                        Esyslog(s.c_str());
+                        throw cCECConfigException(getLineNumber(vdrkeynode.offset_debug()), s);
+                    }
                     keymaps.AddCECKey(id, c, k);
                 }
             }
@@ -926,6 +1377,11 @@ void cConfigFileParser::parseDevice(const xml_node node)
                 }
                 Dsyslog ("   Logical Address = %d", device.mLogicalAddressDefined);
             }
+            else if (strcasecmp(currentNode.name(), XML_ADAPTER) == 0) {
+                device.mAdapter = getAdapter(currentNode.text().as_string(""),
+                                         getLineNumber(currentNode.offset_debug()));
+                Dsyslog ("   Adapter = %d", device.mAdapter);
+            }
             else {
                 string s = "Invalid node ";
                 s += currentNode.name();
@@ -945,30 +1401,132 @@ void cConfigFileParser::parseDevice(const xml_node node)
 }
 
 /**
- * @brief Converts a byte offset to a line number.
+ * @brief Parses an <adapter> XML section.
  *
- * Reads through the XML file counting newlines to determine
- * the line number for error reporting.
+ * Defines an additional CEC adapter with its own connection and worker
+ * thread. Devices and commands can be routed to it by its id.
  *
- * @param offset Byte offset from the start of the file
- * @return Line number (1-based), or -1 on error
+ * @param node The XML node containing the adapter definition
+ * @throws cCECConfigException on parsing errors
  */
-int cConfigFileParser::getLineNumber(long offset)
+void cConfigFileParser::parseAdapter(const xml_node node)
 {
-    int line = 1;
-    FILE *fp = fopen (mXmlFile, "r");
-    if (fp == NULL) {
-        Esyslog("Can not open file %s for getting line number", mXmlFile);
-        return -1;
-    }
-    while (!feof(fp) && (offset > 0)) {
-        if (fgetc(fp) == '\n') {
-            line++;
+    cCECAdapterOptions adapter;
+    adapter.mId = node.attribute(XML_ID).as_string("");
+    if (adapter.mId.empty()) {
+        string s = "Missing id for adapter";
+        Esyslog(s.c_str());
+        throw cCECConfigException(getLineNumber(node.offset_debug()), s);
+    }
+    for (const cCECAdapterOptions &a : mGlobalOptions.mAdapters) {
+        if (strcasecmp(a.mId.c_str(), adapter.mId.c_str()) == 0) {
+            string s = "Adapter " + adapter.mId + " already defined";
+            Esyslog(s.c_str());
+            throw cCECConfigException(getLineNumber(node.offset_debug()), s);
         }
-        offset--;
     }
-    fclose(fp);
-    return line;
+
+    Dsyslog ("ADAPTER %s\n", adapter.mId.c_str());
+    for (xml_node currentNode = node.first_child(); currentNode;
+         currentNode = currentNode.next_sibling()) {
+
+        if (currentNode.type() == node_element)  // is element
+        {
+            checkSubElement(currentNode);
+            if (strcasecmp(currentNode.name(), XML_PORT) == 0) {
+                adapter.mPort = currentNode.text().as_string("");
+                Dsyslog ("   Port = %s", adapter.mPort.c_str());
+            }
+            else if (strcasecmp(currentNode.name(), XML_HDMIPORT) == 0) {
+                if (!textToInt(currentNode.text().as_string("x"),
+                               adapter.mHDMIPort)) {
+                    string s = "Invalid numeric in hdmiport";
+                    throw cCECConfigException(
+                            getLineNumber(currentNode.offset_debug()), s);
+                }
+                if ((adapter.mHDMIPort < CEC_HDMI_PORTNUMBER_NONE)
+                        || (adapter.mHDMIPort > CEC_MAX_HDMI_PORTNUMBER)) {
+                    string s = "Allowed value for hdmiport 0-15";
+                    throw cCECConfigException(
+                            getLineNumber(currentNode.offset_debug()), s);
+                }
+            }
+            else if (strcasecmp(currentNode.name(), XML_BASEDEVICE) == 0) {
+                if (!textToInt(currentNode.text().as_string("x"),
+                               adapter.mBaseDevice)) {
+                    string s = "Invalid numeric in basedevice";
+                    throw cCECConfigException(
+                            getLineNumber(currentNode.offset_debug()), s);
+                }
+                if ((adapter.mBaseDevice < CECDEVICE_TV)
+                        || (adapter.mBaseDevice > CECDEVICE_BROADCAST)) {
+                    string s = "Allowed value for basedevice 0-15";
+                    throw cCECConfigException(
+                            getLineNumber(currentNode.offset_debug()), s);
+                }
+            }
+            else if (strcasecmp(currentNode.name(), XML_PHYSICAL) == 0) {
+                if (!textToInt(currentNode.text().as_string("x"),
+                               adapter.mPhysicalAddress, 16)) {
+                    string s = "Invalid physical address ";
+                    s += currentNode.text().as_string();
+                    Esyslog(s.c_str());
+                    throw cCECConfigException(
+                            getLineNumber(currentNode.offset_debug()), s);
+                }
+            }
+            else {
+                string s = "Invalid node ";
+                s += currentNode.name();
+                Esyslog(s.c_str());
+                throw cCECConfigException(
+                        getLineNumber(currentNode.offset_debug()), s);
+            }
+        }
+    }
+    mGlobalOptions.mAdapters.push_back(adapter);
+}
+
+/**
+ * @brief Resolves an adapter id to its index.
+ *
+ * An empty id selects the default adapter.
+ *
+ * @param text The adapter id
+ * @param linenumber Line number for error reporting
+ * @return Index of the adapter in cCECGlobalOptions::mAdapters
+ * @throws cCECConfigException if the adapter is not defined
+ */
+int cConfigFileParser::getAdapter(const char *text, ptrdiff_t linenumber)
+{
+    if (text[0] == '\0') {
+        return 0;
+    }
+    for (size_t i = 0; i < mGlobalOptions.mAdapters.size(); i++) {
+        if (strcasecmp(mGlobalOptions.mAdapters[i].mId.c_str(), text) == 0) {
+            return i;
+        }
+    }
+    string s = "Adapter ";
+    s += text;
+    s += " not found";
+    throw cCECConfigException(linenumber, s);
+}
+
+/**
+ * @brief Converts a byte offset to a line number.
+ *
+ * Looks up the offset in the line starts collected by Parse(), used
+ * for error reporting.
+ *
+ * @param offset Byte offset from the start of the file
+ * @return Line number (1-based)
+ */
+int cConfigFileParser::getLineNumber(long offset) const
+{
+    // mLineStarts[0] is 0, so the result is at least 1
+    return std::upper_bound(mLineStarts.begin(), mLineStarts.end(), offset) -
+           mLineStarts.begin();
 }
 
 /**
@@ -980,9 +1538,7 @@ int cConfigFileParser::getLineNumber(long offset)
  */
 bool cConfigFileParser::FindMenu(const string &menuname, cCECMenu &menu) {
     bool found = false;
-    for (cCECMenuListIterator i = mMenuList.begin(); i != mMenuList.end();
-            i++) {
-        cCECMenu m = *i;
+    for (const cCECMenu &m : mMenuList) {
         if (m.mMenuTitle == menuname) {
             menu = m;
             found = true;
@@ -991,26 +1547,91 @@ bool cConfigFileParser::FindMenu(const string &menuname, cCECMenu &menu) {
     return found;
 }
 
+/**
+ * @brief Finds a device by id or logical address.
+ *
+ * Accepts the same device specification as the configuration file,
+ * but reports errors by the return value.
+ *
+ * @param name Device id or logical address
+ * @param device Reference to store the found device
+ * @return true if device was found, false otherwise
+ */
+bool cConfigFileParser::FindDevice(const string &name, cCECDevice &device) {
+    try {
+        getDevice(name.c_str(), device, -1);
+    }
+    catch (const cCECConfigException &e) {
+        return false;
+    }
+    return true;
+}
+
 /**
  * @brief Parses the complete XML configuration file.
  *
- * Main entry point for configuration parsing. Reads and validates
- * the XML structure, then parses all sections: keymaps, devices,
- * global options, menus, and CEC command handlers.
+ * Main entry point for configuration parsing. Reads the file into
+ * memory and parses it.
  *
  * @param filename Path to the configuration file
  * @param keymaps Reference to the keymaps object to populate
  * @return true on success, false if parsing failed
  */
 bool cConfigFileParser::Parse(const string &filename, cKeyMaps &keymaps) {
+    FILE *fp = fopen(filename.c_str(), "r");
+    if (fp == nullptr) {
+        Esyslog("Can not open file %s: %s", filename.c_str(), strerror(errno));
+        return false;
+    }
+    string buffer;
+    char buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        buffer.append(buf, len);
+    }
+    bool readerror = (ferror(fp) != 0);
+    fclose(fp);
+    if (readerror) {
+        Esyslog("Can not read file %s", filename.c_str());
+        return false;
+    }
+    return Parse(buffer.data(), buffer.size(), keymaps, filename);
+}
+
+/**
+ * @brief Parses a configuration from memory.
+ *
+ * Reads and validates the XML structure, then parses all sections:
+ * keymaps, devices, global options, menus, and CEC command handlers.
+ * The offsets of the line starts are collected once, so the line numbers
+ * of the nodes are looked up without rescanning the text.
+ *
+ * @param buffer XML text, need not be null terminated
+ * @param size Size of the XML text
+ * @param keymaps Reference to keymaps object to populate
+ * @param name Name used in error messages
+ * @return true on success, false on parse errors
+ */
+bool cConfigFileParser::Parse(const char *buffer, size_t size,
+                              cKeyMaps &keymaps, const string &name) {
     bool ret = true;
     xml_document xmlDoc;
     xml_node currentNode;
-    mXmlFile = filename.c_str();
-    xml_parse_result res = xmlDoc.load_file(mXmlFile);
+    // Start from scratch, the parser may be used for several configurations
+    mGlobalOptions = cCECGlobalOptions();
+    mMenuList.clear();
+    mDeviceMap.clear();
+    mXmlFile = name;
+    mLineStarts.assign(1, 0);
+    for (size_t i = 0; i < size; i++) {
+        if (buffer[i] == '\n') {
+            mLineStarts.push_back(i + 1);
+        }
+    }
+    xml_parse_result res = xmlDoc.load_buffer(buffer, size);
     if (res.status != status_ok) {
         Esyslog("Error parsing file %s: %s\nAt line: %d",
-                mXmlFile, res.description(), getLineNumber(res.offset));
+                mXmlFile.c_str(), res.description(), getLineNumber(res.offset));
         return false;
     }
 
@@ -1056,6 +1677,11 @@ bool cConfigFileParser::Parse(const string &filename, cKeyMaps &keymaps) {
     string id = "TV";
     mDeviceMap.insert(std::pair<string, cCECDevice>(id, device));
 
+    // Create the default adapter, configured by the <global> section
+    cCECAdapterOptions adapter;
+    adapter.mId = "default";
+    mGlobalOptions.mAdapters.push_back(adapter);
+
     try {
         currentNode = currentNode.next_sibling(XML_GLOBAL);
         if (currentNode) {
@@ -1078,6 +1704,11 @@ bool cConfigFileParser::Parse(const string &filename, cKeyMaps &keymaps) {
                 currentNode = currentNode.next_sibling(XML_GLOBALKEYMAP)) {
             parseGLOBALKeymap(currentNode, keymaps);
         }
+        // Parse adapters
+        for (currentNode = elementRoot.child(XML_ADAPTER); currentNode;
+                currentNode = currentNode.next_sibling(XML_ADAPTER)) {
+            parseAdapter(currentNode);
+        }
         // Parse device
         for (currentNode = elementRoot.child(XML_DEVICE); currentNode;
                 currentNode = currentNode.next_sibling(XML_DEVICE)) {
@@ -1086,7 +1717,10 @@ bool cConfigFileParser::Parse(const string &filename, cKeyMaps &keymaps) {
 
         // parse global node
         currentNode = elementRoot.child(XML_GLOBAL);
-        parseGlobal(currentNode);
+        parseGlobal(currentNode, keymaps);
+        mGlobalOptions.mAdapters[0].mHDMIPort = mGlobalOptions.mHDMIPort;
+        mGlobalOptions.mAdapters[0].mPhysicalAddress = mGlobalOptions.mPhysicalAddress;
+        mGlobalOptions.mAdapters[0].mBaseDevice = mGlobalOptions.mBaseDevice;
 
         // Parse all menus
         for (currentNode = elementRoot.child(XML_MENU); currentNode;
@@ -1100,6 +1734,12 @@ bool cConfigFileParser::Parse(const string &filename, cKeyMaps &keymaps) {
             parseOnCecCommand(currentNode);
         }
 
+        // Parse all onactivesource definitions
+        for (currentNode = elementRoot.child(XML_ONACTIVESOURCE); currentNode;
+                currentNode = currentNode.next_sibling(XML_ONACTIVESOURCE)) {
+            parseOnActiveSource(currentNode);
+        }
+
     } catch (const cCECConfigException &e) {
         Esyslog ("cCECConfigException %s\n", e.what());
         ret = false;
@@ -1109,13 +1749,12 @@ bool cConfigFileParser::Parse(const string &filename, cKeyMaps &keymaps) {
     }
 
     // Check that referenced menu entries in onceccommand/execmenu,startmenu
-    // are defined.
+    // and onactivesource are defined.
     if (ret) {
         cCECMenu m;
-        for (mapCommandHandlerIterator i =
-                mGlobalOptions.mCECCommandHandlers.begin();
-                i != mGlobalOptions.mCECCommandHandlers.end(); i++) {
-            cCECCommandHandler h = i->second;
+        cCECCommandHandlerList handlers = mGlobalOptions.mActiveSourceHandlers;
+        mGlobalOptions.mCECCommandHandlers.GetAll(handlers);
+        for (const cCECCommandHandler &h : handlers) {
             if (!h.mExecMenu.empty()) {
                 if (!FindMenu(h.mExecMenu, m)) {
                     Esyslog("Menu %s in execmenu not found",
@@ -22,12 +22,46 @@
 #include <map>
 #include <queue>
 #include <set>
+#include <vector>
 
 #include "cecremote.h"
 #include "stringtools.h"
+#include "threadsched.h"
 
 namespace cecplugin {
 
+/**
+ * @class cCECParamMatch
+ * @brief Pattern for the parameters of a received CEC command.
+ *
+ * Compiled from the params attribute of <onceccommand>. Every parameter
+ * byte is compared under a mask, a frame matches if it has at least as
+ * many parameters as the pattern. An empty pattern matches every frame.
+ */
+class cCECParamMatch {
+public:
+    uint8_t mValue[CEC_MAX_DATA_PACKET_SIZE] = {}; ///< Expected bits
+    uint8_t mMask[CEC_MAX_DATA_PACKET_SIZE] = {};  ///< Compared bits
+    uint8_t mLength = 0;                           ///< Compared parameters
+
+    /**
+     * @brief Checks the parameters of a received frame.
+     * @param params Parameters of the frame.
+     * @return true if the parameters match the pattern.
+     */
+    bool Matches(const std::vector<uint8_t> &params) const {
+        if (params.size() < mLength) {
+            return false;
+        }
+        for (int i = 0; i < mLength; i++) {
+            if ((params[i] & mMask[i]) != mValue[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
 /**
  * @class cCECCommandHandler
  * @brief Handler for responding to specific CEC opcodes.
@@ -42,16 +76,77 @@ public:
     std::string mStopMenu;    ///< Menu's player to stop (optional)
     cec_opcode mCecOpCode;    ///< CEC opcode to handle
     cCECDevice mDevice;       ///< Initiator device filter
+    cCECParamMatch mParams;   ///< Parameter filter
 public:
     /** @brief Default constructor. */
     cCECCommandHandler() : mCecOpCode(CEC_OPCODE_NONE) {};
 };
 
-typedef std::multimap<cec_opcode, cCECCommandHandler> mapCommandHandler;
-typedef mapCommandHandler::iterator mapCommandHandlerIterator;
+typedef std::list<cCECCommandHandler> cCECCommandHandlerList;
+typedef std::vector<cCECCommandHandler> cCECCommandHandlerVector;
+
+/**
+ * @class cCECCommandHandlerTable
+ * @brief <onceccommand> handlers indexed by opcode.
+ *
+ * The handlers of an opcode are found by one array access per received
+ * frame, they are kept in the order of the configuration file.
+ */
+class cCECCommandHandlerTable {
+private:
+    cCECCommandHandlerVector mHandlers[256];  ///< Handlers by opcode
+public:
+    /**
+     * @brief Adds a handler for its opcode.
+     * @param h The handler.
+     */
+    void Add(const cCECCommandHandler &h) {
+        mHandlers[h.mCecOpCode & 0xFF].push_back(h);
+    }
+
+    /**
+     * @brief Gets the handlers of an opcode.
+     * @param opcode The received opcode.
+     * @return Handlers in configuration order.
+     */
+    const cCECCommandHandlerVector &Find(cec_opcode opcode) const {
+        return mHandlers[opcode & 0xFF];
+    }
+
+    /**
+     * @brief Gets all handlers.
+     * @param list Receives the handlers.
+     */
+    void GetAll(cCECCommandHandlerList &list) const {
+        for (const cCECCommandHandlerVector &v : mHandlers) {
+            list.insert(list.end(), v.begin(), v.end());
+        }
+    }
+};
 
 typedef std::set<eKeys> keySet;
 
+/**
+ * @class cCECAdapterOptions
+ * @brief Settings for one CEC adapter from an <adapter> XML element.
+ *
+ * Index 0 is always the default adapter, which takes its settings from
+ * the <global> section. Each adapter gets its own connection and worker.
+ */
+class cCECAdapterOptions {
+public:
+    std::string mId;           ///< Name used to route devices and commands
+    std::string mPort;         ///< libCEC com port name or path (empty = by index)
+    int mHDMIPort = CEC_DEFAULT_HDMI_PORT; ///< HDMI port number
+    int32_t mPhysicalAddress = -1;         ///< Physical CEC address (-1 = auto)
+    cec_logical_address mBaseDevice = CECDEVICE_UNKNOWN;  ///< Base device address
+
+    /** @brief Default constructor. */
+    cCECAdapterOptions() = default;
+};
+
+typedef std::vector<cCECAdapterOptions> cCECAdapterList;
+
 /**
  * @class cCECGlobalOptions
  * @brief Stores global configuration options from <global> XML element.
@@ -80,10 +175,25 @@ public:
     std::string mCECKeymap = cKeyMaps::DEFAULTKEYMAP;    ///< Active CEC keymap ID
     std::string mVDRKeymap = cKeyMaps::DEFAULTKEYMAP;    ///< Active VDR keymap ID
     std::string mGLOBALKeymap = cKeyMaps::DEFAULTKEYMAP; ///< Active global keymap ID
+    std::map<cec_logical_address, std::string> mInitiatorKeymaps; ///< CEC keymap ID per initiator
     bool mShutdownOnStandby = false;      ///< Send standby on VDR shutdown
     bool mPowerOffOnStandby = false;      ///< Send power off on VDR shutdown
     bool mRTCDetect = true;               ///< Use RTC to detect manual start
-    mapCommandHandler mCECCommandHandlers; ///< Handlers for CEC opcodes
+    bool mEarlyConnect = false;           ///< Open the adapters in Initialize()
+    cCECCommandHandlerTable mCECCommandHandlers; ///< Handlers for CEC opcodes
+    cCECCommandHandlerList mActiveSourceHandlers; ///< Handlers for source changes
+    cCECAdapterList mAdapters;            ///< Adapters, index 0 is the default
+    std::string mControlSocket;           ///< Path of the control socket (empty = off)
+    std::string mStatusPage;              ///< Path of the shared memory status page (empty = off)
+    std::string mEventSocket;             ///< Path of the event socket (empty = off)
+    int mExecTimeoutMs = 0;               ///< Default timeout of <exec> scripts (0 = none)
+    int mExecParallel = 2;                ///< Maximum parallel asynchronous scripts
+    int mWatchdogTimeoutMs = 10000;       ///< Maximum duration of a libCEC call (0 = off)
+    int mStopTimeoutMs = 10000;           ///< Deadline of the <onstop> commands
+    std::string mMetricsFile;             ///< Path of the Prometheus metrics file (empty = off)
+    int mMetricsInterval = 15;            ///< Export interval of the metrics in s
+    int mTraceBuffer = 0;                 ///< Events kept by the tracer (0 = off)
+    cThreadScheduling mThreadScheduling;  ///< Scheduling of the CEC threads
 
     /** @brief Default constructor. */
     cCECGlobalOptions() = default;
@@ -155,6 +265,7 @@ class cCECConfigException : public std::exception {
 private:
     int mLineNr = -1;       ///< Line number where error occurred
     std::string mTxt;       ///< Error description
+    std::string mWhat;      ///< Formatted message returned by what()
 public:
     /**
      * @brief Constructs exception with line number and message.
@@ -164,6 +275,8 @@ public:
     explicit cCECConfigException(int linenr, const std::string &txt) {
         mLineNr = linenr;
         mTxt = txt;
+        mWhat = "Syntax error in line " + std::to_string(mLineNr) + "\n" +
+                mTxt;
     }
 
     /** @brief Destructor. */
@@ -174,11 +287,7 @@ public:
      * @return Error text including line number.
      */
     const char *what() const throw() {
-        char buf[10];
-        sprintf(buf,"%d\n", mLineNr);
-        static std::string s = "Syntax error in line ";
-        s += buf + mTxt;
-        return s.c_str();
+        return mWhat.c_str();
     }
 };
 
@@ -203,7 +312,7 @@ private:
      * @param offset Byte offset from XML parser.
      * @return Corresponding line number.
      */
-    int getLineNumber(long offset);
+    int getLineNumber(long offset) const;
 
     /**
      * @brief Converts device type string to enum value.
@@ -289,7 +398,7 @@ private:
     void parseGLOBALKeymap(const pugi::xml_node node, cKeyMaps &keymaps);
 
     /** @brief Parses <global> element and its children. */
-    void parseGlobal(const pugi::xml_node node);
+    void parseGlobal(const pugi::xml_node node, const cKeyMaps &keymaps);
 
     /** @brief Parses <menu> element and its children. */
     void parseMenu(const pugi::xml_node node);
@@ -314,6 +423,67 @@ private:
     /** @brief Parses <onceccommand> element. */
     void parseOnCecCommand(const pugi::xml_node node);
 
+    /** @brief Parses <onactivesource> element. */
+    void parseOnActiveSource(const pugi::xml_node node);
+
+    /**
+     * @brief Parses the actions of a handler.
+     * @param node <onceccommand> or <onactivesource> element.
+     * @param h Handler receiving the actions.
+     * @throws cCECConfigException on parsing errors.
+     */
+    void parseHandlerActions(const pugi::xml_node node, cCECCommandHandler &h);
+
+    /** @brief Parses <adapter> element. */
+    void parseAdapter(const pugi::xml_node node);
+
+    /**
+     * @brief Resolves an adapter name to its index.
+     * @param text Adapter id as defined in <adapter>.
+     * @param linenr Line number for error reporting.
+     * @return Index into cCECGlobalOptions::mAdapters.
+     */
+    int getAdapter(const char *text, ptrdiff_t linenr);
+
+    /**
+     * @brief Converts a power state name (on, standby) to the CEC status.
+     * @param text Power state name.
+     * @param linenr Line number for error reporting.
+     * @return The CEC power status.
+     * @throws cCECConfigException if the name is invalid.
+     */
+    cec_power_status getPowerStatus(const char *text, ptrdiff_t linenr);
+
+    /**
+     * @brief Converts a list of hex bytes (e.g. "10 00") to CEC parameters.
+     * @param text Bytes separated by space, colon or comma.
+     * @param params Receives the parameters.
+     * @param linenr Line number for error reporting.
+     * @throws cCECConfigException on invalid bytes.
+     */
+    void getParams(const char *text, std::vector<uint8_t> &params,
+                   ptrdiff_t linenr);
+
+    /**
+     * @brief Compiles a parameter pattern (e.g. "1x xx" or "00/80").
+     * @param text Bytes separated by space, colon or comma. A hex digit
+     *             x matches every nibble, /mask compares only these bits.
+     * @param match Receives the compiled pattern.
+     * @param linenr Line number for error reporting.
+     * @throws cCECConfigException on invalid patterns.
+     */
+    void getParamMatch(const char *text, cCECParamMatch &match,
+                       ptrdiff_t linenr);
+
+    /**
+     * @brief Parses the built-in commands with attributes of a command list.
+     * @param node The command node.
+     * @param cmd Command to fill.
+     * @return false if the node is no built-in command.
+     * @throws cCECConfigException on parsing errors.
+     */
+    bool parseBuiltin(const pugi::xml_node node, cCmd &cmd);
+
     // Keywords used in the XML config file
     static constexpr char const *XML_GLOBAL = "global";
     static constexpr char const *XML_MENU = "menu";
@@ -330,6 +500,7 @@ private:
     static constexpr char const *XML_VALUE = "value";
     static constexpr char const *XML_STOP = "stop";
     static constexpr char const *XML_KEYMAPS = "keymaps";
+    static constexpr char const *XML_INITIATORKEYMAP = "initiatorkeymap";
     static constexpr char const *XML_FILE = "file";
     static constexpr char const *XML_CEC = "cec";
     static constexpr char const *XML_VDR = "vdr";
@@ -363,12 +534,42 @@ private:
     static constexpr char const *XML_INITIATOR = "initiator";
     static constexpr char const *XML_RTCDETECT = "rtcdetect";
     static constexpr char const *XML_STARTUPDELAY = "startupdelay";
+    static constexpr char const *XML_EARLYCONNECT = "earlyconnect";
     static constexpr char const *XML_ONKEY = "onkey";
     static constexpr char const *XML_ONVOLUMEUP = "onvolumeup";
     static constexpr char const *XML_ONVOLUMEDOWN = "onvolumedown";
     static constexpr char const *XML_AUDIODEVICE = "audiodevice";
-
-    const char* mXmlFile = nullptr;  ///< Path to the configuration file
+    static constexpr char const *XML_ADAPTER = "adapter";
+    static constexpr char const *XML_PORT = "port";
+    static constexpr char const *XML_CONTROLSOCKET = "controlsocket";
+    static constexpr char const *XML_STATUSPAGE = "statuspage";
+    static constexpr char const *XML_EVENTSOCKET = "eventsocket";
+    static constexpr char const *XML_EXECTIMEOUT = "exectimeout";
+    static constexpr char const *XML_EXECPARALLEL = "execparallel";
+    static constexpr char const *XML_WATCHDOGTIMEOUT = "watchdogtimeout";
+    static constexpr char const *XML_STOPTIMEOUT = "stoptimeout";
+    static constexpr char const *XML_METRICSFILE = "metricsfile";
+    static constexpr char const *XML_METRICSINTERVAL = "metricsinterval";
+    static constexpr char const *XML_TRACEBUFFER = "tracebuffer";
+    static constexpr char const *XML_SCHEDPOLICY = "schedpolicy";
+    static constexpr char const *XML_SCHEDPRIORITY = "schedpriority";
+    static constexpr char const *XML_NICE = "nice";
+    static constexpr char const *XML_CPUAFFINITY = "cpuaffinity";
+    static constexpr char const *XML_ASYNC = "async";
+    static constexpr char const *XML_WAITPOWER = "waitpower";
+    static constexpr char const *XML_DELAY = "delay";
+    static constexpr char const *XML_SEND = "send";
+    static constexpr char const *XML_IF = "if";
+    static constexpr char const *XML_ELSE = "else";
+    static constexpr char const *XML_KEYMAP = "keymap";
+    static constexpr char const *XML_ROUTE = "route";
+    static constexpr char const *XML_POWER = "power";
+    static constexpr char const *XML_TIMEOUT = "timeout";
+    static constexpr char const *XML_OPCODE = "opcode";
+    static constexpr char const *XML_PARAMS = "params";
+
+    std::string mXmlFile;            ///< Path to the configuration file
+    std::vector<long> mLineStarts;   ///< Offsets of the line starts in the file
 
 public:
     cCECGlobalOptions mGlobalOptions;  ///< Parsed global options
@@ -389,6 +590,22 @@ public:
      */
     bool Parse(const std::string &filename, cKeyMaps &keymaps);
 
+    /**
+     * @brief Parses a configuration from memory.
+     * @param buffer XML text, need not be null terminated.
+     * @param size Size of the XML text.
+     * @param keymaps Key maps to populate.
+     * @param name Name used in error messages.
+     * @return true if parsing succeeded, false on error.
+     * @note The results of a previous Parse() are discarded, the key maps
+     *       are only extended.
+     *
+     * Same as Parse(), used for configurations which are not read from
+     * a file (e.g. generated ones or fuzzing).
+     */
+    bool Parse(const char *buffer, size_t size, cKeyMaps &keymaps,
+               const std::string &name = "<buffer>");
+
     /**
      * @brief Finds a menu configuration by name.
      * @param menuname Name of the menu to find.
@@ -396,6 +613,14 @@ public:
      * @return true if menu was found.
      */
     bool FindMenu(const std::string &menuname, cCECMenu &menu);
+
+    /**
+     * @brief Finds a device by id or logical address.
+     * @param name Device id or logical address as number.
+     * @param device Output parameter for the found device.
+     * @return true if device was found.
+     */
+    bool FindDevice(const std::string &name, cCECDevice &device);
 };
 
 } // namespace cecplugin
@@ -0,0 +1,438 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the local control socket for scripts.
+ */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+#include "controlsocket.h"
+#include "cecremoteplugin.h"
+#include "ceclog.h"
+
+using namespace std;
+
+namespace cecplugin {
+
+/**
+ * @brief Constructs the control socket.
+ *
+ * @param plugin Pointer to the parent plugin instance
+ * @param path File system path of the Unix domain socket
+ */
+cControlSocket::cControlSocket(cPluginCecremote *plugin, const string &path) :
+        cThread("CEC control socket"),
+        mPlugin(plugin),
+        mPath(path),
+        mWaiter(this)
+{
+}
+
+/**
+ * @brief Destructor, stops the thread and removes the socket file.
+ */
+cControlSocket::~cControlSocket()
+{
+    Close();
+}
+
+/**
+ * @brief Creates the listening socket and starts the threads.
+ *
+ * An existing socket file at the configured path is removed first.
+ *
+ * @return false if the socket could not be created
+ */
+bool cControlSocket::Open()
+{
+    struct sockaddr_un addr;
+
+    if (mPath.size() >= sizeof(addr.sun_path)) {
+        Esyslog("Control socket path too long %s", mPath.c_str());
+        return false;
+    }
+    if (pipe2(mWakeFd, O_NONBLOCK | O_CLOEXEC) < 0) {
+        Esyslog("Can not create control pipe: %s", strerror(errno));
+        return false;
+    }
+    mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (mListenFd < 0) {
+        Esyslog("Can not create control socket: %s", strerror(errno));
+        Close();
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, mPath.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(mPath.c_str());
+    if ((bind(mListenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+        (listen(mListenFd, MAX_CLIENTS) < 0)) {
+        Esyslog("Can not bind control socket %s: %s",
+                mPath.c_str(), strerror(errno));
+        close(mListenFd);
+        mListenFd = -1;
+        Close();
+        return false;
+    }
+    chmod(mPath.c_str(), 0660);
+    Isyslog("Control socket %s", mPath.c_str());
+    mWaiter.Start();
+    Start();
+    return true;
+}
+
+/**
+ * @brief Stops the threads, closes all connections and removes the socket.
+ */
+void cControlSocket::Close()
+{
+    Cancel(3);
+    mWaiter.Stop();
+    for (cClient &client : mClients) {
+        close(client.mFd);
+    }
+    mClients.clear();
+    mWaitRequests.clear();
+    mWaitReplies.clear();
+    if (mListenFd >= 0) {
+        close(mListenFd);
+        mListenFd = -1;
+        unlink(mPath.c_str());
+    }
+    for (int i = 0; i < 2; i++) {
+        if (mWakeFd[i] >= 0) {
+            close(mWakeFd[i]);
+            mWakeFd[i] = -1;
+        }
+    }
+}
+
+/**
+ * @brief Main loop of the control socket thread.
+ *
+ * Waits for new connections, requests, replies of the helper thread and
+ * writable clients with pending output. The poll timeout only limits the
+ * time needed to notice the end of the thread.
+ */
+void cControlSocket::Action()
+{
+    Dsyslog("Control socket thread started");
+    while (Running()) {
+        vector<struct pollfd> fds(mClients.size() + 2);
+        fds[0].fd = mListenFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = mWakeFd[0];
+        fds[1].events = POLLIN;
+        for (size_t i = 0; i < mClients.size(); i++) {
+            const cClient &client = mClients[i];
+            // A closed client is only polled for its remaining output
+            fds[i + 2].fd = (client.mEof && client.mOutput.empty()) ?
+                            -1 : client.mFd;
+            // A waiting client is not read, so its requests stay in order.
+            // A client which does not read its replies is not read either.
+            fds[i + 2].events = (client.mWaiting || client.mEof ||
+                                 (client.mOutput.size() > MAX_OUTPUT)) ?
+                                0 : POLLIN;
+            if (!client.mOutput.empty()) {
+                fds[i + 2].events |= POLLOUT;
+            }
+        }
+        int rc = poll(fds.data(), fds.size(), 500);
+        if (rc < 0) {
+            if (errno != EINTR) {
+                Esyslog("Control socket poll failed: %s", strerror(errno));
+                break;
+            }
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            char buf[64];
+            while (read(mWakeFd[0], buf, sizeof(buf)) > 0) {
+            }
+            DeliverReplies();
+        }
+        // Serve the clients first, accept may change mClients. Replies
+        // delivered above may have added output to clients without events.
+        for (size_t i = fds.size() - 1; i >= 2; i--) {
+            cClient &client = mClients[i - 2];
+            bool ok = true;
+            if (!client.mEof &&
+                (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                ok = Receive(client);
+            }
+            if (ok) {
+                ok = Flush(client);
+            }
+            // Lines held back while the output was full
+            if (ok && !client.mInput.empty()) {
+                ok = ProcessInput(client);
+            }
+            if (ok && client.mEof && !client.mWaiting &&
+                client.mOutput.empty()) {
+                ok = false;
+            }
+            if (!ok) {
+                close(client.mFd);
+                mClients.erase(mClients.begin() + (i - 2));
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(mListenFd, nullptr, nullptr,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0) {
+                if (mClients.size() >= MAX_CLIENTS) {
+                    static const char *full = "ERR too many connections\n";
+                    (void)send(fd, full, strlen(full),
+                               MSG_NOSIGNAL | MSG_DONTWAIT);
+                    close(fd);
+                }
+                else {
+                    cClient client;
+                    client.mFd = fd;
+                    client.mId = mNextClientId++;
+                    mClients.push_back(std::move(client));
+                }
+            }
+        }
+    }
+    Dsyslog("Control socket thread stopped");
+}
+
+/**
+ * @brief Reads pending data of a client and executes complete lines.
+ *
+ * @param client The client to serve
+ * @return false if the connection is broken or the request is too long
+ */
+bool cControlSocket::Receive(cClient &client)
+{
+    char buf[MAX_LINE];
+    ssize_t len = recv(client.mFd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (len < 0) {
+        return ((errno == EAGAIN) || (errno == EINTR));
+    }
+    if (len == 0) {
+        // Answer the requests already received, e.g. "echo DISC | socat"
+        client.mEof = true;
+        return ProcessInput(client);
+    }
+    client.mInput.append(buf, len);
+    return ProcessInput(client);
+}
+
+/**
+ * @brief Executes the complete lines received from a client.
+ *
+ * Stops at a CONN or DISC request, the remaining lines are executed when
+ * its reply arrives. Also stops while the client has more than MAX_OUTPUT
+ * unsent bytes, the lines are executed when the output is sent.
+ *
+ * @param client The client to serve
+ * @return false if the request is too long
+ */
+bool cControlSocket::ProcessInput(cClient &client)
+{
+    size_t pos;
+    while (!client.mWaiting && (client.mOutput.size() <= MAX_OUTPUT) &&
+           ((pos = client.mInput.find('\n')) != string::npos)) {
+        string line = client.mInput.substr(0, pos);
+        client.mInput.erase(0, pos + 1);
+        if (!line.empty() && (line.back() == '\r')) {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        client.mOutput += Execute(client, line);
+    }
+    if (!client.mWaiting && (client.mOutput.size() <= MAX_OUTPUT) &&
+        (client.mInput.size() > MAX_LINE)) {
+        client.mOutput += "ERR line too long\n";
+        Flush(client);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Passes the replies of the helper thread to the waiting clients.
+ *
+ * Replies for clients which closed the connection meanwhile are dropped.
+ */
+void cControlSocket::DeliverReplies()
+{
+    vector<cWaitReply> replies;
+    {
+        cMutexLock lock(&mWaitMutex);
+        replies.swap(mWaitReplies);
+    }
+    for (const cWaitReply &reply : replies) {
+        for (cClient &client : mClients) {
+            if (client.mId == reply.mClientId) {
+                client.mOutput += reply.mReply;
+                // The held back lines are executed by the socket loop
+                client.mWaiting = false;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Sends as much buffered output as the socket accepts.
+ *
+ * A client which does not read is not waited for, the rest of the output
+ * is sent when poll() reports the socket writable again.
+ *
+ * @param client The client
+ * @return false if the connection is broken
+ */
+bool cControlSocket::Flush(cClient &client)
+{
+    if (client.mOutput.empty()) {
+        return true;
+    }
+    ssize_t len = send(client.mFd, client.mOutput.data(), client.mOutput.size(),
+                       MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (len < 0) {
+        if ((errno == EAGAIN) || (errno == EINTR)) {
+            return true;
+        }
+        Dsyslog("Control socket send failed: %s", strerror(errno));
+        return false;
+    }
+    client.mOutput.erase(0, len);
+    return true;
+}
+
+/**
+ * @brief Stops the helper thread.
+ *
+ * A running PushWaitCmd() returns after the worker timeout at the latest,
+ * the thread checks Running() before the next adapter.
+ */
+void cControlSocket::cWaiter::Stop()
+{
+    Cancel(-1);
+    {
+        cMutexLock lock(&mSocket->mWaitMutex);
+        mSocket->mWaitCond.Broadcast();
+    }
+    Cancel(WAIT_CANCEL_S);
+}
+
+/**
+ * @brief Main loop of the helper thread, executes CONN and DISC.
+ */
+void cControlSocket::cWaiter::Action()
+{
+    while (Running()) {
+        cWaitRequest request;
+        {
+            cMutexLock lock(&mSocket->mWaitMutex);
+            if (mSocket->mWaitRequests.empty()) {
+                mSocket->mWaitCond.TimedWait(mSocket->mWaitMutex, 500);
+                continue;
+            }
+            request = mSocket->mWaitRequests.front();
+            mSocket->mWaitRequests.erase(mSocket->mWaitRequests.begin());
+        }
+        for (cCECRemote *remote : request.mRemotes) {
+            if (!Running()) {
+                return;
+            }
+            cCmd cmd(request.mConnect ? CEC_CONNECT : CEC_DISCONNECT);
+            remote->PushWaitCmd(cmd);
+        }
+        {
+            cMutexLock lock(&mSocket->mWaitMutex);
+            mSocket->mWaitReplies.push_back({request.mClientId, "OK\n"});
+        }
+        // A full pipe already wakes up the socket thread
+        (void)write(mSocket->mWakeFd[1], "x", 1);
+    }
+}
+
+/**
+ * @brief Executes a single request.
+ *
+ * CONN and DISC are passed to the helper thread and answered when the
+ * worker processed them, all other commands are only queued, so the
+ * reply does not depend on the CEC bus.
+ *
+ * @param client The client sending the request
+ * @param line The request without line end
+ * @return Reply text including the final OK/ERR line, empty if the
+ *         request waits for the helper thread
+ */
+string cControlSocket::Execute(cClient &client, const string &line)
+{
+    istringstream in(line);
+    string command;
+    string arg1;
+    string arg2;
+    in >> command >> arg1 >> arg2;
+
+    Dsyslog("Control socket: %s", line.c_str());
+    if (strcasecmp(command.c_str(), "CONN") == 0 ||
+        strcasecmp(command.c_str(), "DISC") == 0) {
+        cWaitRequest request;
+        request.mClientId = client.mId;
+        request.mConnect = (strcasecmp(command.c_str(), "CONN") == 0);
+        if (!mPlugin->SelectRemotes(arg1.c_str(), request.mRemotes)) {
+            return "ERR adapter " + arg1 + " not found\n";
+        }
+        cMutexLock lock(&mWaitMutex);
+        mWaitRequests.push_back(request);
+        mWaitCond.Broadcast();
+        client.mWaiting = true;
+        return "";
+    }
+    else if (strcasecmp(command.c_str(), "KEY") == 0 ||
+             strcasecmp(command.c_str(), "POWER") == 0) {
+        cCECDevice dev;
+        if (!mPlugin->mConfigFileParser.FindDevice(arg1, dev)) {
+            return "ERR device " + arg1 + " not found\n";
+        }
+        if (strcasecmp(command.c_str(), "KEY") == 0) {
+            eKeys k = cKey::FromString(arg2.c_str());
+            if (k == kNone) {
+                return "ERR invalid key " + arg2 + "\n";
+            }
+            cCmd cmd(CEC_VDRKEYPRESS, (int)k, &dev);
+            mPlugin->PushCmd(cmd);
+        }
+        else if (strcasecmp(arg2.c_str(), "on") == 0) {
+            cCmd cmd(CEC_POWERON, 0, &dev);
+            mPlugin->PushCmd(cmd);
+        }
+        else if (strcasecmp(arg2.c_str(), "off") == 0) {
+            cCmd cmd(CEC_POWEROFF, 0, &dev);
+            mPlugin->PushCmd(cmd);
+        }
+        else {
+            return "ERR expected on or off\n";
+        }
+        return "OK\n";
+    }
+    else if (strcasecmp(command.c_str(), "STAT") == 0) {
+        string s = *mPlugin->getStatus();
+        return s + "\nOK\n";
+    }
+    return "ERR unknown command " + command + "\n";
+}
+
+} // namespace cecplugin
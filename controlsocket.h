@@ -0,0 +1,171 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the local control socket for scripts.
+ */
+
+#ifndef CONTROLSOCKET_H_
+#define CONTROLSOCKET_H_
+
+#include <vdr/thread.h>
+#include <string>
+#include <vector>
+
+namespace cecplugin {
+
+class cPluginCecremote;
+class cCECRemote;
+
+/**
+ * @class cControlSocket
+ * @brief Unix domain socket for controlling the plugin from scripts.
+ *
+ * Scripts started by <exec> can use this socket instead of svdrpsend to
+ * connect or disconnect the adapter, send keys, switch the power of a
+ * device and query the status. The socket is served by its own thread,
+ * so requests are neither serialized with SVDRP nor handled by the
+ * blocked worker thread.
+ *
+ * Protocol: One command per line. Every reply ends with a line starting
+ * with "OK" or "ERR <reason>", multi line replies send their payload
+ * before this line. The requests of a client are answered in order.
+ *
+ * - CONN [adapter]          Connect the adapter(s)
+ * - DISC [adapter]          Disconnect the adapter(s)
+ * - KEY <device> <vdrkey>   Send a VDR key using the active VDR key map
+ * - POWER <device> on|off   Power on or standby a device
+ * - STAT                    Plugin status
+ *
+ * CONN and DISC wait for the worker, so they are executed by a helper
+ * thread and answered when they are done. Replies are buffered per
+ * client and sent when the socket is writable.
+ */
+class cControlSocket : public cThread {
+private:
+    static constexpr const int MAX_CLIENTS = 8;      ///< Concurrent connections
+    static constexpr const size_t MAX_LINE = 256;    ///< Maximum request length
+    static constexpr const size_t MAX_OUTPUT = 65536; ///< Unsent bytes before requests are held back
+
+    /** @brief State of a connected client. */
+    class cClient {
+    public:
+        int mFd = -1;          ///< Socket of the client
+        unsigned mId = 0;      ///< Identifies the client for waiting replies
+        std::string mInput;    ///< Received, not yet processed data
+        std::string mOutput;   ///< Replies not yet sent
+        bool mWaiting = false; ///< CONN/DISC in progress, input is held back
+        bool mEof = false;     ///< Client closed its side, close after mOutput
+    };
+
+    /** @brief CONN or DISC request for the helper thread. */
+    class cWaitRequest {
+    public:
+        unsigned mClientId;                  ///< Client to answer
+        bool mConnect;                       ///< CONN or DISC
+        std::vector<cCECRemote *> mRemotes;  ///< Selected adapters
+    };
+
+    /** @brief Reply of the helper thread. */
+    class cWaitReply {
+    public:
+        unsigned mClientId;   ///< Client to answer
+        std::string mReply;   ///< Reply text
+    };
+
+    /**
+     * @class cWaiter
+     * @brief Helper thread executing CONN and DISC.
+     *
+     * PushWaitCmd() blocks up to the worker timeout, this must not stall
+     * the other clients of the socket thread.
+     */
+    class cWaiter : public cThread {
+    private:
+        static constexpr const int WAIT_CANCEL_S = 6; ///< PushWaitCmd() timeout and margin
+        cControlSocket *mSocket;   ///< Owning control socket
+        void Action();
+    public:
+        explicit cWaiter(cControlSocket *socket) :
+            cThread("CEC control wait"), mSocket(socket) {}
+        /** @brief Stops the thread, waits for a running PushWaitCmd(). */
+        void Stop();
+    };
+
+    cPluginCecremote *mPlugin;     ///< Parent plugin instance
+    std::string mPath;             ///< Path of the socket
+    int mListenFd = -1;            ///< Listening socket
+    int mWakeFd[2] = {-1, -1};     ///< Pipe to wake up the thread
+    std::vector<cClient> mClients; ///< Connected clients
+    unsigned mNextClientId = 1;    ///< Id of the next client
+    cWaiter mWaiter;               ///< Executes CONN and DISC
+    cMutex mWaitMutex;             ///< Protects mWaitRequests and mWaitReplies
+    cCondVar mWaitCond;            ///< Signals new requests to mWaiter
+    std::vector<cWaitRequest> mWaitRequests; ///< Requests for mWaiter
+    std::vector<cWaitReply> mWaitReplies;    ///< Replies of mWaiter
+
+    /** @brief Main thread loop - accepts clients and processes requests. */
+    void Action();
+
+    /**
+     * @brief Reads data of a client and processes complete lines.
+     * @param client The client to serve.
+     * @return false if the connection was closed.
+     */
+    bool Receive(cClient &client);
+
+    /**
+     * @brief Executes the complete lines received from a client.
+     * @param client The client to serve.
+     * @return false if the connection has to be closed.
+     */
+    bool ProcessInput(cClient &client);
+
+    /**
+     * @brief Passes the replies of the helper thread to the clients.
+     */
+    void DeliverReplies();
+
+    /**
+     * @brief Executes a single request line.
+     * @param client The client sending the request.
+     * @param line The request without line end.
+     * @return Reply to send to the client, empty if the request waits.
+     */
+    std::string Execute(cClient &client, const std::string &line);
+
+    /**
+     * @brief Sends as much buffered output as the socket accepts.
+     * @param client The client.
+     * @return false if the connection is broken.
+     */
+    bool Flush(cClient &client);
+
+public:
+    /**
+     * @brief Constructs the control socket.
+     * @param plugin Pointer to the parent plugin instance.
+     * @param path File system path of the socket.
+     */
+    cControlSocket(cPluginCecremote *plugin, const std::string &path);
+
+    /** @brief Destructor - stops the thread and removes the socket. */
+    ~cControlSocket();
+
+    /**
+     * @brief Creates the socket and starts the thread.
+     * @return false if the socket could not be created.
+     */
+    bool Open();
+
+    /** @brief Stops the thread and closes all connections. */
+    void Close();
+};
+
+} // namespace cecplugin
+
+#endif /* CONTROLSOCKET_H_ */
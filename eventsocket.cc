@@ -0,0 +1,330 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the event subscription socket.
+ */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "eventsocket.h"
+#include "ceclog.h"
+#include "metrics.h"
+
+using namespace std;
+
+namespace cecplugin {
+
+/**
+ * @brief Constructs the event socket.
+ *
+ * @param path File system path of the Unix domain socket
+ */
+cEventSocket::cEventSocket(const string &path) :
+        cThread("CEC event socket"),
+        mPath(path)
+{
+}
+
+/**
+ * @brief Destructor, stops the thread and removes the socket file.
+ */
+cEventSocket::~cEventSocket()
+{
+    Close();
+}
+
+/**
+ * @brief Creates the listening socket and the wake up pipe and starts
+ *        the thread.
+ *
+ * @return false if the socket could not be created
+ */
+bool cEventSocket::Open()
+{
+    struct sockaddr_un addr;
+
+    if (mPath.size() >= sizeof(addr.sun_path)) {
+        Esyslog("Event socket path too long %s", mPath.c_str());
+        return false;
+    }
+    if (pipe2(mWakeFd, O_NONBLOCK | O_CLOEXEC) < 0) {
+        Esyslog("Can not create event pipe: %s", strerror(errno));
+        return false;
+    }
+    mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (mListenFd < 0) {
+        Esyslog("Can not create event socket: %s", strerror(errno));
+        Close();
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, mPath.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(mPath.c_str());
+    if ((bind(mListenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+        (listen(mListenFd, MAX_SUBSCRIBERS) < 0)) {
+        Esyslog("Can not bind event socket %s: %s",
+                mPath.c_str(), strerror(errno));
+        close(mListenFd);
+        mListenFd = -1;
+        Close();
+        return false;
+    }
+    chmod(mPath.c_str(), 0660);
+    Isyslog("Event socket %s", mPath.c_str());
+    Start();
+    return true;
+}
+
+/**
+ * @brief Stops the thread, closes all connections and removes the socket.
+ */
+void cEventSocket::Close()
+{
+    Cancel(-1);
+    if (mWakeFd[1] >= 0) {
+        (void)write(mWakeFd[1], "x", 1);
+    }
+    Cancel(3);
+    cMutexLock lock(&mMutex);
+    for (cSubscriber &sub : mSubscribers) {
+        close(sub.mFd);
+    }
+    mSubscribers.clear();
+    if (mListenFd >= 0) {
+        close(mListenFd);
+        mListenFd = -1;
+        unlink(mPath.c_str());
+    }
+    for (int i = 0; i < 2; i++) {
+        if (mWakeFd[i] >= 0) {
+            close(mWakeFd[i]);
+            mWakeFd[i] = -1;
+        }
+    }
+}
+
+/**
+ * @brief Encodes an event as one text line.
+ *
+ * @param event The event
+ * @return Encoded event including the line end
+ */
+string cEventSocket::Encode(const cCECBusEvent &event)
+{
+    char buf[64 + 2 * cCECBusEvent::MAX_PARAMS + cCECBusEvent::MAX_NAME];
+    char adapter[4] = "-";
+    int len;
+
+    if (event.mAdapter != cCECBusEvent::ADAPTER_NONE) {
+        snprintf(adapter, sizeof(adapter), "%x", event.mAdapter);
+    }
+    len = snprintf(buf, sizeof(buf), "%c %" PRIu64 " %s",
+                   event.mType, event.mTimeMs, adapter);
+    switch (event.mType) {
+    case cCECBusEvent::FRAME:
+        len += snprintf(buf + len, sizeof(buf) - len, " %x%x %02x",
+                        event.mInitiator & 0xF, event.mDestination & 0xF,
+                        event.mOpcode & 0xFF);
+        if (event.mParamCount > 0) {
+            buf[len++] = ' ';
+            for (int i = 0; i < event.mParamCount; i++) {
+                len += snprintf(buf + len, sizeof(buf) - len, "%02x",
+                                event.mParams[i]);
+            }
+        }
+        break;
+    case cCECBusEvent::KEY:
+    case cCECBusEvent::ALERT:
+        len += snprintf(buf + len, sizeof(buf) - len, " %x", event.mValue);
+        break;
+    case cCECBusEvent::POWER:
+        len += snprintf(buf + len, sizeof(buf) - len, " %x %x",
+                        event.mInitiator, event.mValue);
+        break;
+    case cCECBusEvent::SOURCE:
+        if (event.mInitiator > 0xF) {
+            len += snprintf(buf + len, sizeof(buf) - len, " - %04x",
+                            event.mValue & 0xFFFF);
+        }
+        else {
+            len += snprintf(buf + len, sizeof(buf) - len, " %x %04x",
+                            event.mInitiator, event.mValue & 0xFFFF);
+        }
+        break;
+    case cCECBusEvent::PLAYER:
+        len += snprintf(buf + len, sizeof(buf) - len, " %.*s",
+                        cCECBusEvent::MAX_NAME, event.mName);
+        break;
+    case cCECBusEvent::COMMANDLIST:
+        len += snprintf(buf + len, sizeof(buf) - len, " %.*s %x",
+                        cCECBusEvent::MAX_NAME, event.mName, event.mValue);
+        break;
+    default:
+        break;
+    }
+    string line(buf, len);
+    line += '\n';
+    return line;
+}
+
+/**
+ * @brief Queues an event for all subscribers.
+ *
+ * Called from the libCEC callback threads, the worker threads and the
+ * VDR main thread. The event is encoded once and appended to the buffer
+ * of every subscriber, subscribers with a full buffer drop the event.
+ *
+ * @param event The event to publish
+ */
+void cEventSocket::Publish(const cCECBusEvent &event)
+{
+    string line = Encode(event);
+    {
+        cMutexLock lock(&mMutex);
+        if (mSubscribers.empty()) {
+            return;
+        }
+        for (cSubscriber &sub : mSubscribers) {
+            if (sub.mDropped > 0) {
+                char drop[32];
+                int len = snprintf(drop, sizeof(drop), "D %x\n", sub.mDropped);
+                if (sub.mBuffer.size() + len + line.size() > BUFFER_SIZE) {
+                    sub.mDropped++;
+                    cMetrics::Inc(cMetrics::EVENTS_DROPPED);
+                    continue;
+                }
+                sub.mBuffer.append(drop, len);
+                sub.mDropped = 0;
+            }
+            if (sub.mBuffer.size() + line.size() > BUFFER_SIZE) {
+                sub.mDropped++;
+                cMetrics::Inc(cMetrics::EVENTS_DROPPED);
+                continue;
+            }
+            sub.mBuffer += line;
+        }
+    }
+    // A full pipe already wakes up the thread
+    (void)write(mWakeFd[1], "x", 1);
+}
+
+/**
+ * @brief Sends as much buffered data as the socket accepts.
+ *
+ * @param sub The subscriber, mMutex must be locked
+ * @return false if the connection is broken
+ */
+bool cEventSocket::Flush(cSubscriber &sub)
+{
+    if (sub.mBuffer.empty()) {
+        return true;
+    }
+    ssize_t len = send(sub.mFd, sub.mBuffer.data(), sub.mBuffer.size(),
+                       MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (len < 0) {
+        return ((errno == EAGAIN) || (errno == EINTR));
+    }
+    sub.mBuffer.erase(0, len);
+    return true;
+}
+
+/**
+ * @brief Main loop of the event socket thread.
+ *
+ * Accepts new subscribers and sends the buffered events. Data received
+ * from a subscriber is discarded, it is only read to detect the end of
+ * the connection.
+ */
+void cEventSocket::Action()
+{
+    Dsyslog("Event socket thread started");
+    while (Running()) {
+        vector<struct pollfd> fds;
+        {
+            cMutexLock lock(&mMutex);
+            fds.resize(mSubscribers.size() + 2);
+            for (size_t i = 0; i < mSubscribers.size(); i++) {
+                fds[i + 2].fd = mSubscribers[i].mFd;
+                fds[i + 2].events = POLLIN;
+                if (!mSubscribers[i].mBuffer.empty()) {
+                    fds[i + 2].events |= POLLOUT;
+                }
+            }
+        }
+        fds[0].fd = mListenFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = mWakeFd[0];
+        fds[1].events = POLLIN;
+        int rc = poll(fds.data(), fds.size(), 500);
+        if (rc < 0) {
+            if (errno != EINTR) {
+                Esyslog("Event socket poll failed: %s", strerror(errno));
+                break;
+            }
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            char buf[64];
+            while (read(mWakeFd[0], buf, sizeof(buf)) > 0) {
+            }
+        }
+
+        cMutexLock lock(&mMutex);
+        // Only this thread changes mSubscribers, the indices are valid
+        for (size_t i = fds.size() - 1; i >= 2; i--) {
+            cSubscriber &sub = mSubscribers[i - 2];
+            bool ok = true;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                char buf[64];
+                ssize_t len = recv(sub.mFd, buf, sizeof(buf), MSG_DONTWAIT);
+                ok = (len > 0) ||
+                     ((len < 0) && ((errno == EAGAIN) || (errno == EINTR)));
+            }
+            if (ok) {
+                ok = Flush(sub);
+            }
+            if (!ok) {
+                Dsyslog("Event subscriber disconnected");
+                close(sub.mFd);
+                mSubscribers.erase(mSubscribers.begin() + (i - 2));
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(mListenFd, nullptr, nullptr,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0) {
+                if (mSubscribers.size() >= MAX_SUBSCRIBERS) {
+                    close(fd);
+                }
+                else {
+                    cSubscriber sub;
+                    char hello[16];
+                    sub.mFd = fd;
+                    sub.mBuffer.reserve(BUFFER_SIZE);
+                    sub.mBuffer.append(hello, snprintf(hello, sizeof(hello),
+                                                       "V %d\n", VERSION));
+                    mSubscribers.push_back(std::move(sub));
+                    Dsyslog("Event subscriber connected");
+                }
+            }
+        }
+    }
+    Dsyslog("Event socket thread stopped");
+}
+
+} // namespace cecplugin
@@ -0,0 +1,110 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the event subscription socket.
+ */
+
+#ifndef EVENTSOCKET_H_
+#define EVENTSOCKET_H_
+
+#include <vdr/thread.h>
+#include <string>
+#include <vector>
+
+#include "busevent.h"
+
+namespace cecplugin {
+
+/**
+ * @class cEventSocket
+ * @brief Unix domain socket streaming plugin events to subscribers.
+ *
+ * Every client connected to the socket receives all events published
+ * after the connection, one event per line:
+ *
+ * - F <time> <adapter> <initiator><destination> <opcode> [<params>]
+ * - K <time> <adapter> <keycode>
+ * - P <time> <adapter> <logical address> <power status>
+ * - S <time> - <tv|radio|replay|stop>
+ * - L <time> <adapter> <event> <number of commands>
+ * - A <time> <adapter> <alert>
+ * - D <number of dropped events>
+ *
+ * All numbers except the time are hexadecimal. The first line sent after
+ * connecting is "V <version>" of the encoding.
+ *
+ * Publish() only appends to a bounded buffer per subscriber, a subscriber
+ * which does not read loses events (reported by a D line) instead of
+ * blocking the libCEC callback threads.
+ */
+class cEventSocket : public cThread {
+private:
+    static constexpr const int VERSION = 1;            ///< Encoding version
+    static constexpr const int MAX_SUBSCRIBERS = 8;    ///< Concurrent subscribers
+    static constexpr const size_t BUFFER_SIZE = 16384; ///< Buffer per subscriber
+
+    /** @brief State of a connected subscriber. */
+    class cSubscriber {
+    public:
+        int mFd = -1;           ///< Socket of the subscriber
+        std::string mBuffer;    ///< Encoded events not yet sent
+        unsigned mDropped = 0;  ///< Events dropped since the last D line
+    };
+
+    std::string mPath;                     ///< Path of the socket
+    int mListenFd = -1;                    ///< Listening socket
+    int mWakeFd[2] = {-1, -1};             ///< Pipe to wake up the thread
+    cMutex mMutex;                         ///< Protects mSubscribers
+    std::vector<cSubscriber> mSubscribers; ///< Connected subscribers
+
+    /** @brief Main thread loop - accepts subscribers and sends events. */
+    void Action();
+
+    /**
+     * @brief Sends buffered events to a subscriber.
+     * @param sub The subscriber.
+     * @return false if the connection was closed.
+     */
+    bool Flush(cSubscriber &sub);
+
+    /**
+     * @brief Encodes an event as one line.
+     * @param event The event.
+     * @return Encoded event including the line end.
+     */
+    static std::string Encode(const cCECBusEvent &event);
+
+public:
+    /**
+     * @brief Constructs the event socket.
+     * @param path File system path of the socket.
+     */
+    explicit cEventSocket(const std::string &path);
+
+    /** @brief Destructor - stops the thread and removes the socket. */
+    ~cEventSocket();
+
+    /**
+     * @brief Creates the socket and starts the thread.
+     * @return false if the socket could not be created.
+     */
+    bool Open();
+
+    /** @brief Stops the thread and closes all connections. */
+    void Close();
+
+    /**
+     * @brief Queues an event for all subscribers, never blocks on a client.
+     * @param event The event to publish.
+     */
+    void Publish(const cCECBusEvent &event);
+};
+
+} // namespace cecplugin
+
+#endif /* EVENTSOCKET_H_ */
@@ -10,10 +10,12 @@
  */
 
 #include <sys/wait.h>
+#include <stdexcept>
 #include "cecremote.h"
 #include "ceclog.h"
 #include "cecremoteplugin.h"
 #include "ceccontrol.h"
+#include "metrics.h"
 
 using namespace std;
 using namespace cecplugin;
@@ -43,7 +45,9 @@ void cCECRemote::ActionKeyPress(cCmd &cmd)
             ceckey = *ci;
             Dsyslog ("Send Keypress VDR %d - > CEC 0x%02x", cmd.mVal, ceckey);
             if (ceckey != CEC_USER_CONTROL_CODE_UNKNOWN) {
-                if (!mCECAdapter->SendKeypress(addr, ceckey, true)) {
+                cLibCECCall call(this, "SendKeypress");
+                if (!cMetrics::Transmitted(
+                        mCECAdapter->SendKeypress(addr, ceckey, true))) {
                     Esyslog("Keypress to %d %s failed",
                             addr, mCECAdapter->ToString(addr));
                     return;
@@ -58,6 +62,254 @@ void cCECRemote::ActionKeyPress(cCmd &cmd)
     }
 }
 
+/**
+ * @brief Forwards a VDR key to a CEC device using the global keymap.
+ *
+ * Unlike ActionKeyPress the keypress and release are only queued in
+ * libCEC without waiting for an acknowledge, so the worker is not
+ * blocked while volume keys are repeated.
+ *
+ * @param cmd Reference to the command containing key and device info
+ */
+void cCECRemote::ActionGlobalKeyPress(const cCmd &cmd)
+{
+    cCECDevice dev = cmd.mDevice;
+    cec_logical_address addr = getLogical(dev);
+    if (addr == CECDEVICE_UNKNOWN) {
+        return;
+    }
+    const cCECList ceckmap = mPlugin->mKeyMaps.GlobalVDRtoCECKey((eKeys)cmd.mVal);
+    for (const cec_user_control_code ceckey : ceckmap) {
+        Dsyslog ("Send global Keypress VDR %d - > CEC 0x%02x", cmd.mVal, ceckey);
+        if (ceckey == CEC_USER_CONTROL_CODE_UNKNOWN) {
+            continue;
+        }
+        cLibCECCall call(this, "SendKeypress");
+        if (!cMetrics::Transmitted(
+                mCECAdapter->SendKeypress(addr, ceckey, false))) {
+            Esyslog("Keypress to %d %s failed",
+                    addr, mCECAdapter->ToString(addr));
+            return;
+        }
+        if (!mCECAdapter->SendKeyRelease(addr, false)) {
+            Esyslog("SendKeyRelease to %d %s failed",
+                    addr, mCECAdapter->ToString(addr));
+        }
+    }
+}
+
+/**
+ * @brief Transmits a raw CEC frame configured with <send>.
+ *
+ * @param cmd Reference to the command with destination, opcode and parameters
+ */
+void cCECRemote::ActionSend(const cCmd &cmd)
+{
+    cec_command data;
+    cCECDevice dev = cmd.mDevice;
+    cec_logical_address addr = getLogical(dev);
+    if (addr == CECDEVICE_UNKNOWN) {
+        return;
+    }
+    // Replies to GIVE_* requests go to the initiator, so send as VDR
+    cec_logical_address own = mCECAdapter->GetLogicalAddresses().primary;
+    cec_command::Format(data, own, addr, cmd.mCecOpcode);
+    for (uint8_t p : cmd.mParams) {
+        data.PushBack(p);
+    }
+    Dsyslog("Send : %02x %02x %02x (%d params)", data.initiator,
+            data.destination, data.opcode, (int)cmd.mParams.size());
+    cLibCECCall call(this, "Transmit");
+    if (!cMetrics::Transmitted(mCECAdapter->Transmit(data))) {
+        Esyslog("Transmit of opcode %02x to %s failed", cmd.mCecOpcode,
+                mCECAdapter->ToString(addr));
+    }
+}
+
+/**
+ * @brief Executes one branch of an <if> command.
+ *
+ * The power status is taken from the cache if the device reported it
+ * recently. The branch is executed before the commands following the
+ * <if> in the same command list.
+ *
+ * @param cmd Reference to the command with device, status and branches
+ */
+void cCECRemote::ActionIf(const cCmd &cmd)
+{
+    cec_power_status status = CEC_POWER_STATUS_UNKNOWN;
+    cCECDevice dev = cmd.mDevice;
+
+    if (mCECAdapter != nullptr) {
+        cec_logical_address addr = getLogical(dev);
+        if (addr != CECDEVICE_UNKNOWN) {
+            status = GetPowerStatus(addr);
+        }
+    }
+    Dsyslog("If: %d == %d", status, cmd.mVal);
+    if (status == (cec_power_status)cmd.mVal) {
+        PushCmdQueueFront(cmd.mThen, cmd.mEvent);
+    }
+    else {
+        PushCmdQueueFront(cmd.mElse, cmd.mEvent);
+    }
+}
+
+/**
+ * @brief Switches the active key maps configured with <keymap>.
+ *
+ * @param cmd Reference to the command with the key map ids
+ */
+void cCECRemote::ActionKeymap(const cCmd &cmd)
+{
+    Dsyslog("Keymap VDR %s CEC %s GLOBAL %s", cmd.mVDRKeymap.c_str(),
+            cmd.mCECKeymap.c_str(), cmd.mGLOBALKeymap.c_str());
+    try {
+        mPlugin->mKeyMaps.SetActiveKeymaps(cmd.mVDRKeymap, cmd.mCECKeymap,
+                                           cmd.mGLOBALKeymap);
+    }
+    catch (const std::out_of_range &e) {
+        Esyslog("Unknown keymap VDR %s CEC %s GLOBAL %s",
+                cmd.mVDRKeymap.c_str(), cmd.mCECKeymap.c_str(),
+                cmd.mGLOBALKeymap.c_str());
+    }
+}
+
+/**
+ * @brief Routes the HDMI switches to a device configured with <route>.
+ *
+ * Nothing is sent if the device is already the active source. Otherwise
+ * a single ROUTING_CHANGE is broadcast; only the switches below the part
+ * of the route shared with the current source have to change their input.
+ *
+ * @param cmd Reference to the command with the target device
+ */
+void cCECRemote::ActionRoute(const cCmd &cmd)
+{
+    if (mCECAdapter == nullptr) {
+        Esyslog("Route: CEC Adapter disconnected");
+        return;
+    }
+    cCECDevice dev = cmd.mDevice;
+    cec_logical_address addr = getLogical(dev);
+    uint16_t to = mBusState.GetPhysicalAddress(addr);
+    if (to == cCECBusSnapshot::PHYSICAL_UNKNOWN) {
+        to = dev.mPhysicalAddress;
+    }
+    if ((to == 0) || (to == cCECBusSnapshot::PHYSICAL_UNKNOWN)) {
+        Esyslog("Route: physical address of device unknown");
+        return;
+    }
+
+    cec_logical_address active;
+    uint16_t from;
+    mBusState.GetActiveSource(active, from);
+    if (from == to) {
+        Dsyslog("Route to %04x suppressed, already active", to);
+        mSourceSuppressed++;
+        return;
+    }
+    if (from == cCECBusSnapshot::PHYSICAL_UNKNOWN) {
+        from = 0;
+    }
+    std::vector<uint16_t> ports;
+    cCECBusState::GetRouteChange(from, to, ports);
+    for (uint16_t port : ports) {
+        cec_logical_address sw =
+                mBusState.FindDevice(cCECBusState::ParentAddress(port));
+        Dsyslog("Route: switch %d selects %04x", sw, port);
+    }
+
+    cec_command data;
+    cec_command::Format(data, mCECAdapter->GetLogicalAddresses().primary,
+                        CECDEVICE_BROADCAST, CEC_OPCODE_ROUTING_CHANGE);
+    data.PushBack(from >> 8);
+    data.PushBack(from & 0xFF);
+    data.PushBack(to >> 8);
+    data.PushBack(to & 0xFF);
+    Isyslog("Route %04x -> %04x", from, to);
+    bool sent;
+    {
+        cLibCECCall call(this, "Transmit");
+        sent = cMetrics::Transmitted(mCECAdapter->Transmit(data));
+    }
+    if (!sent) {
+        Esyslog("Transmit of ROUTING_CHANGE failed");
+        return;
+    }
+    // libCEC does not report frames sent by VDR itself
+    if (mBusState.SetActivePath(to)) {
+        SourceChanged(CEC_OPCODE_ROUTING_CHANGE);
+    }
+}
+
+/**
+ * @brief Sets several devices to standby without waiting in between.
+ *
+ * Devices which reported standby recently are skipped. The STANDBY
+ * frames are sent to all devices first, then the power status of all
+ * devices is polled together until they are in standby or the timeout
+ * (limited by the shutdown deadline) expired. Devices which did not
+ * reach standby during shutdown are reported.
+ *
+ * @param cmd Reference to the command with the <poweroff> commands
+ */
+void cCECRemote::ActionStandbyGroup(const cCmd &cmd)
+{
+    std::vector<cec_logical_address> pending;
+    cec_power_status status;
+
+    for (const cCmd &off : cmd.mPoweroff) {
+        cCECDevice dev = off.mDevice;
+        cec_logical_address addr = getLogical(dev);
+        if (addr == CECDEVICE_UNKNOWN) {
+            continue;
+        }
+        if (mBusState.GetPowerStatus(addr, status) &&
+            (status == CEC_POWER_STATUS_STANDBY)) {
+            Dsyslog("Standby %d skipped, already in standby", addr);
+            continue;
+        }
+        Isyslog("Power off %d", addr);
+        bool ok;
+        {
+            cLibCECCall call(this, "StandbyDevices");
+            ok = cMetrics::Transmitted(mCECAdapter->StandbyDevices(addr));
+        }
+        if (ok) {
+            pending.push_back(addr);
+        }
+        else {
+            Esyslog("StandbyDevices failed for %s", mCECAdapter->ToString(addr));
+        }
+    }
+
+    cTimeMs t(StopBudget(5000));
+    while (!pending.empty() && !t.TimedOut() && !mStalled) {
+        cCondWait::SleepMs(100);
+        for (auto i = pending.begin(); i != pending.end(); ) {
+            {
+                cLibCECCall call(this, "GetDevicePowerStatus");
+                status = mCECAdapter->GetDevicePowerStatus(*i);
+            }
+            UpdatePowerStatus(*i, status);
+            if ((status == CEC_POWER_STATUS_STANDBY) ||
+                (status == CEC_POWER_STATUS_UNKNOWN)) {
+                i = pending.erase(i);
+            }
+            else {
+                ++i;
+            }
+        }
+    }
+    if (mStopDeadline.load() != 0) {
+        for (cec_logical_address addr : pending) {
+            mStopSkipped.push_back(*cString::sprintf("standby of %d not confirmed",
+                                                     addr));
+        }
+    }
+}
+
 /**
  * @brief Sends a TEXT_VIEW_ON CEC command.
  *
@@ -77,7 +329,8 @@ bool cCECRemote::TextViewOn(cec_logical_address address)
 
     cec_command::Format(data, mCECConfig.baseDevice, address, CEC_OPCODE_TEXT_VIEW_ON);
     Dsyslog("Text View on : %02x %02x %02x", data.initiator, data.destination, data.opcode);
-    return mCECAdapter->Transmit(data);
+    cLibCECCall call(this, "Transmit");
+    return cMetrics::Transmitted(mCECAdapter->Transmit(data));
 }
 
 /**
@@ -111,7 +364,11 @@ void cCECRemote::ExecToggle(cCECDevice dev,
     {
         do {
             repeat = false;
-            status = mCECAdapter->GetDevicePowerStatus(addr);
+            {
+                cLibCECCall call(this, "GetDevicePowerStatus");
+                status = mCECAdapter->GetDevicePowerStatus(addr);
+            }
+            UpdatePowerStatus(addr, status);
             Dsyslog("ExecToggle: %s", mCECAdapter->ToString(status));
             // If currently in any transition state, wait.
             if ((status == CEC_POWER_STATUS_IN_TRANSITION_STANDBY_TO_ON) ||
@@ -122,30 +379,125 @@ void cCECRemote::ExecToggle(cCECDevice dev,
         } while (repeat);
     }
 
+    // The command lists may address devices on other adapters
     if (status == CEC_POWER_STATUS_ON) {
-        PushCmdQueue(poweroff);
+        mPlugin->PushCmdQueue(poweroff);
     }
     else {
-        PushCmdQueue(poweron);
+        mPlugin->PushCmdQueue(poweron);
     }
 }
 
+/**
+ * @brief Makes VDR the active source (<makeactive>).
+ *
+ * The switch is suppressed if the routing state already shows VDR as
+ * the active source, so repeated <makeactive> in command lists do not
+ * cause the TV to re-select its input.
+ */
+void cCECRemote::ActionMakeActive()
+{
+    cec_logical_address addr;
+    uint16_t physical;
+
+    mBusState.GetActiveSource(addr, physical);
+    cec_logical_addresses own = mCECAdapter->GetLogicalAddresses();
+    if ((addr != CECDEVICE_UNKNOWN) && own[addr]) {
+        Dsyslog("Make active suppressed, already active source");
+        mSourceSuppressed++;
+        return;
+    }
+    Isyslog ("Make active");
+    cLibCECCall call(this, "SetActiveSource");
+    if (!mCECAdapter->SetActiveSource()) {
+        Esyslog("SetActiveSource failed");
+    }
+}
+
+/**
+ * @brief Removes VDR as active source (<makeinactive>).
+ *
+ * The INACTIVE_SOURCE is suppressed if another device is known to be
+ * the active source.
+ */
+void cCECRemote::ActionMakeInactive()
+{
+    cec_logical_address addr;
+    uint16_t physical;
+
+    mBusState.GetActiveSource(addr, physical);
+    cec_logical_addresses own = mCECAdapter->GetLogicalAddresses();
+    if ((addr != CECDEVICE_UNKNOWN) && !own[addr]) {
+        Dsyslog("Make inactive suppressed, active source is %d", addr);
+        mSourceSuppressed++;
+        return;
+    }
+    Isyslog ("Make inactive");
+    cLibCECCall call(this, "SetInactiveView");
+    if (!mCECAdapter->SetInactiveView()) {
+        Esyslog("SetInactiveView failed");
+    }
+}
+
+/**
+ * @brief Executes the actions of a handler.
+ *
+ * Stops and starts the configured menus and queues the command list.
+ *
+ * @param handler <onceccommand> or <onactivesource> handler
+ * @param event Event passed to the command list
+ */
+void cCECRemote::RunHandler(const cCECCommandHandler &handler,
+                            const cCECEvent &event)
+{
+    // First stop the defined player if running
+    if (!handler.mStopMenu.empty()) {
+        // Get current running control
+        cMutexLock lock;
+        cControl *c = cControl::Control(lock);
+        if (c != NULL) {
+            if (cCECControl* cont = dynamic_cast<cCECControl*>(c)) {
+                Dsyslog("Stillpic Player running %s %s",
+                        cont->getMenuTitle().c_str(),
+                        handler.mStopMenu.c_str());
+                if (cont->getMenuTitle() == handler.mStopMenu) {
+                    cont->Shutdown();
+                }
+            }
+        }
+    }
+    // Startup a new menu/player if defined
+    if (!handler.mExecMenu.empty()) {
+        cCECMenu menuitem;
+        if (mPlugin->FindMenu(handler.mExecMenu, menuitem)) {
+            mPlugin->StartPlayer(menuitem);
+        }
+    }
+    // Now Push the command queue
+    mPlugin->PushCmdQueue(handler.mCommands, &event);
+}
+
 /**
  * @brief Processes CEC commands received from the bus.
  *
- * Looks up registered handlers for the CEC opcode and executes
- * matching actions (start/stop menus, run command queues).
+ * Looks up registered handlers for the CEC opcode and executes the
+ * actions (start/stop menus, run command queues) of the handlers whose
+ * initiator and parameter pattern match.
  *
  * @param cmd Reference to the received CEC command
  */
 void cCECRemote::CECCommand(const cCmd &cmd) {
-    mapCommandHandler *h = mPlugin->GetCECCommandHandlers();
-
-    std::pair<mapCommandHandlerIterator, mapCommandHandlerIterator> range;
-    range = h->equal_range(cmd.mCecOpcode);
+    const cCECCommandHandlerVector &handlers =
+            mPlugin->GetCECCommandHandlers()->Find(cmd.mCecOpcode);
 
-    for (mapCommandHandlerIterator i = range.first; i != range.second; i++) {
-        cCECCommandHandler handler = i->second;
+    for (const cCECCommandHandler &handler : handlers) {
+        // Handler is bound to a device on a different CEC bus
+        if (handler.mDevice.mAdapter != mAdapterIndex) {
+            continue;
+        }
+        if (!handler.mParams.Matches(cmd.mParams)) {
+            continue;
+        }
         cec_logical_address devaddr = getLogical(handler.mDevice);
         Csyslog("Handler for CEC Command %d test %d %d\n",
                 cmd.mCecOpcode, cmd.mCecLogicalAddress, devaddr);
@@ -153,34 +505,55 @@ void cCECRemote::CECCommand(const cCmd &cmd) {
             Dsyslog("Handler for CEC Command %d found %d %d\n", cmd.mCecOpcode,
                     cmd.mCecLogicalAddress, devaddr);
 
-            // First stop the defined player if running
-            if (!handler.mStopMenu.empty()) {
-                // Get current running control
-            	cMutexLock lock;
-                cControl *c = cControl::Control(lock);
-                if (c != NULL) {
-                    if (cCECControl* cont = dynamic_cast<cCECControl*>(c)) {
-                        Dsyslog("Stillpic Player running %s %s",
-                                cont->getMenuTitle().c_str(),
-                                handler.mStopMenu.c_str());
-                        if (cont->getMenuTitle() == handler.mStopMenu) {
-                            cont->Shutdown();
-                        }
-                    }
-                }
+            cCECEvent event("ceccommand");
+            event.mOpcode = cmd.mCecOpcode;
+            event.mInitiator = cmd.mCecLogicalAddress;
+            event.mParams = cmd.mParams;
+            RunHandler(handler, event);
+        }
+    }
+}
+
+/**
+ * @brief Executes the <onactivesource> handlers matching the new source.
+ *
+ * A handler without device matches every change. A handler with a
+ * physical address matches the route, otherwise the logical address
+ * of the device is compared with the new source.
+ *
+ * @param cmd Command with new source (mCecLogicalAddress, mVal physical)
+ *            and the opcode which caused the change
+ */
+void cCECRemote::ActionSourceChanged(const cCmd &cmd)
+{
+    cCECCommandHandlerList *handlers = mPlugin->GetActiveSourceHandlers();
+    uint16_t physical = (uint16_t)cmd.mVal;
+
+    for (cCECCommandHandler handler : *handlers) {
+        if (handler.mDevice.mAdapter != mAdapterIndex) {
+            continue;
+        }
+        if (handler.mDevice.mPhysicalAddress != 0) {
+            if (handler.mDevice.mPhysicalAddress != physical) {
+                continue;
             }
-            // Startup a new menu/player if defined
-            if (!handler.mExecMenu.empty()) {
-                cCECMenu menuitem;
-                if (mPlugin->FindMenu(handler.mExecMenu, menuitem)) {
-                    mPlugin->StartPlayer(menuitem);
-                }
+        }
+        else if (handler.mDevice.mLogicalAddressDefined != CECDEVICE_UNKNOWN) {
+            if ((cmd.mCecLogicalAddress == CECDEVICE_UNKNOWN) ||
+                (getLogical(handler.mDevice) != cmd.mCecLogicalAddress)) {
+                continue;
             }
-            // Now Push the command queue
-            PushCmdQueue(handler.mCommands);
         }
+        Dsyslog("Handler for active source %d %04x found",
+                cmd.mCecLogicalAddress, physical);
+
+        cCECEvent event("activesource");
+        event.mOpcode = cmd.mCecOpcode;
+        event.mInitiator = cmd.mCecLogicalAddress;
+        event.mParams.push_back(physical >> 8);
+        event.mParams.push_back(physical & 0xFF);
+        RunHandler(handler, event);
     }
 }
 
 } // namespace cecplugin
-
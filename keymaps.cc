@@ -12,6 +12,7 @@
 #include <stdexcept>
 #include "keymaps.h"
 #include "ceclog.h"
+#include "probes.h"
 
 using namespace std;
 
@@ -25,6 +26,9 @@ namespace cecplugin {
  * name lookup table.
  */
 cKeyMaps::cKeyMaps() {
+    for (int i = 0; i < kNone; i++) {
+        mGlobalKeyMapped[i] = false;
+    }
     for (int i = 0; i <= CEC_USER_CONTROL_CODE_MAX; i++) {
         mDefaultKeyMap[i][0] = kNone;
         mDefaultKeyMap[i][1] = kNone;
@@ -167,6 +171,9 @@ cKeyMaps::cKeyMaps() {
     mCECKeyNames[CEC_USER_CONTROL_CODE_INPUT_SELECT                ] = "INPUT_SELECT";
     mCECKeyNames[CEC_USER_CONTROL_CODE_HELP                        ] = "HELP";
     mCECKeyNames[CEC_USER_CONTROL_CODE_AN_CHANNELS_LIST            ] = "AN_CHANNELS_LIST";
+    for (int i = 0; i <= CECDEVICE_BROADCAST; i++) {
+        mInitiatorCecKeyMap[i] = nullptr;
+    }
     Dsyslog("Load keymap");
     InitCECKeyFromDefault(DEFAULTKEYMAP);
     InitVDRKeyFromDefault(DEFAULTKEYMAP);
@@ -330,22 +337,42 @@ cec_user_control_code cKeyMaps::StringToCEC(const string &s)
 }
 
 /**
- * @brief Converts a CEC key to a list of VDR keys.
+ * @brief Converts a CEC key to VDR keys.
  *
- * Uses the active CEC keymap to translate an incoming CEC
- * key press to one or more VDR key events.
+ * Uses the CEC keymap of the initiator, or the active CEC keymap if the
+ * initiator has none, to translate an incoming CEC key press to one or
+ * more VDR key events. The keys are copied into the fixed array of the
+ * caller, so the lookup does not allocate. cConfigFileParser rejects
+ * mappings with more than MAXKEYS keys.
  *
  * @param code The CEC user control code to convert
- * @return List of corresponding VDR keys (may be empty)
+ * @param initiator Logical address of the sender of the key
+ * @param keys Array of MAXKEYS entries for the VDR keys
+ * @return Number of corresponding VDR keys (may be 0)
  */
-cKeyList cKeyMaps::CECtoVDRKey(cec_user_control_code code)
+int cKeyMaps::CECtoVDRKey(cec_user_control_code code,
+                          cec_logical_address initiator, eKeys keys[])
 {
-    try {
-        return mActiveCecKeyMap.at(code);
+    int count = 0;
+    if ((code < 0) || (code > CEC_USER_CONTROL_CODE_MAX)) {
+        return count;
     }
-    catch (const std::out_of_range& oor) { }
-    cKeyList empty;
-    return empty; // Empty list
+    cMutexLock lock(&mActiveMutex);
+    const cKeyMap *map = &mActiveCecKeyMap;
+    if ((initiator >= CECDEVICE_TV) && (initiator <= CECDEVICE_BROADCAST) &&
+        (mInitiatorCecKeyMap[initiator] != nullptr)) {
+        map = mInitiatorCecKeyMap[initiator];
+    }
+    if ((size_t)code >= map->size()) {
+        return count;
+    }
+    for (const auto k : (*map)[code]) {
+        if (count >= MAXKEYS) {
+            break;
+        }
+        keys[count++] = k;
+    }
+    return count;
 }
 
 /**
@@ -359,6 +386,7 @@ cKeyList cKeyMaps::CECtoVDRKey(cec_user_control_code code)
  */
 cCECList cKeyMaps::VDRtoCECKey(eKeys key)
 {
+    cMutexLock lock(&mActiveMutex);
     try {
          return mActiveVdrKeyMap.at(key);
     }
@@ -367,6 +395,26 @@ cCECList cKeyMaps::VDRtoCECKey(eKeys key)
     return empty;
 }
 
+/**
+ * @brief Converts a VDR key to a list of CEC keys for global forwarding.
+ *
+ * Uses the active global keymap to translate a VDR key pressed
+ * outside of a player to one or more CEC key events.
+ *
+ * @param key The VDR key to convert
+ * @return List of corresponding CEC keys (may be empty)
+ */
+cCECList cKeyMaps::GlobalVDRtoCECKey(eKeys key)
+{
+    cMutexLock lock(&mActiveMutex);
+    try {
+         return mActiveGlobalKeyMap.at(key);
+    }
+    catch (const std::out_of_range& oor) { }
+    cCECList empty;
+    return empty;
+}
+
 /**
  * @brief Finds the CEC key that exactly matches a VDR key.
  *
@@ -493,9 +541,46 @@ void cKeyMaps::SetActiveKeymaps(const string &vdrkeymapid,
                                    const string &ceckeymapid,
                                    const string &globalkeymapid)
 {
-    mActiveVdrKeyMap = mVDRKeyMap.at(vdrkeymapid);
-    mActiveCecKeyMap = mCECKeyMap.at(ceckeymapid);
-    mActiveGlobalKeyMap = mGLOBALKeyMap.at(globalkeymapid);
+    // Look up all maps first, so an unknown id leaves the active maps intact
+    const cVDRKeyMap &vdrmap = mVDRKeyMap.at(vdrkeymapid);
+    const cKeyMap &cecmap = mCECKeyMap.at(ceckeymapid);
+    const cVDRKeyMap &globalmap = mGLOBALKeyMap.at(globalkeymapid);
+    // Copy outside of the lock, the lookups only wait for the swap
+    cVDRKeyMap newvdrmap = vdrmap;
+    cKeyMap newcecmap = cecmap;
+    cVDRKeyMap newglobalmap = globalmap;
+    cMutexLock lock(&mActiveMutex);
+    mActiveVdrKeyMap.swap(newvdrmap);
+    mActiveCecKeyMap.swap(newcecmap);
+    mActiveGlobalKeyMap.swap(newglobalmap);
+    for (int i = 0; i < kNone; i++) {
+        mGlobalKeyMapped[i] = !mActiveGlobalKeyMap.at(i).empty();
+    }
+    CEC_PROBE3(keymap_switch, vdrkeymapid.c_str(), ceckeymapid.c_str(),
+               globalkeymapid.c_str());
+}
+
+/**
+ * @brief Sets the CEC->VDR keymap used for the keys of one initiator.
+ *
+ * The keymap overrides the active CEC keymap for keys sent by this
+ * logical address.
+ *
+ * @param initiator Logical address of the sender
+ * @param ceckeymapid The CEC keymap identifier
+ * @throws std::out_of_range if the keymap or the address is unknown
+ */
+void cKeyMaps::SetInitiatorKeymap(cec_logical_address initiator,
+                                  const string &ceckeymapid)
+{
+    if ((initiator < CECDEVICE_TV) || (initiator > CECDEVICE_BROADCAST)) {
+        throw std::out_of_range("initiator");
+    }
+    // The named maps are not modified after the configuration is parsed,
+    // so the table can point to them directly
+    const cKeyMap *cecmap = &mCECKeyMap.at(ceckeymapid);
+    cMutexLock lock(&mActiveMutex);
+    mInitiatorCecKeyMap[initiator] = cecmap;
 }
 
 } // namespace cecplugin
@@ -19,6 +19,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <atomic>
 #include <cectypes.h>
 #include <cec.h>
 
@@ -55,9 +56,12 @@ private:
     std::map<std::string, cVDRKeyMap> mVDRKeyMap;    ///< Named VDR->CEC key maps
     std::map<std::string, cKeyMap> mCECKeyMap;       ///< Named CEC->VDR key maps
     std::map<std::string, cVDRKeyMap> mGLOBALKeyMap; ///< Named global VDR->CEC maps
+    cMutex mActiveMutex;             ///< Protects the active maps
     cVDRKeyMap mActiveVdrKeyMap;     ///< Currently active VDR->CEC map
     cKeyMap mActiveCecKeyMap;        ///< Currently active CEC->VDR map
+    const cKeyMap *mInitiatorCecKeyMap[CECDEVICE_BROADCAST+1]; ///< CEC->VDR map per initiator, nullptr = active map
     cVDRKeyMap mActiveGlobalKeyMap;  ///< Currently active global map
+    std::atomic<bool> mGlobalKeyMapped[kNone]; ///< Keys with entries in the active global map
 
     /**
      * @brief Gets the first CEC key code mapped to a VDR key.
@@ -135,17 +139,42 @@ public:
     /**
      * @brief Converts a CEC key code to VDR key(s).
      * @param code CEC user control code.
-     * @return List of mapped VDR keys.
+     * @param initiator Logical address of the sender of the key.
+     * @param keys Receives the mapped VDR keys.
+     * @return Number of mapped VDR keys, at most MAXKEYS.
+     * @note Thread-safe and allocation free, the keys are copied from the
+     *       map of the initiator or, if it has none, the active map.
      */
-    cKeyList CECtoVDRKey(cec_user_control_code code);
+    int CECtoVDRKey(cec_user_control_code code, cec_logical_address initiator,
+                    eKeys keys[]);
 
     /**
      * @brief Converts a VDR key to CEC key(s).
      * @param key VDR key code.
      * @return List of mapped CEC keys.
+     * @note Thread-safe, the list is a copy of the active map entry.
      */
     cCECList VDRtoCECKey(eKeys key);
 
+    /**
+     * @brief Converts a VDR key to CEC key(s) using the active global map.
+     * @param key VDR key code.
+     * @return List of mapped CEC keys.
+     * @note Thread-safe, the list is a copy of the active map entry.
+     */
+    cCECList GlobalVDRtoCECKey(eKeys key);
+
+    /**
+     * @brief Checks if a VDR key is forwarded by the active global map.
+     * @param key VDR key code.
+     * @return true if at least one CEC key is mapped.
+     * @note Lock free, may be called from any thread.
+     */
+    bool IsGlobalKeyMapped(eKeys key) const {
+        return ((key >= 0) && (key < kNone) &&
+                mGlobalKeyMapped[key].load(std::memory_order_relaxed));
+    }
+
     /**
      * @brief Converts a CEC key name string to key code.
      * @param s Key name (e.g., "SELECT", "UP").
@@ -158,11 +187,32 @@ public:
      * @param vdrkeymapid ID of VDR key map to activate.
      * @param ceckeymapid ID of CEC key map to activate.
      * @param globalkeymapid ID of global key map to activate.
+     * @note Called by the VDR main thread and the workers, the lookups of
+     *       the other threads see either the old or the new maps.
      */
     void SetActiveKeymaps(const std::string &vdrkeymapid,
                           const std::string &ceckeymapid,
                           const std::string &globalkeymapid);
 
+    /**
+     * @brief Checks if a CEC key map is defined.
+     * @param ceckeymapid ID of the CEC key map.
+     * @return true if the key map exists.
+     */
+    bool HasCECKeymap(const std::string &ceckeymapid) const {
+        return mCECKeyMap.count(ceckeymapid) != 0;
+    }
+
+    /**
+     * @brief Sets the CEC key map used for the keys of one initiator.
+     * @param initiator Logical address of the sender.
+     * @param ceckeymapid ID of the CEC key map, it overrides the active
+     *        CEC key map for this initiator.
+     * @throws std::out_of_range if the key map or the address is unknown.
+     */
+    void SetInitiatorKeymap(cec_logical_address initiator,
+                            const std::string &ceckeymapid);
+
     /**
      * @brief Lists all available key map IDs.
      * @return Formatted string for SVDRP output.
@@ -197,6 +247,7 @@ public:
     cString ListGLOBALKeyMap(const std::string &id);
 
     static constexpr char const *DEFAULTKEYMAP = "default";  ///< Default key map ID
+    static constexpr int MAXKEYS = 8;  ///< Max. VDR keys per CEC key in CECtoVDRKey
 };
 
 } // namespace cecplugin
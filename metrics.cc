@@ -0,0 +1,259 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the Prometheus metrics of the plugin.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "cecremote.h"
+#include "ceclog.h"
+
+namespace cecplugin {
+
+cMutex cMetrics::sMutex;
+std::vector<cMetrics::cShard *> cMetrics::sShards;
+
+/**
+ * @brief Creates and registers the shard of a new thread.
+ *
+ * Only called for the first counter of a thread, so the lock is not
+ * taken on the counting path.
+ *
+ * @return The new shard
+ */
+cMetrics::cShard *cMetrics::Register()
+{
+    cShard *shard = new cShard();
+    cMutexLock lock(&sMutex);
+    sShards.push_back(shard);
+    return shard;
+}
+
+/**
+ * @brief Counts an executed command of a worker thread.
+ *
+ * @param cmd Command type
+ * @param us Execution time in us
+ */
+void cMetrics::Command(CECCommand cmd, uint64_t us)
+{
+    int index = cmd + 1;
+    if ((index < 0) || (index >= COMMAND_MAX)) {
+        return;
+    }
+    cShard *shard = Local();
+    Add(shard->mCommands[index], 1);
+    Add(shard->mCommandUs[index], us);
+}
+
+/**
+ * @brief Sums up the counters of all threads.
+ *
+ * The counters of a shard are read while its thread may count, so the
+ * sums are not an atomic snapshot. This is sufficient for monotonic
+ * counters scraped periodically.
+ *
+ * @param totals Receives the sums
+ */
+void cMetrics::Collect(cTotals &totals)
+{
+    totals = cTotals();
+    cMutexLock lock(&sMutex);
+    for (const cShard *shard : sShards) {
+        for (int i = 0; i < COUNTER_MAX; i++) {
+            totals.mCounters[i] +=
+                    shard->mCounters[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < COMMAND_MAX; i++) {
+            totals.mCommands[i] +=
+                    shard->mCommands[i].load(std::memory_order_relaxed);
+            totals.mCommandUs[i] +=
+                    shard->mCommandUs[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief Gets the metric label of a command type.
+ *
+ * @param index Command type + 1
+ * @return Label value
+ */
+const char *cMetrics::CommandName(int index)
+{
+    static const char *names[COMMAND_MAX] = {
+        "invalid", "exit", "keypress", "makeactive", "makeinactive",
+        "poweron", "poweroff", "vdrkeypress", "execshell", "exectoggle",
+        "textviewon", "reconnect", "connect", "disconnect", "command",
+        "globalkeypress", "waitpower", "delay", "send", "if", "keymap",
+        "sourcechanged", "route", "standbygroup"
+    };
+    if ((index < 0) || (index >= COMMAND_MAX)) {
+        return "unknown";
+    }
+    return names[index];
+}
+
+/**
+ * @brief Constructs the exporter and starts its thread.
+ *
+ * @param remotes CEC remote handlers of the adapters
+ * @param path Path of the metrics file
+ * @param interval Export interval in s
+ */
+cMetricsExporter::cMetricsExporter(const std::vector<cCECRemote *> &remotes,
+                                   const std::string &path, int interval) :
+        cThread("CEC metrics"),
+        mRemotes(remotes),
+        mPath(path),
+        mIntervalMs(interval * 1000)
+{
+    Isyslog("Metrics file %s every %d s", mPath.c_str(), interval);
+    Start();
+}
+
+/**
+ * @brief Destructor, stops the thread and writes the last values.
+ *
+ * Must be deleted before the CEC remote handlers.
+ */
+cMetricsExporter::~cMetricsExporter()
+{
+    Cancel(-1);
+    mWait.Signal();
+    Cancel(3);
+    Export();
+}
+
+/**
+ * @brief Thread loop, exports the metrics every mIntervalMs.
+ */
+void cMetricsExporter::Action()
+{
+    while (Running()) {
+        Export();
+        mWait.Wait(mIntervalMs);
+    }
+}
+
+/**
+ * @brief Writes the metrics file in the Prometheus text format.
+ *
+ * The metrics are written to <path>.tmp, which is renamed to the
+ * metrics file when complete.
+ *
+ * @return false if the file could not be written
+ */
+bool cMetricsExporter::Export()
+{
+    cMetrics::cTotals t;
+    cMetrics::Collect(t);
+
+    std::string tmp = mPath + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
+    if (f == nullptr) {
+        Esyslog("Can not write metrics file %s: %s",
+                tmp.c_str(), strerror(errno));
+        return false;
+    }
+
+    fprintf(f, "# HELP vdr_cec_queue_depth Commands waiting in a queue.\n"
+               "# TYPE vdr_cec_queue_depth gauge\n");
+    for (cCECRemote *remote : mRemotes) {
+        const char *id = remote->GetAdapterId().c_str();
+        fprintf(f, "vdr_cec_queue_depth{adapter=\"%s\",queue=\"work\"} %d\n",
+                id, remote->GetWorkQueueSize());
+        fprintf(f, "vdr_cec_queue_depth{adapter=\"%s\",queue=\"exec\"} %d\n",
+                id, remote->GetExecQueueSize());
+    }
+    fprintf(f, "# HELP vdr_cec_connected Adapter is connected.\n"
+               "# TYPE vdr_cec_connected gauge\n");
+    for (cCECRemote *remote : mRemotes) {
+        fprintf(f, "vdr_cec_connected{adapter=\"%s\"} %d\n",
+                remote->GetAdapterId().c_str(), remote->IsConnected() ? 1 : 0);
+    }
+
+    fprintf(f, "# HELP vdr_cec_commands_total Commands executed by the workers.\n"
+               "# TYPE vdr_cec_commands_total counter\n");
+    for (int i = 0; i < cMetrics::COMMAND_MAX; i++) {
+        if (t.mCommands[i] > 0) {
+            fprintf(f, "vdr_cec_commands_total{type=\"%s\"} %llu\n",
+                    cMetrics::CommandName(i),
+                    (unsigned long long)t.mCommands[i]);
+        }
+    }
+    fprintf(f, "# HELP vdr_cec_command_seconds_total Execution time of the commands.\n"
+               "# TYPE vdr_cec_command_seconds_total counter\n");
+    for (int i = 0; i < cMetrics::COMMAND_MAX; i++) {
+        if (t.mCommands[i] > 0) {
+            fprintf(f, "vdr_cec_command_seconds_total{type=\"%s\"} %.6f\n",
+                    cMetrics::CommandName(i), t.mCommandUs[i] / 1e6);
+        }
+    }
+
+    static const struct {
+        cMetrics::eCounter mCounter;
+        const char *mName;
+        const char *mHelp;
+        double mScale;
+    } counters[] = {
+        {cMetrics::TRANSMIT_OK, "vdr_cec_transmit_total{result=\"ok\"}",
+         "Transmissions to the CEC bus.", 1},
+        {cMetrics::TRANSMIT_FAILED, "vdr_cec_transmit_total{result=\"failed\"}",
+         nullptr, 1},
+        {cMetrics::RECONNECTS, "vdr_cec_reconnects_total",
+         "Reconnects of the adapters.", 1},
+        {cMetrics::KEYPRESSES, "vdr_cec_keypresses_total",
+         "Key presses received from the CEC bus.", 1},
+        {cMetrics::FRAMES, "vdr_cec_frames_received_total",
+         "CEC frames received from the bus.", 1},
+        {cMetrics::SCRIPTS, "vdr_cec_scripts_total",
+         "Finished scripts.", 1},
+        {cMetrics::SCRIPT_MS, "vdr_cec_script_seconds_total",
+         "Run time of the finished scripts.", 1e-3},
+        {cMetrics::SCRIPTS_FAILED, "vdr_cec_scripts_failed_total",
+         "Scripts with an exit code other than 0.", 1},
+        {cMetrics::SCRIPTS_TIMEDOUT, "vdr_cec_scripts_timedout_total",
+         "Scripts terminated after the timeout.", 1},
+        {cMetrics::EVENTS_DROPPED, "vdr_cec_events_dropped_total",
+         "Events dropped for slow event socket subscribers.", 1},
+    };
+    for (const auto &c : counters) {
+        if (c.mHelp != nullptr) {
+            // The metric name without labels
+            int len = strcspn(c.mName, "{");
+            fprintf(f, "# HELP %.*s %s\n# TYPE %.*s counter\n",
+                    len, c.mName, c.mHelp, len, c.mName);
+        }
+        if (c.mScale == 1) {
+            fprintf(f, "%s %llu\n", c.mName,
+                    (unsigned long long)t.mCounters[c.mCounter]);
+        }
+        else {
+            fprintf(f, "%s %.3f\n", c.mName,
+                    t.mCounters[c.mCounter] * c.mScale);
+        }
+    }
+
+    bool ok = (fflush(f) == 0);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || (rename(tmp.c_str(), mPath.c_str()) < 0)) {
+        Esyslog("Can not write metrics file %s: %s",
+                mPath.c_str(), strerror(errno));
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace cecplugin
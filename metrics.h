@@ -0,0 +1,182 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the Prometheus metrics of the plugin.
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <vdr/thread.h>
+#include <cectypes.h>
+#include <cec.h>
+#include <atomic>
+#include <list>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+
+#include "cmd.h"
+
+namespace cecplugin {
+
+class cCECRemote;
+
+/**
+ * @class cMetrics
+ * @brief Lock free counters of the plugin threads.
+ *
+ * Every thread counts into its own shard, so counting is a plain relaxed
+ * load and store without a lock or a shared cache line. The shards are
+ * registered once per thread and only summed up by Collect() when the
+ * metrics are exported. Shards of terminated threads (e.g. libCEC
+ * threads of a closed adapter) are kept, so the counters never decrease.
+ */
+class cMetrics {
+public:
+    /** @brief Counters besides the per command counters. */
+    typedef enum {
+        TRANSMIT_OK = 0,   ///< Successful libCEC transmissions
+        TRANSMIT_FAILED,   ///< Failed libCEC transmissions
+        RECONNECTS,        ///< Reconnects of an adapter
+        KEYPRESSES,        ///< Key presses received from the bus
+        FRAMES,            ///< CEC frames received from the bus
+        SCRIPTS,           ///< Finished scripts
+        SCRIPT_MS,         ///< Total run time of the finished scripts
+        SCRIPTS_FAILED,    ///< Scripts with an exit code != 0
+        SCRIPTS_TIMEDOUT,  ///< Scripts terminated after the timeout
+        EVENTS_DROPPED,    ///< Events dropped for slow subscribers
+        COUNTER_MAX
+    } eCounter;
+
+    /** @brief Number of command types, CEC_INVALID is index 0. */
+    static constexpr const int COMMAND_MAX = CEC_STANDBYGROUP + 2;
+
+    /** @brief Sums of all shards. */
+    class cTotals {
+    public:
+        uint64_t mCounters[COUNTER_MAX] = {};     ///< See eCounter
+        uint64_t mCommands[COMMAND_MAX] = {};     ///< Executed commands
+        uint64_t mCommandUs[COMMAND_MAX] = {};    ///< Execution time in us
+    };
+
+    /**
+     * @brief Increments a counter of the calling thread.
+     * @param counter The counter.
+     * @param n Increment.
+     */
+    static void Inc(eCounter counter, uint64_t n = 1) {
+        Add(Local()->mCounters[counter], n);
+    }
+
+    /**
+     * @brief Counts a libCEC transmission.
+     * @param ok Result of the libCEC call.
+     * @return ok, so the call can be wrapped.
+     */
+    static bool Transmitted(bool ok) {
+        Inc(ok ? TRANSMIT_OK : TRANSMIT_FAILED);
+        return ok;
+    }
+
+    /** @brief Gets the monotonic time in us for Command(). */
+    static uint64_t NowUs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    /**
+     * @brief Counts an executed command of a worker thread.
+     * @param cmd Command type.
+     * @param us Execution time in us.
+     */
+    static void Command(CECCommand cmd, uint64_t us);
+
+    /**
+     * @brief Sums up the counters of all threads.
+     * @param totals Receives the sums.
+     */
+    static void Collect(cTotals &totals);
+
+    /**
+     * @brief Gets the metric label of a command type.
+     * @param index Command type + 1.
+     * @return Label value.
+     */
+    static const char *CommandName(int index);
+
+private:
+    /** @brief Counters of one thread, only written by this thread. */
+    class cShard {
+    public:
+        std::atomic<uint64_t> mCounters[COUNTER_MAX] = {};
+        std::atomic<uint64_t> mCommands[COMMAND_MAX] = {};
+        std::atomic<uint64_t> mCommandUs[COMMAND_MAX] = {};
+    };
+
+    static cMutex sMutex;                  ///< Protects sShards
+    static std::vector<cShard *> sShards;  ///< Shards of all threads
+
+    /** @brief Gets the shard of the calling thread. */
+    static cShard *Local() {
+        static thread_local cShard *shard = nullptr;
+        if (shard == nullptr) {
+            shard = Register();
+        }
+        return shard;
+    }
+
+    /** @brief Creates and registers the shard of a new thread. */
+    static cShard *Register();
+
+    /** @brief Adds to a counter only written by the calling thread. */
+    static void Add(std::atomic<uint64_t> &c, uint64_t n) {
+        c.store(c.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @class cMetricsExporter
+ * @brief Writes the metrics periodically in the Prometheus text format.
+ *
+ * The file is written to a temporary file and renamed, so the textfile
+ * collector of the node_exporter never reads a partial file.
+ */
+class cMetricsExporter : public cThread {
+private:
+    std::vector<cCECRemote *> mRemotes;  ///< Source of the adapter gauges
+    std::string mPath;                   ///< Path of the metrics file
+    int mIntervalMs;                     ///< Export interval
+    cCondWait mWait;                     ///< Wakes the thread on exit
+
+    /** @brief Thread loop, exports every mIntervalMs. */
+    void Action();
+
+    /** @brief Writes the metrics file. */
+    bool Export();
+
+public:
+    /**
+     * @brief Constructs the exporter and starts its thread.
+     * @param remotes CEC remote handlers of the adapters.
+     * @param path Path of the metrics file.
+     * @param interval Export interval in s.
+     */
+    cMetricsExporter(const std::vector<cCECRemote *> &remotes,
+                     const std::string &path, int interval);
+
+    /** @brief Destructor, stops the thread and writes the last values. */
+    ~cMetricsExporter();
+};
+
+} // namespace cecplugin
+
+#endif /* METRICS_H_ */
@@ -0,0 +1,47 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This file defines the USDT static tracepoints of the plugin.
+ */
+
+#ifndef PROBES_H_
+#define PROBES_H_
+
+/*
+ * The probes use <sys/sdt.h> of SystemTap (package systemtap-sdt-dev or
+ * systemtap-sdt-devel). A probe is a single nop in the code and a note in
+ * the ELF file, it costs nothing until a tracer attaches to it:
+ *
+ *   bpftrace -l 'usdt:/usr/lib/vdr/libvdr-cecremote.so.*:cecremote:*'
+ *
+ * Without the header, or with -DDISABLE_SDT, the probes are compiled out.
+ */
+#if !defined(DISABLE_SDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define CEC_HAVE_SDT 1
+#endif
+#endif
+
+#ifdef CEC_HAVE_SDT
+#define CEC_PROBE1(name, a1) \
+    DTRACE_PROBE1(cecremote, name, a1)
+#define CEC_PROBE2(name, a1, a2) \
+    DTRACE_PROBE2(cecremote, name, a1, a2)
+#define CEC_PROBE3(name, a1, a2, a3) \
+    DTRACE_PROBE3(cecremote, name, a1, a2, a3)
+#define CEC_PROBE4(name, a1, a2, a3, a4) \
+    DTRACE_PROBE4(cecremote, name, a1, a2, a3, a4)
+#else
+#define CEC_PROBE1(name, a1) do {} while (0)
+#define CEC_PROBE2(name, a1, a2) do {} while (0)
+#define CEC_PROBE3(name, a1, a2, a3) do {} while (0)
+#define CEC_PROBE4(name, a1, a2, a3, a4) do {} while (0)
+#endif
+
+#endif /* PROBES_H_ */
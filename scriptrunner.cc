@@ -0,0 +1,517 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the supervision of scripts started by <exec>.
+ */
+
+#include <sys/wait.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+// close_range() requires glibc >= 2.34 and Linux >= 5.9
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+#include <linux/close_range.h>
+#define HAVE_CLOSE_RANGE 1
+#endif
+
+#include "scriptrunner.h"
+#include "threadsched.h"
+#include "ceclog.h"
+#include "metrics.h"
+#include "tracer.h"
+#include "probes.h"
+
+using namespace std;
+
+namespace cecplugin {
+
+/**
+ * @brief Constructs the script runner.
+ *
+ * @param timeoutms Default timeout of scripts in ms, 0 = none
+ * @param parallel Maximum number of scripts running at the same time
+ */
+cScriptRunner::cScriptRunner(int timeoutms, int parallel) :
+        cThread("CEC script runner"),
+        mDefaultTimeoutMs(timeoutms),
+        mMaxParallel(parallel < 1 ? 1 : parallel)
+{
+}
+
+/**
+ * @brief Destructor, terminates the running scripts.
+ */
+cScriptRunner::~cScriptRunner()
+{
+    Close();
+}
+
+/**
+ * @brief Creates the wake up pipe and starts the thread.
+ *
+ * @return false if the pipe could not be created
+ */
+bool cScriptRunner::Open()
+{
+    if (pipe2(mWakeFd, O_NONBLOCK | O_CLOEXEC) < 0) {
+        Esyslog("Can not create script runner pipe: %s", strerror(errno));
+        return false;
+    }
+    Start();
+    return true;
+}
+
+/**
+ * @brief Stops the thread and terminates all scripts.
+ *
+ * Running scripts get SIGTERM and are killed if they do not exit
+ * within KILL_DELAY_MS. Queued scripts are dropped.
+ */
+void cScriptRunner::Close()
+{
+    Cancel(-1);
+    Wakeup();
+    Cancel(3);
+
+    cMutexLock lock(&mMutex);
+    if (!mPending.empty()) {
+        Isyslog("Dropping %d queued scripts", (int)mPending.size());
+        mPending.clear();
+    }
+    for (cJob &job : mRunning) {
+        kill(-job.mPid, SIGTERM);
+    }
+    cTimeMs t(KILL_DELAY_MS);
+    while (!mRunning.empty()) {
+        for (auto i = mRunning.begin(); i != mRunning.end();) {
+            if (waitpid(i->mPid, nullptr, WNOHANG) != 0) {
+                if (i->mOut >= 0) close(i->mOut);
+                if (i->mErr >= 0) close(i->mErr);
+                if (i->mDone != nullptr) {
+                    i->mDone->Signal();
+                }
+                i = mRunning.erase(i);
+            }
+            else if (t.TimedOut()) {
+                Esyslog("Killing script %d: %s", i->mPid, i->mExec.c_str());
+                kill(-i->mPid, SIGKILL);
+                i++;
+            }
+            else {
+                i++;
+            }
+        }
+        if (!mRunning.empty()) {
+            cCondWait::SleepMs(50);
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        if (mWakeFd[i] >= 0) {
+            close(mWakeFd[i]);
+            mWakeFd[i] = -1;
+        }
+    }
+}
+
+/**
+ * @brief Wakes up the thread, e.g. after a new script was started.
+ */
+void cScriptRunner::Wakeup()
+{
+    if (mWakeFd[1] >= 0) {
+        // A full pipe already wakes up the thread
+        (void)write(mWakeFd[1], "x", 1);
+    }
+}
+
+/**
+ * @brief Forks the script of a job.
+ *
+ * stdout and stderr of the script are connected to pipes, stdin is
+ * /dev/null. The argument and environment arrays are prepared before the
+ * fork, the child only calls async-signal-safe functions.
+ *
+ * @param job The job to start
+ * @return false if the script could not be started
+ */
+bool cScriptRunner::Spawn(cJob &job)
+{
+    int out[2];
+    int err[2];
+
+    vector<char *> envp;
+    for (string &e : job.mEnv) {
+        envp.push_back(&e[0]);
+    }
+    envp.push_back(nullptr);
+
+    if (pipe2(out, O_CLOEXEC) < 0) {
+        Esyslog("Can not create pipe: %s", strerror(errno));
+        return false;
+    }
+    if (pipe2(err, O_CLOEXEC) < 0) {
+        Esyslog("Can not create pipe: %s", strerror(errno));
+        close(out[0]);
+        close(out[1]);
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        Esyslog("fork failed: %s", strerror(errno));
+        close(out[0]);
+        close(out[1]);
+        close(err[0]);
+        close(err[1]);
+        return false;
+    }
+    else if (pid == 0) {
+        cThreadScheduling::ResetInChild();
+        setsid();
+        int null = open("/dev/null", O_RDONLY);
+        if (null >= 0) {
+            dup2(null, STDIN_FILENO);
+        }
+        dup2(out[1], STDOUT_FILENO);
+        dup2(err[1], STDERR_FILENO);
+        // Close all file descriptors >= 4 to prevent leaking to child process
+#ifdef HAVE_CLOSE_RANGE
+        close_range(4, UINT_MAX, CLOSE_RANGE_UNSHARE);
+#else
+        // Fallback for older glibc (< 2.34) / Linux (< 5.9)
+        int maxfd = sysconf(_SC_OPEN_MAX);
+        if (maxfd < 0) maxfd = 1024;
+        for (int fd = 4; fd < maxfd; fd++) {
+            close(fd);
+        }
+#endif
+        execle("/bin/sh", "sh", "-c", job.mExec.c_str(), nullptr,
+               envp.data());
+        static const char msg[] = "exec /bin/sh failed\n";
+        (void)write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        _exit(127);
+    }
+
+    close(out[1]);
+    close(err[1]);
+    fcntl(out[0], F_SETFL, O_NONBLOCK);
+    fcntl(err[0], F_SETFL, O_NONBLOCK);
+    job.mPid = pid;
+    job.mOut = out[0];
+    job.mErr = err[0];
+    job.mStartMs = cTimeMs::Now();
+    if (job.mTimeoutMs == 0) {
+        job.mTimeoutMs = mDefaultTimeoutMs;
+    }
+    CEC_PROBE2(script_spawn, pid, job.mExec.c_str());
+    Dsyslog("Script %d started: %s", pid, job.mExec.c_str());
+    return true;
+}
+
+/**
+ * @brief Starts a script immediately, bypassing the parallel limit.
+ *
+ * @param exec Shell command
+ * @param env Environment of the script, moved into the job
+ * @param timeoutms Timeout in ms, 0 = default timeout
+ * @param done Signaled when the script ended
+ * @return Process id of the script or -1 on error
+ */
+pid_t cScriptRunner::Run(const string &exec, vector<string> &env,
+                         int timeoutms, cCondWait *done)
+{
+    cJob job;
+    job.mExec = exec;
+    job.mEnv.swap(env);
+    job.mTimeoutMs = timeoutms;
+    job.mDone = done;
+    if (!Spawn(job)) {
+        return -1;
+    }
+    pid_t pid = job.mPid;
+    {
+        cMutexLock lock(&mMutex);
+        mStarted++;
+        mRunning.push_back(std::move(job));
+    }
+    Wakeup();
+    return pid;
+}
+
+/**
+ * @brief Queues a script, it is started as soon as less than
+ *        mMaxParallel scripts are running.
+ *
+ * @param exec Shell command
+ * @param env Environment of the script, moved into the job
+ * @param timeoutms Timeout in ms, 0 = default timeout
+ */
+void cScriptRunner::Queue(const string &exec, vector<string> &env,
+                          int timeoutms)
+{
+    cJob job;
+    job.mExec = exec;
+    job.mEnv.swap(env);
+    job.mTimeoutMs = timeoutms;
+    {
+        cMutexLock lock(&mMutex);
+        mPending.push_back(std::move(job));
+    }
+    Wakeup();
+}
+
+/**
+ * @brief Checks if a script started by Run() is still running.
+ *
+ * @param pid Process id of the script
+ * @return true if the script has not been reaped yet
+ */
+bool cScriptRunner::IsRunning(pid_t pid)
+{
+    cMutexLock lock(&mMutex);
+    for (const cJob &job : mRunning) {
+        if (job.mPid == pid) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Reads the available output of a script and logs complete lines.
+ *
+ * @param job The job
+ * @param fd Read end of the pipe, closed and set to -1 on end of file
+ * @param line Buffer for an incomplete line
+ * @param err true for stderr
+ */
+void cScriptRunner::ReadOutput(cJob &job, int &fd, string &line, bool err)
+{
+    char buf[MAX_LINE];
+    ssize_t len;
+    auto log = [&job, err](const string &text) {
+        if (err) {
+            Esyslog("Script %d: %s", job.mPid, text.c_str());
+        }
+        else {
+            Isyslog("Script %d: %s", job.mPid, text.c_str());
+        }
+    };
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        line.append(buf, len);
+        for (;;) {
+            size_t pos = line.find('\n');
+            size_t skip = 1;
+            if (pos == string::npos) {
+                if (line.size() < MAX_LINE) {
+                    break;
+                }
+                // Split overlong lines
+                pos = MAX_LINE;
+                skip = 0;
+            }
+            log(line.substr(0, pos));
+            line.erase(0, pos + skip);
+        }
+    }
+    if ((len == 0) || ((len < 0) && (errno != EAGAIN) && (errno != EINTR))) {
+        if (!line.empty()) {
+            log(line);
+            line.clear();
+        }
+        close(fd);
+        fd = -1;
+    }
+}
+
+/**
+ * @brief Reaps finished scripts, handles timeouts and starts queued scripts.
+ *
+ * mMutex must be locked.
+ */
+void cScriptRunner::Supervise()
+{
+    uint64_t now = cTimeMs::Now();
+
+    for (auto i = mRunning.begin(); i != mRunning.end();) {
+        cJob &job = *i;
+        int status = 0;
+        if (waitpid(job.mPid, &status, WNOHANG) == job.mPid) {
+            // Log the remaining output
+            if (job.mOut >= 0) {
+                ReadOutput(job, job.mOut, job.mOutLine, false);
+            }
+            if (job.mErr >= 0) {
+                ReadOutput(job, job.mErr, job.mErrLine, true);
+            }
+            // A background process of the script may still hold the pipes
+            if (job.mOut >= 0) close(job.mOut);
+            if (job.mErr >= 0) close(job.mErr);
+
+            uint64_t ms = now - job.mStartMs;
+            mTotalMs += ms;
+            cMetrics::Inc(cMetrics::SCRIPTS);
+            cMetrics::Inc(cMetrics::SCRIPT_MS, ms);
+            if (ms > mMaxMs) {
+                mMaxMs = ms;
+            }
+            cScriptStats &stats = mScriptStats[job.mExec];
+            stats.mCount++;
+            stats.mTotalMs += ms;
+            if (ms > stats.mMaxMs) {
+                stats.mMaxMs = ms;
+            }
+            if (WIFEXITED(status)) {
+                mLastExit = WEXITSTATUS(status);
+                stats.mLastExit = mLastExit;
+                stats.mLastSignal = 0;
+                Dsyslog("Script %d exit with %d after %d ms", job.mPid,
+                        mLastExit, (int)ms);
+            }
+            else {
+                mLastExit = 128 + WTERMSIG(status);
+                stats.mLastExit = mLastExit;
+                stats.mLastSignal = WTERMSIG(status);
+                Isyslog("Script %d terminated by signal %d after %d ms",
+                        job.mPid, WTERMSIG(status), (int)ms);
+            }
+            CEC_PROBE3(script_exit, job.mPid, mLastExit, ms);
+            // The script gets its own lane, named by the process id
+            cTracer::Complete("script", "script", job.mStartMs * 1000,
+                              ms * 1000, mLastExit, job.mPid);
+            if (mLastExit != 0) {
+                mFailed++;
+                cMetrics::Inc(cMetrics::SCRIPTS_FAILED);
+            }
+            if (job.mDone != nullptr) {
+                job.mDone->Signal();
+            }
+            i = mRunning.erase(i);
+            continue;
+        }
+        if ((job.mTimeoutMs > 0) && (job.mTermMs == 0) &&
+            ((now - job.mStartMs) > (uint64_t)job.mTimeoutMs)) {
+            Esyslog("Script %d timed out after %d ms: %s", job.mPid,
+                    job.mTimeoutMs, job.mExec.c_str());
+            kill(-job.mPid, SIGTERM);
+            job.mTermMs = now;
+            mTimedOut++;
+            cMetrics::Inc(cMetrics::SCRIPTS_TIMEDOUT);
+        }
+        else if ((job.mTermMs != 0) && !job.mKilled &&
+                 ((now - job.mTermMs) > KILL_DELAY_MS)) {
+            Esyslog("Killing script %d", job.mPid);
+            kill(-job.mPid, SIGKILL);
+            job.mKilled = true;
+            mKilledCount++;
+        }
+        i++;
+    }
+
+    while (!mPending.empty() && ((int)mRunning.size() < mMaxParallel)) {
+        cJob job = std::move(mPending.front());
+        mPending.pop_front();
+        if (Spawn(job)) {
+            mStarted++;
+            mRunning.push_back(std::move(job));
+        }
+    }
+}
+
+/**
+ * @brief Main loop of the script runner thread.
+ *
+ * Waits for output of the scripts. The poll timeout limits the delay for
+ * reaping scripts and for detecting timeouts.
+ */
+void cScriptRunner::Action()
+{
+    Dsyslog("Script runner thread started");
+    cTracer::ThreadName("CEC script runner");
+    while (Running()) {
+        vector<struct pollfd> fds(1);
+        fds[0].fd = mWakeFd[0];
+        fds[0].events = POLLIN;
+        {
+            cMutexLock lock(&mMutex);
+            for (const cJob &job : mRunning) {
+                for (int fd : {job.mOut, job.mErr}) {
+                    if (fd >= 0) {
+                        struct pollfd p;
+                        p.fd = fd;
+                        p.events = POLLIN;
+                        p.revents = 0;
+                        fds.push_back(p);
+                    }
+                }
+            }
+        }
+        if ((poll(fds.data(), fds.size(), 100) < 0) && (errno != EINTR)) {
+            Esyslog("Script runner poll failed: %s", strerror(errno));
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            char buf[64];
+            while (read(mWakeFd[0], buf, sizeof(buf)) > 0) {
+            }
+        }
+
+        cMutexLock lock(&mMutex);
+        for (cJob &job : mRunning) {
+            if (job.mOut >= 0) {
+                ReadOutput(job, job.mOut, job.mOutLine, false);
+            }
+            if (job.mErr >= 0) {
+                ReadOutput(job, job.mErr, job.mErrLine, true);
+            }
+        }
+        Supervise();
+    }
+    Dsyslog("Script runner thread stopped");
+}
+
+/**
+ * @brief Gets the statistics of the scripts for STAT.
+ *
+ * The totals of the pool are followed by the statistics of each shell
+ * command: number of runs, average and maximum wall time and the exit
+ * status or signal of the last run.
+ *
+ * @return Statistics text
+ */
+cString cScriptRunner::GetStatistics()
+{
+    cMutexLock lock(&mMutex);
+    unsigned finished = mStarted - mRunning.size();
+    int avg = (finished > 0) ? (int)(mTotalMs / finished) : 0;
+
+    cString s = cString::sprintf("Scripts\n  Started %u\n  Running %d\n  Queued %d\n"
+                                 "  Failed %u\n  Timed out %u\n  Killed %u\n"
+                                 "  Wall time avg %d ms max %d ms\n  Last exit %d",
+                                 mStarted, (int)mRunning.size(), (int)mPending.size(),
+                                 mFailed, mTimedOut, mKilledCount,
+                                 avg, (int)mMaxMs, mLastExit);
+    for (const auto &i : mScriptStats) {
+        const cScriptStats &stats = i.second;
+        cString last = (stats.mLastSignal != 0) ?
+                cString::sprintf("signal %d", stats.mLastSignal) :
+                cString::sprintf("exit %d", stats.mLastExit);
+        s = cString::sprintf("%s\n  %s\n    Runs %u avg %d ms max %d ms last %s",
+                             *s, i.first.c_str(), stats.mCount,
+                             (int)(stats.mTotalMs / stats.mCount),
+                             (int)stats.mMaxMs, *last);
+    }
+    return s;
+}
+
+} // namespace cecplugin
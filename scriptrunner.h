@@ -0,0 +1,174 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the supervision of scripts started by <exec>.
+ */
+
+#ifndef SCRIPTRUNNER_H_
+#define SCRIPTRUNNER_H_
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cecplugin {
+
+/**
+ * @class cScriptRunner
+ * @brief Starts and supervises the scripts of <exec> commands.
+ *
+ * All scripts are started in their own process group. The thread of the
+ * runner
+ * - logs stdout and stderr of the scripts line by line,
+ * - sends SIGTERM to the process group if the timeout expired and SIGKILL
+ *   if the script is still running KILL_DELAY_MS later,
+ * - reaps the scripts and collects statistics,
+ * - starts queued asynchronous scripts, at most mMaxParallel scripts run
+ *   at the same time.
+ *
+ * Synchronous scripts (the default) are started immediately, as the
+ * worker thread waits for them anyway.
+ */
+class cScriptRunner : public cThread {
+private:
+    static constexpr const int KILL_DELAY_MS = 2000;  ///< SIGTERM to SIGKILL
+    static constexpr const size_t MAX_LINE = 512;     ///< Longest logged line
+
+    /** @brief A queued or running script. */
+    class cJob {
+    public:
+        std::string mExec;              ///< Shell command
+        std::vector<std::string> mEnv;  ///< Environment of the script
+        int mTimeoutMs = 0;             ///< Timeout, 0 = none
+        cCondWait *mDone = nullptr;     ///< Signaled when the script ended
+        pid_t mPid = -1;                ///< Process id
+        int mOut = -1;                  ///< Read end of the stdout pipe
+        int mErr = -1;                  ///< Read end of the stderr pipe
+        std::string mOutLine;           ///< Incomplete stdout line
+        std::string mErrLine;           ///< Incomplete stderr line
+        uint64_t mStartMs = 0;          ///< Start time
+        uint64_t mTermMs = 0;           ///< Time SIGTERM was sent, 0 = not sent
+        bool mKilled = false;           ///< SIGKILL was sent
+    };
+
+    /** @brief Statistics of one script command. */
+    class cScriptStats {
+    public:
+        unsigned mCount = 0;            ///< Number of finished runs
+        uint64_t mTotalMs = 0;          ///< Sum of the wall times
+        uint64_t mMaxMs = 0;            ///< Longest wall time
+        int mLastExit = 0;              ///< Exit status of the last run
+        int mLastSignal = 0;            ///< Signal of the last run, 0 = exited
+    };
+
+    int mDefaultTimeoutMs;              ///< Timeout if <exec> has none
+    int mMaxParallel;                   ///< Maximum running scripts
+    int mWakeFd[2] = {-1, -1};          ///< Pipe to wake up the thread
+    cMutex mMutex;                      ///< Protects jobs and statistics
+    std::list<cJob> mRunning;           ///< Running scripts
+    std::list<cJob> mPending;           ///< Queued asynchronous scripts
+
+    unsigned mStarted = 0;              ///< Number of started scripts
+    unsigned mFailed = 0;               ///< Scripts with exit status != 0
+    unsigned mTimedOut = 0;             ///< Scripts terminated by timeout
+    unsigned mKilledCount = 0;          ///< Scripts killed by SIGKILL
+    uint64_t mTotalMs = 0;              ///< Sum of the wall times
+    uint64_t mMaxMs = 0;                ///< Longest wall time
+    int mLastExit = 0;                  ///< Exit status of the last script
+    std::map<std::string, cScriptStats> mScriptStats; ///< Statistics per shell command
+
+    /** @brief Main thread loop. */
+    void Action();
+
+    /**
+     * @brief Forks the script of a job.
+     * @param job The job, mPid and the pipes are set.
+     * @return false if the script could not be started.
+     */
+    bool Spawn(cJob &job);
+
+    /**
+     * @brief Reads and logs the available output of a pipe.
+     * @param job The job.
+     * @param fd Pipe to read, closed and set to -1 on end of file.
+     * @param line Buffer for incomplete lines.
+     * @param err true for stderr.
+     */
+    void ReadOutput(cJob &job, int &fd, std::string &line, bool err);
+
+    /**
+     * @brief Reaps finished scripts, sends signals on timeout and starts
+     *        queued scripts. mMutex must be locked.
+     */
+    void Supervise();
+
+    /** @brief Wakes up the thread. */
+    void Wakeup();
+
+public:
+    /**
+     * @brief Constructs the runner.
+     * @param timeoutms Default timeout of scripts, 0 = none.
+     * @param parallel Maximum number of scripts running at the same time.
+     */
+    cScriptRunner(int timeoutms, int parallel);
+
+    /** @brief Destructor - terminates running scripts. */
+    ~cScriptRunner();
+
+    /**
+     * @brief Starts the supervision thread.
+     * @return false if the wake up pipe could not be created.
+     */
+    bool Open();
+
+    /** @brief Terminates all scripts and stops the thread. */
+    void Close();
+
+    /**
+     * @brief Starts a script immediately.
+     * @param exec Shell command.
+     * @param env Environment of the script.
+     * @param timeoutms Timeout, 0 = default timeout.
+     * @param done Signaled when the script ended.
+     * @return Process id or -1 on error.
+     */
+    pid_t Run(const std::string &exec, std::vector<std::string> &env,
+              int timeoutms, cCondWait *done);
+
+    /**
+     * @brief Queues a script for the parallel pool.
+     * @param exec Shell command.
+     * @param env Environment of the script.
+     * @param timeoutms Timeout, 0 = default timeout.
+     */
+    void Queue(const std::string &exec, std::vector<std::string> &env,
+               int timeoutms);
+
+    /**
+     * @brief Checks if a script is still running.
+     * @param pid Process id returned by Run().
+     * @return true if the script has not been reaped yet.
+     */
+    bool IsRunning(pid_t pid);
+
+    /**
+     * @brief Gets the statistics for STAT.
+     * @return Statistics text.
+     */
+    cString GetStatistics();
+};
+
+} // namespace cecplugin
+
+#endif /* SCRIPTRUNNER_H_ */
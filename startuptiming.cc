@@ -0,0 +1,89 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the timing of the startup phases.
+ */
+
+#include <stdio.h>
+
+#include "startuptiming.h"
+
+namespace cecplugin {
+
+uint64_t cStartupTiming::sOrigin = 0;
+
+const char *const cStartupTiming::sNames[PHASE_MAX] = {
+    "Parse", "RTCWakeup", "Construct", "StartupDelay", "LibCecInitialise",
+    "InitVideoStandalone", "DetectAdapters", "Open", "SetPhysicalAddress",
+    "Devices", "OnStart"
+};
+
+/**
+ * @brief Gets the recorded phases for STAT.
+ *
+ * Each line shows the begin of the phase and its duration in ms. Phases
+ * not completed yet are marked as running.
+ *
+ * @return One line per recorded phase
+ */
+cString cStartupTiming::Describe() const
+{
+    cString s = "";
+    for (int i = 0; i < PHASE_MAX; i++) {
+        uint64_t begin = mBegin[i];
+        uint64_t end = mEnd[i];
+        if (begin == 0) {
+            continue;
+        }
+        cString line;
+        if (end < begin) {
+            line = cString::sprintf("    %-20s at %8.1f ms running", sNames[i],
+                                    (begin - sOrigin) / 1000.0);
+        }
+        else {
+            line = cString::sprintf("    %-20s at %8.1f ms took %8.1f ms",
+                                    sNames[i], (begin - sOrigin) / 1000.0,
+                                    (end - begin) / 1000.0);
+        }
+        s = cString::sprintf("%s%s%s", *s, (**s == '\0') ? "" : "\n", *line);
+    }
+    return s;
+}
+
+/**
+ * @brief Gets the duration of the completed phases for the log.
+ *
+ * @return Phase names and durations in ms, followed by the end of the
+ *         last phase relative to the origin
+ */
+std::string cStartupTiming::Summary() const
+{
+    std::string s;
+    char buf[64];
+    uint64_t last = 0;
+    for (int i = 0; i < PHASE_MAX; i++) {
+        uint64_t begin = mBegin[i];
+        uint64_t end = mEnd[i];
+        if ((begin == 0) || (end < begin)) {
+            continue;
+        }
+        snprintf(buf, sizeof(buf), "%s%s %.1f", s.empty() ? "" : " ",
+                 sNames[i], (end - begin) / 1000.0);
+        s += buf;
+        if (end > last) {
+            last = end;
+        }
+    }
+    if (last > sOrigin) {
+        snprintf(buf, sizeof(buf), " (done at %.1f)", (last - sOrigin) / 1000.0);
+        s += buf;
+    }
+    return s;
+}
+
+} // namespace cecplugin
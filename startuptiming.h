@@ -0,0 +1,104 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the timing of the startup phases.
+ */
+
+#ifndef STARTUPTIMING_H_
+#define STARTUPTIMING_H_
+
+#include <vdr/tools.h>
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+#include "metrics.h"
+
+namespace cecplugin {
+
+/**
+ * @class cStartupTiming
+ * @brief Monotonic begin and end time of the startup phases.
+ *
+ * The plugin records the phases of Initialize(), every cCECRemote the
+ * phases of its first connect up to the completion of <onstart>. The
+ * times are relative to the start of cPluginCecremote::Initialize().
+ * After Finish() the phases are frozen, so reconnects do not overwrite
+ * them.
+ */
+class cStartupTiming {
+public:
+    /** @brief Startup phases. */
+    typedef enum {
+        PARSE = 0,     ///< cConfigFileParser::Parse
+        RTCWAKEUP,     ///< rtcwakeup::check
+        CONSTRUCT,     ///< Construction of the cCECRemote
+        STARTUPDELAY,  ///< <startupdelay>
+        LIBCECINIT,    ///< LibCecInitialise
+        INITVIDEO,     ///< InitVideoStandalone
+        DETECT,        ///< DetectAdapters
+        OPEN,          ///< Open
+        PHYSADDR,      ///< SetPhysicalAddress
+        DEVICES,       ///< Enumeration of the active devices
+        ONSTART,       ///< Queueing to completion of <onstart>
+        PHASE_MAX
+    } ePhase;
+
+    /** @brief Sets the origin of all times to now. */
+    static void SetOrigin() {sOrigin = cMetrics::NowUs();}
+
+    /**
+     * @brief Marks the begin of a phase.
+     * @param phase The phase.
+     */
+    void Begin(ePhase phase) {
+        if (!mFinished) {
+            mBegin[phase] = cMetrics::NowUs();
+        }
+    }
+
+    /**
+     * @brief Marks the end of a phase.
+     * @param phase The phase.
+     */
+    void End(ePhase phase) {
+        if (!mFinished) {
+            mEnd[phase] = cMetrics::NowUs();
+        }
+    }
+
+    /** @brief Freezes the phases. */
+    void Finish() {mFinished = true;}
+
+    /** @brief Checks if the phases are frozen. */
+    bool IsFinished() const {return mFinished;}
+
+    /**
+     * @brief Gets the recorded phases for STAT.
+     * @return One line per recorded phase.
+     */
+    cString Describe() const;
+
+    /**
+     * @brief Gets the duration of the recorded phases for the log.
+     * @return Phase names and durations in ms.
+     */
+    std::string Summary() const;
+
+private:
+    static uint64_t sOrigin;                        ///< Start of Initialize()
+    static const char *const sNames[PHASE_MAX];     ///< Names of the phases
+
+    std::atomic<uint64_t> mBegin[PHASE_MAX] = {};   ///< Begin, 0 = not recorded
+    std::atomic<uint64_t> mEnd[PHASE_MAX] = {};     ///< End, 0 = not completed
+    std::atomic<bool> mFinished{false};             ///< Phases are frozen
+};
+
+} // namespace cecplugin
+
+#endif /* STARTUPTIMING_H_ */
@@ -9,6 +9,7 @@
  * This class implements the status monitor for channel switch information.
  */
 
+#include <vdr/device.h>
 #include "statusmonitor.h"
 #include "ceclog.h"
 #include "ceccontrol.h"
@@ -47,10 +48,13 @@ void cStatusMonitor::ChannelSwitch(const cDevice *Device, int ChannelNumber,
                 if (mMonitorStatus != RADIO) {
                     // Ignore first switch, this is covered by <onstart>
                     if (mMonitorStatus != UNKNOWN) {
+                        cCECEvent event("switchtoradio");
                         mPlugin->PushCmdQueue(mPlugin->mConfigFileParser.
-                                              mGlobalOptions.mOnSwitchToRadio);
+                                              mGlobalOptions.mOnSwitchToRadio,
+                                              &event);
                     }
                     mMonitorStatus = RADIO;
+                    PublishPlayer("radio");
                 }
             }
             else {
@@ -58,10 +62,13 @@ void cStatusMonitor::ChannelSwitch(const cDevice *Device, int ChannelNumber,
                 if (mMonitorStatus != TV) {
                     // Ignore first switch, this is covered by <onstart>
                     if (mMonitorStatus != UNKNOWN) {
+                        cCECEvent event("switchtotv");
                         mPlugin->PushCmdQueue(mPlugin->mConfigFileParser.
-                                              mGlobalOptions.mOnSwitchToTV);
+                                              mGlobalOptions.mOnSwitchToTV,
+                                              &event);
                     }
                     mMonitorStatus = TV;
+                    PublishPlayer("tv");
                 }
             }
         }
@@ -90,16 +97,35 @@ void cStatusMonitor::Replaying(const cControl *Control, const char *Name,
     if (On) {
         if (mMonitorStatus != REPLAYING) {
             mMonitorStatus = REPLAYING;
-            mPlugin->PushCmdQueue(mPlugin->mConfigFileParser.mGlobalOptions.mOnSwitchToReplay);
+            PublishPlayer("replay");
+            cCECEvent event("switchtoreplay");
+            mPlugin->PushCmdQueue(mPlugin->mConfigFileParser.mGlobalOptions.mOnSwitchToReplay,
+                                  &event);
         }
     }
+    else {
+        PublishPlayer("stop");
+    }
+}
+
+/**
+ * @brief Publishes a player switch to the event subscribers.
+ *
+ * @param name New player state (tv, radio, replay or stop)
+ */
+void cStatusMonitor::PublishPlayer(const char *name)
+{
+    cCECBusEvent event;
+    event.mType = cCECBusEvent::PLAYER;
+    strncpy(event.mName, name, sizeof(event.mName) - 1);
+    mPlugin->PublishEvent(event);
 }
 
 /**
  * @brief Handles VDR volume change events.
  *
- * Forwards volume changes to the configured audio device via CEC,
- * and executes any menu-specific volume handlers if a still
+ * Forwards volume and mute changes to the configured audio device
+ * using the global key map, and executes any menu-specific volume handlers if a still
  * picture player is running.
  *
  * @param Volume Volume value or delta
@@ -125,18 +151,27 @@ void cStatusMonitor::SetVolume(int Volume, bool Absolute)
         return;
     }
 
+    // VDR reports mute as absolute volume 0 and unmute as the restored
+    // absolute volume. Take the mute state from the device, so turning
+    // the volume down to 0 is still a volume change.
+    bool muted = cDevice::PrimaryDevice()->IsMute();
+    if (muted != mMuted) {
+        mMuted = muted;
+        mPlugin->ForwardGlobalKey(kMute);
+        mVolume = newvol;
+        return;
+    }
+
     // No volume change, return
     if (newvol == mVolume)
         return;
 
     // Handle global volume keypresses
     if (newvol > mVolume) {
-        cCmd cmd(CEC_VDRKEYPRESS, (int)kVolUp, &mPlugin->mConfigFileParser.mGlobalOptions.mAudioDevice);
-        mPlugin->PushCmd(cmd);
+        mPlugin->ForwardGlobalKey(kVolUp);
     }
     else {
-        cCmd cmd(CEC_VDRKEYPRESS, (int)kVolDn, &mPlugin->mConfigFileParser.mGlobalOptions.mAudioDevice);
-        mPlugin->PushCmd(cmd);
+        mPlugin->ForwardGlobalKey(kVolDn);
     }
 
     cMutexLock lock;
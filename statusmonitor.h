@@ -80,6 +80,12 @@ protected:
      */
     virtual void SetVolume(int Volume, bool Absolute);
 
+    /**
+     * @brief Publishes a player switch to the event subscribers.
+     * @param name New player state (tv, radio, replay or stop).
+     */
+    void PublishPlayer(const char *name);
+
     // Unused VDR status callbacks
     virtual void SetAudioTrack(int Index, const char * const *Tracks) {};
     virtual void SetAudioChannel(int AudioChannel) {};
@@ -100,6 +106,7 @@ protected:
     MonitorStatus mMonitorStatus = UNKNOWN;  ///< Current playback state
     cPluginCecremote *mPlugin = nullptr;     ///< Parent plugin instance
     int mVolume = 0;                         ///< Last known volume level
+    bool mMuted = false;                     ///< Audio is muted
 public:
     /** @brief Deleted default constructor - plugin pointer is required. */
     cStatusMonitor() = delete;
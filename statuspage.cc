@@ -0,0 +1,136 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the shared memory status page.
+ */
+
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "statuspage.h"
+#include "cecremoteplugin.h"
+#include "ceclog.h"
+
+namespace cecplugin {
+
+/**
+ * @brief Constructs the status page.
+ *
+ * @param plugin Pointer to the parent plugin instance
+ * @param path Path of the shared memory file
+ */
+cStatusPage::cStatusPage(cPluginCecremote *plugin, const std::string &path) :
+        cThread("CEC status page"),
+        mPlugin(plugin),
+        mPath(path)
+{
+}
+
+/**
+ * @brief Destructor, stops the thread, unmaps and removes the file.
+ */
+cStatusPage::~cStatusPage()
+{
+    Cancel(-1);
+    mChanged.Signal();
+    Cancel(3);
+    if (mPage != nullptr) {
+        munmap(mPage, sizeof(cCECStatusPageData));
+        mPage = nullptr;
+        unlink(mPath.c_str());
+    }
+}
+
+/**
+ * @brief Creates and maps the shared memory file and starts the thread.
+ *
+ * @return false if the file could not be created
+ */
+bool cStatusPage::Open()
+{
+    int fd = open(mPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        Esyslog("Can not create status page %s: %s", mPath.c_str(),
+                strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, sizeof(cCECStatusPageData)) < 0) {
+        Esyslog("Can not resize status page %s: %s", mPath.c_str(),
+                strerror(errno));
+        close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, sizeof(cCECStatusPageData),
+                   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        Esyslog("Can not map status page %s: %s", mPath.c_str(),
+                strerror(errno));
+        return false;
+    }
+    mPage = (cCECStatusPageData *)p;
+    memset(mPage, 0, sizeof(cCECStatusPageData));
+    mPage->mMagic = cCECStatusPageData::MAGIC;
+    mPage->mVersion = cCECStatusPageData::VERSION;
+    Update();
+    Isyslog("Status page %s", mPath.c_str());
+    Start();
+    return true;
+}
+
+/**
+ * @brief Thread loop, rewrites the page after status changes.
+ *
+ * Changes are coalesced, so a burst of CEC traffic results in one update.
+ */
+void cStatusPage::Action()
+{
+    while (Running()) {
+        mChanged.Wait(UPDATE_MAX_MS);
+        if (!Running()) {
+            break;
+        }
+        Update();
+        cCondWait::SleepMs(UPDATE_MIN_MS);
+    }
+}
+
+/**
+ * @brief Writes the current status into the page.
+ *
+ * The data is collected first, so the sequence lock is held only for
+ * the copy into the shared memory.
+ */
+void cStatusPage::Update()
+{
+    cCECStatusPageData data;
+    struct timeval tv;
+
+    memset(&data, 0, sizeof(data));
+    gettimeofday(&tv, nullptr);
+    data.mUpdateTimeMs = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    while ((data.mAdapterCount < cCECStatusPageData::MAX_ADAPTERS) &&
+           mPlugin->GetAdapterStatus(data.mAdapterCount,
+                                     data.mAdapters[data.mAdapterCount])) {
+        data.mAdapterCount++;
+    }
+
+    uint32_t seq = mPage->mSequence;
+    __atomic_store_n(&mPage->mSequence, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    mPage->mAdapterCount = data.mAdapterCount;
+    mPage->mUpdateTimeMs = data.mUpdateTimeMs;
+    memcpy(mPage->mAdapters, data.mAdapters, sizeof(data.mAdapters));
+    __atomic_store_n(&mPage->mSequence, seq + 2, __ATOMIC_RELEASE);
+}
+
+} // namespace cecplugin
@@ -0,0 +1,115 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the shared memory status page.
+ */
+
+#ifndef STATUSPAGE_H_
+#define STATUSPAGE_H_
+
+#include <vdr/thread.h>
+#include <stdint.h>
+#include <string>
+
+namespace cecplugin {
+
+class cPluginCecremote;
+
+/**
+ * @brief Status of one adapter in the shared memory status page.
+ *
+ * All fields have a fixed size, so the layout can be used by programs
+ * written in C or other languages.
+ */
+struct cCECStatusPageAdapter {
+    char mId[32];                 ///< Adapter id, zero terminated
+    uint8_t mConnected;           ///< 1 if connected to the adapter
+    int8_t mActiveSource;         ///< Logical address of active source, -1 unknown
+    uint16_t mActiveSourcePhysical; ///< Physical address of active source
+    int32_t mWorkQueue;           ///< Pending commands in the worker queue
+    int32_t mExecQueue;           ///< Pending commands in the exec queue
+    uint8_t mPower[16];           ///< cec_power_status per logical address
+    uint16_t mPhysicalAddress[16]; ///< Physical address per logical address, 0xFFFF unknown
+};
+
+/**
+ * @brief Layout of the shared memory status page.
+ *
+ * The page is protected by a sequence lock. A reader copies the page
+ * and retries if mSequence was odd or changed during the copy:
+ * @code
+ * do {
+ *     seq = __atomic_load_n(&page->mSequence, __ATOMIC_ACQUIRE);
+ *     memcpy(&copy, page, sizeof(copy));
+ *     __atomic_thread_fence(__ATOMIC_ACQUIRE);
+ * } while ((seq & 1) || (seq != __atomic_load_n(&page->mSequence, __ATOMIC_RELAXED)));
+ * @endcode
+ */
+struct cCECStatusPageData {
+    static constexpr const uint32_t MAGIC = 0x43454352;  ///< "CECR"
+    static constexpr const uint32_t VERSION = 1;         ///< Layout version
+    static constexpr const int MAX_ADAPTERS = 4;
+
+    uint32_t mMagic;              ///< MAGIC
+    uint32_t mVersion;            ///< VERSION, readers must check it
+    uint32_t mSequence;           ///< Sequence lock, odd while writing
+    uint32_t mAdapterCount;       ///< Valid entries in mAdapters
+    uint64_t mUpdateTimeMs;       ///< Time of the last update (ms since epoch)
+    cCECStatusPageAdapter mAdapters[MAX_ADAPTERS]; ///< Status per adapter
+};
+
+/**
+ * @class cStatusPage
+ * @brief Publishes the plugin status in a shared memory file.
+ *
+ * External programs can map the file read only and get a consistent
+ * view of connection state, queue depths, power states and active source
+ * without SVDRP requests and without traffic on the CEC bus.
+ * The page is rewritten by its own thread whenever the status changed,
+ * at most every UPDATE_MIN_MS and at least every UPDATE_MAX_MS.
+ */
+class cStatusPage : public cThread {
+private:
+    static constexpr const int UPDATE_MIN_MS = 100;   ///< Coalesce updates
+    static constexpr const int UPDATE_MAX_MS = 1000;  ///< Refresh queue depths
+
+    cPluginCecremote *mPlugin;            ///< Parent plugin instance
+    std::string mPath;                    ///< Path of the shared memory file
+    cCECStatusPageData *mPage = nullptr;  ///< Mapped page
+    cCondWait mChanged;                   ///< Signaled on status changes
+
+    /** @brief Thread loop, writes the page on changes. */
+    void Action();
+
+    /** @brief Writes the current status into the page. */
+    void Update();
+
+public:
+    /**
+     * @brief Constructs the status page.
+     * @param plugin Pointer to the parent plugin instance.
+     * @param path Path of the file, e.g. /dev/shm/vdr-cecremote.
+     */
+    cStatusPage(cPluginCecremote *plugin, const std::string &path);
+
+    /** @brief Destructor - stops the thread and removes the file. */
+    ~cStatusPage();
+
+    /**
+     * @brief Creates the file and starts the update thread.
+     * @return false if the file could not be created.
+     */
+    bool Open();
+
+    /** @brief Requests an update of the page, may be called from any thread. */
+    void Trigger() { mChanged.Signal(); }
+};
+
+} // namespace cecplugin
+
+#endif /* STATUSPAGE_H_ */
@@ -0,0 +1,72 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This file implements the libFuzzer/AFL++ entry point for the parser of
+ * the configuration file. Build it with "make fuzz", see README.md.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdexcept>
+#include "configfileparser.h"
+#include "keymaps.h"
+#include "ceclog.h"
+
+using namespace cecplugin;
+
+/**
+ * @brief Parses one input and translates all keys with the parsed maps.
+ *
+ * A fresh parser and fresh key maps are used for every input, so the
+ * memory of one input is released before the next one.
+ *
+ * @param data XML text
+ * @param size Size of the XML text
+ * @return Always 0
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    // Rejected inputs are the normal case, do not flood the syslog
+    cecplugin_loglevel = 0;
+
+    cConfigFileParser parser;
+    cKeyMaps keymaps;
+    if (!parser.Parse((const char *)data, size, keymaps, "<fuzz>")) {
+        return 0;
+    }
+    const cCECGlobalOptions &opts = parser.mGlobalOptions;
+    try {
+        keymaps.SetActiveKeymaps(opts.mVDRKeymap, opts.mCECKeymap,
+                                 opts.mGLOBALKeymap);
+    }
+    catch (const std::out_of_range &e) {
+        // Unknown keymap ids are reported by the plugin at startup
+    }
+    for (const auto &i : opts.mInitiatorKeymaps) {
+        try {
+            keymaps.SetInitiatorKeymap(i.first, i.second);
+        }
+        catch (const std::out_of_range &e) {
+        }
+    }
+
+    eKeys keys[cKeyMaps::MAXKEYS];
+    for (int initiator = CECDEVICE_TV; initiator <= CECDEVICE_BROADCAST;
+         initiator++) {
+        for (int code = 0; code <= CEC_USER_CONTROL_CODE_MAX; code++) {
+            keymaps.CECtoVDRKey((cec_user_control_code)code,
+                                (cec_logical_address)initiator, keys);
+        }
+    }
+    for (int key = 0; key < kNone; key++) {
+        keymaps.VDRtoCECKey((eKeys)key);
+        keymaps.GlobalVDRtoCECKey((eKeys)key);
+    }
+    keymaps.ListKeymaps();
+    return 0;
+}
@@ -0,0 +1,69 @@
+#
+# Generates cMockAdapterBase from the ICECAdapter interface of the installed
+# cec.h. Every pure virtual method returns a value-initialized result, so the
+# mock adapter only overrides the methods it simulates and follows new
+# methods of libCEC without changes.
+#
+# Usage: awk -f mkmockbase.awk /usr/include/libcec/cec.h > mockbase.h
+#
+
+BEGIN {
+    print "// Generated by test/mkmockbase.awk, do not edit"
+    print "#ifndef MOCKBASE_H_"
+    print "#define MOCKBASE_H_"
+    print ""
+    print "#include <cec.h>"
+    print ""
+    print "using namespace CEC;"
+    print ""
+    print "template<typename T> struct cMockReturn {"
+    print "    static T Value() {return T();}"
+    print "};"
+    print "template<> struct cMockReturn<void> {"
+    print "    static void Value() {}"
+    print "};"
+    print "template<> struct cMockReturn<const char *> {"
+    print "    static const char *Value() {return \"\";}"
+    print "};"
+    print ""
+    print "class cMockAdapterBase : public ICECAdapter {"
+    print "public:"
+    inclass = 0
+    decl = ""
+}
+
+/^[ \t]*class[ \t]+ICECAdapter/ { inclass = 1; next }
+
+inclass && /^[ \t]*};/ { inclass = 0; next }
+
+inclass {
+    line = $0
+    sub(/\/\/.*$/, "", line)
+    # Skip doxygen blocks between the declarations
+    if ((decl == "") && (line !~ /^[ \t]*virtual[ \t]/)) {
+        next
+    }
+    decl = decl " " line
+    if (decl !~ /;/) {
+        next
+    }
+    if (decl ~ /=[ \t]*0[ \t]*;/) {
+        gsub(/[ \t]+/, " ", decl)
+        sub(/^ *virtual /, "", decl)
+        head = substr(decl, 1, index(decl, "(") - 1)
+        sub(/ +$/, "", head)
+        match(head, /[A-Za-z_][A-Za-z0-9_]*$/)
+        ret = substr(head, 1, RSTART - 1)
+        sub(/ +$/, "", ret)
+        sub(/=[ \t]*0[ \t]*;.*$/, "", decl)
+        sub(/ +$/, "", decl)
+        printf "    %s override {return cMockReturn<%s>::Value();}\n", decl, ret
+    }
+    decl = ""
+}
+
+END {
+    print "};"
+    print ""
+    print "#endif /* MOCKBASE_H_ */"
+}
@@ -0,0 +1,231 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This file implements a mock libCEC with one simulated adapter for the
+ * stress test.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <set>
+
+#include "mockbase.h"
+#include "mockcec.h"
+
+class cMockAdapter;
+
+static std::mutex sMutex;                 ///< Protects sOpen
+static std::set<cMockAdapter *> sOpen;    ///< Open adapters
+static std::atomic<unsigned> sOpens{0};   ///< Successful Open() calls
+
+/**
+ * @brief Simulates the time a frame needs on the bus.
+ *
+ * MOCKCEC_DELAY_US sets the time in us, default 1000.
+ */
+static void BusDelay()
+{
+    static const int delayUs = []() {
+        const char *s = getenv("MOCKCEC_DELAY_US");
+        return (s != nullptr) ? atoi(s) : 1000;
+    }();
+    if (delayUs > 0) {
+        usleep(delayUs);
+    }
+}
+
+/**
+ * @class cMockAdapter
+ * @brief Simulated adapter with a TV (0) and an audio system (5).
+ *
+ * All transmissions succeed after the bus delay and all devices report
+ * CEC_POWER_STATUS_ON. Methods not simulated here return the defaults of
+ * cMockAdapterBase.
+ */
+class cMockAdapter : public cMockAdapterBase {
+private:
+    ICECCallbacks *mCallbacks;  ///< Callbacks of the plugin
+    void *mParam;               ///< Parameter of the callbacks
+public:
+    explicit cMockAdapter(const libcec_configuration *config) :
+        mCallbacks(config->callbacks),
+        mParam(config->callbackParam) {}
+
+    ~cMockAdapter() {Close();}
+
+    bool Open(const char *strPort, uint32_t iTimeoutMs) override {
+        BusDelay();
+        std::lock_guard<std::mutex> lock(sMutex);
+        sOpen.insert(this);
+        sOpens++;
+        return true;
+    }
+
+    void Close(void) override {
+        std::lock_guard<std::mutex> lock(sMutex);
+        sOpen.erase(this);
+    }
+
+    int8_t DetectAdapters(cec_adapter_descriptor *deviceList,
+                          uint8_t iBufSize, const char *strDevicePath,
+                          bool bQuickScan) override {
+        if (iBufSize < 1) {
+            return 0;
+        }
+        memset(&deviceList[0], 0, sizeof(deviceList[0]));
+        strncpy(deviceList[0].strComPath, "/dev/mockcec",
+                sizeof(deviceList[0].strComPath) - 1);
+        strncpy(deviceList[0].strComName, "MOCK",
+                sizeof(deviceList[0].strComName) - 1);
+        return 1;
+    }
+
+    bool Transmit(const cec_command &data) override {
+        BusDelay();
+        return true;
+    }
+
+    bool PowerOnDevices(cec_logical_address address) override {
+        BusDelay();
+        return true;
+    }
+
+    bool StandbyDevices(cec_logical_address address) override {
+        BusDelay();
+        return true;
+    }
+
+    bool SendKeypress(cec_logical_address iDestination,
+                      cec_user_control_code key, bool bWait) override {
+        BusDelay();
+        return true;
+    }
+
+    bool SendKeyRelease(cec_logical_address iDestination,
+                        bool bWait) override {
+        BusDelay();
+        return true;
+    }
+
+    cec_power_status GetDevicePowerStatus(
+            cec_logical_address iLogicalAddress) override {
+        BusDelay();
+        return CEC_POWER_STATUS_ON;
+    }
+
+    cec_logical_addresses GetActiveDevices(void) override {
+        cec_logical_addresses addr;
+        addr.Clear();
+        addr.Set(CECDEVICE_TV);
+        addr.Set(CECDEVICE_AUDIOSYSTEM);
+        return addr;
+    }
+
+    uint16_t GetDevicePhysicalAddress(
+            cec_logical_address iLogicalAddress) override {
+        return (iLogicalAddress == CECDEVICE_AUDIOSYSTEM) ? 0x1000 : 0x0000;
+    }
+
+    const char *GetLibInfo(void) override {return "mock libCEC";}
+
+    /** @brief Delivers a frame to the plugin. sMutex is locked. */
+    void Command(const cec_command &cmd) {
+        if (mCallbacks->commandReceived != nullptr) {
+            mCallbacks->commandReceived(mParam, &cmd);
+        }
+    }
+
+    /** @brief Delivers a key to the plugin. sMutex is locked. */
+    void KeyPress(const cec_keypress &key) {
+        if (mCallbacks->keyPress != nullptr) {
+            mCallbacks->keyPress(mParam, &key);
+        }
+    }
+
+    /** @brief Delivers an alert to the plugin. sMutex is locked. */
+    void Alert(libcec_alert alert) {
+        libcec_parameter param = {};
+        if (mCallbacks->alert != nullptr) {
+            mCallbacks->alert(mParam, alert, param);
+        }
+    }
+};
+
+/**
+ * @brief Formats a frame to the own address of the plugin.
+ */
+static void FormatFrame(cec_command &cmd, int initiator, int opcode,
+                        const uint8_t *params, int count)
+{
+    cec_command::Format(cmd, (cec_logical_address)initiator,
+                        CECDEVICE_RECORDINGDEVICE1, (cec_opcode)opcode);
+    for (int i = 0; i < count; i++) {
+        cmd.PushBack(params[i]);
+    }
+}
+
+extern "C" {
+
+void *CECInitialise(libcec_configuration *configuration)
+{
+    return static_cast<ICECAdapter *>(new cMockAdapter(configuration));
+}
+
+void CECDestroy(ICECAdapter *instance)
+{
+    delete instance;
+}
+
+int MockCecKeyPress(int initiator, int code)
+{
+    cec_command cmd;
+    uint8_t param = (uint8_t)code;
+    FormatFrame(cmd, initiator, CEC_OPCODE_USER_CONTROL_PRESSED, &param, 1);
+    cec_keypress key;
+    key.keycode = (cec_user_control_code)code;
+    key.duration = 0;
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    for (cMockAdapter *adapter : sOpen) {
+        adapter->Command(cmd);
+        adapter->KeyPress(key);
+    }
+    return (int)sOpen.size();
+}
+
+int MockCecCommand(int initiator, int opcode, const uint8_t *params,
+                   int count)
+{
+    cec_command cmd;
+    FormatFrame(cmd, initiator, opcode, params, count);
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    for (cMockAdapter *adapter : sOpen) {
+        adapter->Command(cmd);
+    }
+    return (int)sOpen.size();
+}
+
+int MockCecAlert(int alert)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    for (cMockAdapter *adapter : sOpen) {
+        adapter->Alert((libcec_alert)alert);
+    }
+    return (int)sOpen.size();
+}
+
+unsigned MockCecOpens(void)
+{
+    return sOpens.load();
+}
+
+} // extern "C"
@@ -0,0 +1,40 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This file defines the control interface of the mock libCEC used by the
+ * stress test.
+ */
+
+#ifndef MOCKCEC_H_
+#define MOCKCEC_H_
+
+#include <stdint.h>
+
+/*
+ * The mock is built as libcec.so.<major>, so the plugin loads it with
+ * LibCecInitialise() instead of the real libCEC. The stress test opens the
+ * same library and looks up these functions. They deliver the callbacks
+ * to every open adapter, like the callback thread of libCEC, and return
+ * the number of adapters reached. A key press is preceded by its
+ * USER_CONTROL_PRESSED frame, as libCEC reports it.
+ */
+extern "C" {
+typedef int (*MockCecKeyPressFn)(int initiator, int code);
+typedef int (*MockCecCommandFn)(int initiator, int opcode,
+                                const uint8_t *params, int count);
+typedef int (*MockCecAlertFn)(int alert);
+typedef unsigned (*MockCecOpensFn)(void);
+
+int MockCecKeyPress(int initiator, int code);
+int MockCecCommand(int initiator, int opcode, const uint8_t *params,
+                   int count);
+int MockCecAlert(int alert);
+unsigned MockCecOpens(void);   ///< Number of successful Open() calls
+}
+
+#endif /* MOCKCEC_H_ */
@@ -0,0 +1,443 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This file implements the stress test of the plugin against the mock
+ * libCEC. Build it with "make stress", see README.md.
+ */
+
+#include <dlfcn.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vdr/device.h>
+#include <vdr/plugin.h>
+#include <vdr/remote.h>
+#include <vdr/status.h>
+#include "cecremoteplugin.h"
+#include "ceccontrol.h"
+#include "metrics.h"
+#include "ceclog.h"
+#include "mockcec.h"
+
+using namespace cecplugin;
+
+/*
+ * The TV (0) sends frames and the audio system (5) sends keys, so the
+ * keys use the <initiatorkeymap> while cCECControl switches the active
+ * keymaps.
+ */
+static const char *sConfig =
+    "<config>\n"
+    "  <ceckeymap id=\"avr\">\n"
+    "    <key code=\"SELECT\"><value>Ok</value></key>\n"
+    "  </ceckeymap>\n"
+    "  <global>\n"
+    "    <rtcdetect>false</rtcdetect>\n"
+    "    <watchdogtimeout>2000</watchdogtimeout>\n"
+    "    <initiatorkeymap initiator=\"5\" cec=\"avr\"/>\n"
+    "    <onstart><poweron>TV</poweron><makeactive/></onstart>\n"
+    "    <onstop><poweroff>TV</poweroff></onstop>\n"
+    "  </global>\n"
+    "  <device id=\"avr\"><logical>5</logical></device>\n"
+    "  <menu name=\"Stress\" address=\"avr\">\n"
+    "    <onstart><poweron>avr</poweron><makeinactive/></onstart>\n"
+    "    <player file=\"/nonexistent.mpg\">\n"
+    "      <keymaps cec=\"default\" vdr=\"default\"/>\n"
+    "      <stop>Back</stop>\n"
+    "    </player>\n"
+    "    <onstop><makeactive/></onstop>\n"
+    "  </menu>\n"
+    "</config>\n";
+
+static const char *MENUNAME = "Stress";
+static const int KEYTIMEOUTMS = 1000;
+
+/**
+ * @class cStressDevice
+ * @brief Primary device without hardware for cStatusMonitor::SetVolume.
+ */
+class cStressDevice : public cDevice {
+public:
+    cStressDevice() {}
+};
+
+/**
+ * @class cLatency
+ * @brief Latencies of one operation, owned by the thread measuring them.
+ */
+class cLatency {
+private:
+    std::vector<uint32_t> mUs;  ///< Measured latencies in us
+    const char *mName;          ///< Name of the operation
+public:
+    unsigned mFailed = 0;       ///< Operations without result
+
+    explicit cLatency(const char *name) : mName(name) {
+        mUs.reserve(1 << 16);
+    }
+
+    void Add(uint64_t us) {mUs.push_back((uint32_t)std::min<uint64_t>(us, UINT32_MAX));}
+
+    /**
+     * @brief Prints the throughput and the latency percentiles.
+     * @param seconds Duration of the test
+     */
+    void Report(double seconds) {
+        std::sort(mUs.begin(), mUs.end());
+        size_t n = mUs.size();
+        auto pct = [&](double p) -> double {
+            if (n == 0) {
+                return 0.0;
+            }
+            size_t i = std::min(n - 1, (size_t)(p * n / 100.0));
+            return mUs[i] / 1000.0;
+        };
+        printf("%-12s %8zu %9.1f/s %8u  %8.3f %8.3f %8.3f %8.3f %8.3f\n",
+               mName, n, n / seconds, mFailed, pct(50), pct(90), pct(99),
+               pct(99.9), (n == 0) ? 0.0 : mUs[n - 1] / 1000.0);
+    }
+};
+
+static MockCecKeyPressFn sKeyPress;
+static MockCecCommandFn sCommand;
+static MockCecAlertFn sAlert;
+static MockCecOpensFn sOpens;
+static std::atomic<bool> sRunning{true};
+
+/**
+ * @brief Loads the mock libCEC and looks up its control functions.
+ *
+ * The plugin loads the library with the same name, so it finds the
+ * already loaded mock.
+ */
+static bool LoadMock()
+{
+    void *lib = dlopen(MOCKCEC_LIB, RTLD_NOW);
+    if (lib == nullptr) {
+        fprintf(stderr, "%s\nRun with LD_LIBRARY_PATH=test/build\n", dlerror());
+        return false;
+    }
+    sKeyPress = (MockCecKeyPressFn)dlsym(lib, "MockCecKeyPress");
+    sCommand = (MockCecCommandFn)dlsym(lib, "MockCecCommand");
+    sAlert = (MockCecAlertFn)dlsym(lib, "MockCecAlert");
+    sOpens = (MockCecOpensFn)dlsym(lib, "MockCecOpens");
+    if ((sKeyPress == nullptr) || (sCommand == nullptr) ||
+        (sAlert == nullptr) || (sOpens == nullptr)) {
+        fprintf(stderr, "%s is not the mock libCEC\n", MOCKCEC_LIB);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Sends SELECT from the audio system and waits for kOk.
+ *
+ * Measures the way of a key through the libCEC callback, the worker
+ * queue and cRemote. Keys sent while the adapter is closed count as
+ * failed, like keys that are not received within KEYTIMEOUTMS.
+ */
+static void KeyThread(cLatency &lat)
+{
+    while (sRunning) {
+        // Drop keys which arrived after their timeout
+        while (cRemote::Get(0) != kNone) {
+        }
+        uint64_t start = cMetrics::NowUs();
+        if (sKeyPress(CECDEVICE_AUDIOSYSTEM, CEC_USER_CONTROL_CODE_SELECT) == 0) {
+            lat.mFailed++;
+            usleep(10000);
+            continue;
+        }
+        eKeys key = cRemote::Get(KEYTIMEOUTMS);
+        if (key == kOk) {
+            lat.Add(cMetrics::NowUs() - start);
+        }
+        else {
+            lat.mFailed++;
+        }
+    }
+}
+
+/**
+ * @brief Floods the bus with frames of the TV and the audio system.
+ *
+ * Measures how long the libCEC callback thread is blocked by
+ * CecCommandCallback.
+ *
+ * @param rate Frames per second
+ */
+static void FrameThread(cLatency &lat, int rate)
+{
+    static const uint8_t powerOn[] = {CEC_POWER_STATUS_ON};
+    static const uint8_t physTV[] = {0x00, 0x00};
+    static const uint8_t routing[] = {0x10, 0x00, 0x00, 0x00};
+    static const struct {
+        int initiator;
+        int opcode;
+        const uint8_t *params;
+        int count;
+    } frames[] = {
+        {CECDEVICE_TV, CEC_OPCODE_REPORT_POWER_STATUS, powerOn, 1},
+        {CECDEVICE_AUDIOSYSTEM, CEC_OPCODE_REPORT_POWER_STATUS, powerOn, 1},
+        {CECDEVICE_TV, CEC_OPCODE_ACTIVE_SOURCE, physTV, 2},
+        {CECDEVICE_TV, CEC_OPCODE_ROUTING_CHANGE, routing, 4},
+        {CECDEVICE_TV, CEC_OPCODE_GIVE_DEVICE_POWER_STATUS, nullptr, 0},
+    };
+    uint64_t intervalUs = 1000000 / std::max(rate, 1);
+    uint64_t next = cMetrics::NowUs();
+    size_t i = 0;
+
+    while (sRunning) {
+        const auto &f = frames[i++ % (sizeof(frames) / sizeof(frames[0]))];
+        uint64_t start = cMetrics::NowUs();
+        if (sCommand(f.initiator, f.opcode, f.params, f.count) == 0) {
+            lat.mFailed++;
+        }
+        else {
+            lat.Add(cMetrics::NowUs() - start);
+        }
+        next += intervalUs;
+        uint64_t now = cMetrics::NowUs();
+        if (next > now) {
+            usleep(next - now);
+        }
+        else {
+            next = now;
+        }
+    }
+}
+
+/**
+ * @brief Reports a lost connection every 500 ms.
+ *
+ * CecAlertCallback reconnects the adapter, so the other threads run into
+ * closed and reopening adapters.
+ */
+static void AlertThread(cLatency &lat)
+{
+    while (sRunning) {
+        usleep(500000);
+        uint64_t start = cMetrics::NowUs();
+        if (sAlert(CEC_ALERT_CONNECTION_LOST) == 0) {
+            lat.mFailed++;
+        }
+        else {
+            lat.Add(cMetrics::NowUs() - start);
+        }
+    }
+}
+
+/**
+ * @brief Runs SVDRP commands like the SVDRP server thread of VDR.
+ *
+ * LSTD and STAT run continuously, DISC and CONN once per second.
+ */
+static void SvdrpThread(cPluginCecremote *plugin, cLatency &lstd,
+                        cLatency &stat, cLatency &conn)
+{
+    uint64_t nextConn = cMetrics::NowUs() + 1000000;
+    while (sRunning) {
+        int reply;
+        uint64_t start = cMetrics::NowUs();
+        plugin->SVDRPCommand("LSTD", nullptr, reply);
+        lstd.Add(cMetrics::NowUs() - start);
+
+        start = cMetrics::NowUs();
+        plugin->SVDRPCommand("STAT", nullptr, reply);
+        stat.Add(cMetrics::NowUs() - start);
+
+        if (cMetrics::NowUs() >= nextConn) {
+            start = cMetrics::NowUs();
+            plugin->SVDRPCommand("DISC", nullptr, reply);
+            plugin->SVDRPCommand("CONN", nullptr, reply);
+            if (reply != 214) {
+                conn.mFailed++;
+            }
+            else {
+                conn.Add(cMetrics::NowUs() - start);
+            }
+            nextConn += 1000000;
+        }
+        usleep(2000);
+    }
+}
+
+/**
+ * @brief Does the work of the VDR main thread.
+ *
+ * Starts and stops the player of the menu, which switches the active
+ * keymaps, and changes the volume and the mute state.
+ */
+static void MainLoop(cPluginCecremote *plugin, cLatency &control,
+                     cLatency &volume, int seconds)
+{
+    cCECMenu menu;
+    if (!plugin->FindMenu(MENUNAME, menu)) {
+        fprintf(stderr, "Menu %s not found\n", MENUNAME);
+        return;
+    }
+    uint64_t end = cMetrics::NowUs() + (uint64_t)seconds * 1000000;
+    int step = 0;
+
+    while (cMetrics::NowUs() < end) {
+        uint64_t start = cMetrics::NowUs();
+        cCECControl *ctl = new cCECControl(menu, plugin);
+        cStatus::MsgReplaying(ctl, MENUNAME, nullptr, true);
+        ctl->ProcessKey(kUp);
+        ctl->ProcessKey(kNone);
+        if (ctl->ProcessKey(kBack) != osEnd) {
+            control.mFailed++;
+        }
+        cStatus::MsgReplaying(ctl, nullptr, nullptr, false);
+        delete ctl;
+        control.Add(cMetrics::NowUs() - start);
+
+        start = cMetrics::NowUs();
+        switch (step++ % 4) {
+        case 0:
+            cDevice::PrimaryDevice()->SetVolume(10);
+            break;
+        case 1:
+            cDevice::PrimaryDevice()->SetVolume(-10);
+            break;
+        default:
+            cDevice::PrimaryDevice()->ToggleMute();
+            break;
+        }
+        volume.Add(cMetrics::NowUs() - start);
+        usleep(20000);
+    }
+}
+
+static char sTmpDir[] = "/tmp/cecstressXXXXXX";
+
+static int RemoveEntry(const char *path, const struct stat *sb, int type,
+                       struct FTW *ftw)
+{
+    return remove(path);
+}
+
+/**
+ * @brief Removes the temporary directory with the configuration and the
+ * files the plugin created in it.
+ */
+static void RemoveTmpDir()
+{
+    nftw(sTmpDir, RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-d seconds] [-r frames per second] [-l loglevel]\n",
+            name);
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = 10;
+    int rate = 2000;
+    int c;
+
+    cecplugin_loglevel = 0;
+    while ((c = getopt(argc, argv, "d:r:l:")) != -1) {
+        switch (c) {
+        case 'd':
+            seconds = atoi(optarg);
+            break;
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 'l':
+            cecplugin_loglevel = atoi(optarg);
+            break;
+        default:
+            Usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!LoadMock()) {
+        return 2;
+    }
+
+    char *tmpdir = sTmpDir;
+    if (mkdtemp(tmpdir) == nullptr) {
+        perror("mkdtemp");
+        return 2;
+    }
+    atexit(RemoveTmpDir);
+    std::string cfgfile = std::string(tmpdir) + "/cecremote.xml";
+    FILE *f = fopen(cfgfile.c_str(), "w");
+    if (f == nullptr) {
+        perror(cfgfile.c_str());
+        return 2;
+    }
+    fputs(sConfig, f);
+    fclose(f);
+
+    cThread::SetMainThreadId();
+    cPlugin::SetConfigDirectory(tmpdir);
+    cPlugin::SetCacheDirectory(tmpdir);
+    new cStressDevice;
+    cDevice::SetPrimaryDevice(1);
+
+    cPluginCecremote *plugin = new cPluginCecremote();
+    char *args[] = {(char *)"cecremote", (char *)"-c", tmpdir,
+                    (char *)"-x", (char *)"cecremote.xml", nullptr};
+    optind = 0;
+    if (!plugin->ProcessArgs(5, args) || !plugin->Initialize() ||
+        !plugin->Start()) {
+        fprintf(stderr, "Plugin start failed\n");
+        return 1;
+    }
+    for (int i = 0; (sOpens() == 0) && (i < 500); i++) {
+        usleep(10000);
+    }
+    if (sOpens() == 0) {
+        fprintf(stderr, "Mock adapter not opened\n");
+        return 1;
+    }
+
+    cLatency key("key"), frame("frame"), alert("alert");
+    cLatency lstd("LSTD"), stat("STAT"), conn("DISC+CONN");
+    cLatency control("cCECControl"), volume("volume");
+    uint64_t start = cMetrics::NowUs();
+    std::vector<std::thread> threads;
+    threads.emplace_back(KeyThread, std::ref(key));
+    threads.emplace_back(FrameThread, std::ref(frame), rate);
+    threads.emplace_back(AlertThread, std::ref(alert));
+    threads.emplace_back(SvdrpThread, plugin, std::ref(lstd), std::ref(stat),
+                         std::ref(conn));
+    MainLoop(plugin, control, volume, seconds);
+    sRunning = false;
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    double duration = (cMetrics::NowUs() - start) / 1000000.0;
+
+    plugin->Stop();
+    delete plugin;
+
+    printf("%.1f s, %u adapter opens\n", duration, sOpens());
+    printf("%-12s %8s %11s %8s  %8s %8s %8s %8s %8s\n", "operation",
+           "count", "rate", "failed", "p50 ms", "p90 ms", "p99 ms",
+           "p99.9 ms", "max ms");
+    for (cLatency *lat : {&key, &frame, &alert, &lstd, &stat, &conn,
+                          &control, &volume}) {
+        lat->Report(duration);
+    }
+    return 0;
+}
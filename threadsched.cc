@@ -0,0 +1,211 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the scheduling options of the CEC threads.
+ */
+
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "threadsched.h"
+#include "ceclog.h"
+
+namespace cecplugin {
+
+/**
+ * @brief Converts a policy name.
+ *
+ * @param text "other", "fifo" or "rr"
+ * @param policy Receives the policy
+ * @return false on unknown names
+ */
+bool cThreadScheduling::ParsePolicy(const char *text, int &policy)
+{
+    if (strcasecmp(text, "other") == 0) {
+        policy = SCHED_OTHER;
+    }
+    else if (strcasecmp(text, "fifo") == 0) {
+        policy = SCHED_FIFO;
+    }
+    else if (strcasecmp(text, "rr") == 0) {
+        policy = SCHED_RR;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Converts a list of CPU numbers.
+ *
+ * @param text CPUs separated by comma or space
+ * @param cpus Receives the CPU numbers
+ * @return false on invalid numbers
+ */
+bool cThreadScheduling::ParseCpus(const char *text, std::vector<int> &cpus)
+{
+    cpus.clear();
+    const char *p = text;
+    while (*p != '\0') {
+        if ((*p == ',') || (*p == ' ')) {
+            p++;
+            continue;
+        }
+        char *end;
+        long cpu = strtol(p, &end, 10);
+        if ((end == p) || (cpu < 0) || (cpu >= CPU_SETSIZE)) {
+            return false;
+        }
+        cpus.push_back((int)cpu);
+        p = end;
+    }
+    return true;
+}
+
+/**
+ * @brief Applies the options to the calling thread.
+ *
+ * Real-time policies need CAP_SYS_NICE or a matching RLIMIT_RTPRIO,
+ * failures are logged and the thread keeps running with the old policy.
+ *
+ * @param name Name of the thread for the log
+ * @return false if an option could not be applied
+ */
+bool cThreadScheduling::Apply(const char *name) const
+{
+    bool ok = true;
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+
+    if (!mCpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : mCpus) {
+            CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            Esyslog("%s: can not set CPU affinity: %s", name, strerror(errno));
+            ok = false;
+        }
+    }
+    if (mPolicy >= 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        if (mPolicy != SCHED_OTHER) {
+            param.sched_priority = mPriority;
+        }
+        // Scripts forked by the thread must not inherit a real-time policy
+        if (sched_setscheduler(0, mPolicy | SCHED_RESET_ON_FORK, &param) != 0) {
+            Esyslog("%s: can not set policy %d priority %d: %s", name,
+                    mPolicy, mPriority, strerror(errno));
+            ok = false;
+        }
+    }
+    // On Linux the nice value is a property of the thread
+    if (mNiceSet && (setpriority(PRIO_PROCESS, tid, mNice) != 0)) {
+        Esyslog("%s: can not set nice %d: %s", name, mNice, strerror(errno));
+        ok = false;
+    }
+    Isyslog("%s (%d): %s", name, tid, *Describe(tid));
+    return ok;
+}
+
+/**
+ * @brief Resets the CPU affinity and nice value of a forked child.
+ *
+ * SCHED_RESET_ON_FORK only resets the policy and a negative nice value,
+ * so the child takes the affinity and the nice value of the VDR main
+ * thread. Called between fork() and exec(), only async-signal-safe
+ * system calls are used.
+ */
+void cThreadScheduling::ResetInChild()
+{
+    pid_t parent = getppid();
+    cpu_set_t set;
+
+    if (sched_getaffinity(parent, sizeof(set), &set) != 0) {
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    sched_setaffinity(0, sizeof(set), &set);
+
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, parent);
+    if ((nice == -1) && (errno != 0)) {
+        nice = 0;
+    }
+    setpriority(PRIO_PROCESS, 0, nice);
+}
+
+/**
+ * @brief Describes the effective scheduling of a thread.
+ *
+ * @param tid Kernel thread id
+ * @return e.g. "fifo 10 nice 0 cpus 1,3"
+ */
+cString cThreadScheduling::Describe(pid_t tid)
+{
+    if (tid <= 0) {
+        return "not running";
+    }
+    int policy = sched_getscheduler(tid);
+    if (policy < 0) {
+        return cString::sprintf("unknown (%s)", strerror(errno));
+    }
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    sched_getparam(tid, &param);
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, tid);
+
+    const char *pname;
+    switch (policy & ~SCHED_RESET_ON_FORK) {
+    case SCHED_FIFO:
+        pname = "fifo";
+        break;
+    case SCHED_RR:
+        pname = "rr";
+        break;
+    case SCHED_OTHER:
+        pname = "other";
+        break;
+    default:
+        pname = "?";
+        break;
+    }
+    cString cpus = "";
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(tid, sizeof(set), &set) == 0) {
+        int count = CPU_COUNT(&set);
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        if (count >= online) {
+            cpus = "all";
+        }
+        else {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &set)) {
+                    cpus = cString::sprintf("%s%s%d", *cpus,
+                                            (**cpus == '\0') ? "" : ",", cpu);
+                }
+            }
+        }
+    }
+    return cString::sprintf("%s %d nice %d cpus %s", pname,
+                            param.sched_priority, nice, *cpus);
+}
+
+} // namespace cecplugin
@@ -0,0 +1,86 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the scheduling options of the CEC threads.
+ */
+
+#ifndef THREADSCHED_H_
+#define THREADSCHED_H_
+
+#include <vdr/tools.h>
+#include <sys/types.h>
+#include <vector>
+
+namespace cecplugin {
+
+/**
+ * @class cThreadScheduling
+ * @brief Scheduling policy, priority, nice value and CPU affinity of the
+ *        threads handling CEC keys.
+ *
+ * Configured in <global> with <schedpolicy>, <schedpriority>, <nice> and
+ * <cpuaffinity>. Applied by the worker threads and the libCEC callback
+ * threads to themselves when they start. Processes forked by these threads
+ * get the scheduling of the VDR main thread.
+ */
+class cThreadScheduling {
+public:
+    int mPolicy = -1;            ///< SCHED_OTHER, SCHED_FIFO, SCHED_RR, -1 = unchanged
+    int mPriority = 0;           ///< Real-time priority for SCHED_FIFO/SCHED_RR
+    int mNice = 0;               ///< Nice value for SCHED_OTHER
+    bool mNiceSet = false;       ///< mNice was configured
+    std::vector<int> mCpus;      ///< CPUs the threads may run on, empty = all
+
+    /**
+     * @brief Checks if any option was configured.
+     * @return true if the threads have to be changed.
+     */
+    bool IsSet() const {
+        return (mPolicy >= 0) || mNiceSet || !mCpus.empty();
+    }
+
+    /**
+     * @brief Converts a policy name.
+     * @param text "other", "fifo" or "rr".
+     * @param policy Receives the policy.
+     * @return false on unknown names.
+     */
+    static bool ParsePolicy(const char *text, int &policy);
+
+    /**
+     * @brief Converts a list of CPU numbers.
+     * @param text CPUs separated by comma, e.g. "1,3".
+     * @param cpus Receives the CPU numbers.
+     * @return false on invalid numbers.
+     */
+    static bool ParseCpus(const char *text, std::vector<int> &cpus);
+
+    /**
+     * @brief Applies the options to the calling thread.
+     * @param name Name of the thread for the log.
+     * @return false if an option could not be applied.
+     */
+    bool Apply(const char *name) const;
+
+    /**
+     * @brief Resets the CPU affinity and nice value in a forked child
+     *        to the ones of the VDR main thread.
+     */
+    static void ResetInChild();
+
+    /**
+     * @brief Describes the effective scheduling of a thread.
+     * @param tid Kernel thread id, 0 if the thread is not running.
+     * @return Policy, priority, nice value and CPUs.
+     */
+    static cString Describe(pid_t tid);
+};
+
+} // namespace cecplugin
+
+#endif /* THREADSCHED_H_ */
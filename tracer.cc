@@ -0,0 +1,208 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the trace of the worker activity.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "tracer.h"
+#include "ceclog.h"
+
+namespace cecplugin {
+
+std::atomic<bool> cTracer::sEnabled{false};
+cMutex cTracer::sMutex;
+std::vector<cTracer::cEvent> cTracer::sRing;
+size_t cTracer::sNext = 0;
+bool cTracer::sWrapped = false;
+std::map<int, std::string> cTracer::sNames;
+
+/**
+ * @brief Enables the tracer.
+ *
+ * @param size Number of events kept in the ring buffer
+ */
+void cTracer::Enable(int size)
+{
+    if (size <= 0) {
+        return;
+    }
+    cMutexLock lock(&sMutex);
+    sRing.assign(size, cEvent());
+    sNext = 0;
+    sWrapped = false;
+    sEnabled = true;
+    Isyslog("Trace buffer %d events", size);
+}
+
+/**
+ * @brief Stores an event in the ring buffer, overwriting the oldest one.
+ *
+ * @param event The event
+ */
+void cTracer::Add(const cEvent &event)
+{
+    cMutexLock lock(&sMutex);
+    if (sRing.empty()) {
+        return;
+    }
+    sRing[sNext] = event;
+    if (++sNext >= sRing.size()) {
+        sNext = 0;
+        sWrapped = true;
+    }
+}
+
+/**
+ * @brief Records a completed span.
+ *
+ * @param cat Category, must be a string literal
+ * @param name Name, must be a string literal
+ * @param startUs Start time (see cMetrics::NowUs())
+ * @param durUs Duration in us
+ * @param arg Argument shown with the span, -1 = none
+ * @param tid Thread lane, 0 = the calling thread
+ */
+void cTracer::Complete(const char *cat, const char *name, uint64_t startUs,
+                       uint64_t durUs, int arg, int tid)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    cEvent event;
+    event.mCat = cat;
+    event.mName = name;
+    event.mTid = (tid != 0) ? tid : cThread::ThreadId();
+    event.mArg = arg;
+    event.mTs = startUs;
+    event.mDur = durUs;
+    Add(event);
+}
+
+/**
+ * @brief Records an instant event of the calling thread.
+ *
+ * @param cat Category, must be a string literal
+ * @param name Name, must be a string literal
+ * @param arg Argument shown with the event, -1 = none
+ */
+void cTracer::Instant(const char *cat, const char *name, int arg)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    cEvent event;
+    event.mCat = cat;
+    event.mName = name;
+    event.mPhase = 'i';
+    event.mTid = cThread::ThreadId();
+    event.mArg = arg;
+    event.mTs = cMetrics::NowUs();
+    Add(event);
+}
+
+/**
+ * @brief Names the lane of the calling thread in the trace viewer.
+ *
+ * @param name Thread name
+ */
+void cTracer::ThreadName(const std::string &name)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    cMutexLock lock(&sMutex);
+    sNames[cThread::ThreadId()] = name;
+}
+
+/**
+ * @brief Gets the recorded events as Chrome trace JSON.
+ *
+ * The events are listed from the oldest to the newest, preceded by the
+ * names of the threads.
+ *
+ * @return JSON text, one event per line
+ */
+std::string cTracer::Dump()
+{
+    std::string s = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    const char *sep = "\n";
+    char buf[256];
+    int pid = getpid();
+
+    cMutexLock lock(&sMutex);
+    for (const auto &n : sNames) {
+        std::string name;
+        for (char c : n.second) {
+            if ((c == '"') || (c == '\\')) {
+                name += '\\';
+            }
+            name += c;
+        }
+        snprintf(buf, sizeof(buf),
+                 "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,"
+                 "\"tid\":%d,\"args\":{\"name\":\"%.64s\"}}",
+                 sep, pid, n.first, name.c_str());
+        s += buf;
+        sep = ",\n";
+    }
+    size_t count = sWrapped ? sRing.size() : sNext;
+    size_t first = sWrapped ? sNext : 0;
+    for (size_t i = 0; i < count; i++) {
+        const cEvent &e = sRing[(first + i) % sRing.size()];
+        int len = snprintf(buf, sizeof(buf),
+                           "%s{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":\"%s\","
+                           "\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64,
+                           sep, e.mPhase, e.mCat, e.mName, pid, e.mTid, e.mTs);
+        if (e.mPhase == 'X') {
+            len += snprintf(buf + len, sizeof(buf) - len,
+                            ",\"dur\":%" PRIu64, e.mDur);
+        }
+        else {
+            len += snprintf(buf + len, sizeof(buf) - len, ",\"s\":\"t\"");
+        }
+        if (e.mArg != -1) {
+            len += snprintf(buf + len, sizeof(buf) - len,
+                            ",\"args\":{\"v\":%d}", e.mArg);
+        }
+        snprintf(buf + len, sizeof(buf) - len, "}");
+        s += buf;
+        sep = ",\n";
+    }
+    s += "\n]}\n";
+    return s;
+}
+
+/**
+ * @brief Writes the recorded events as Chrome trace JSON to a file.
+ *
+ * @param path File name
+ * @return false if the file could not be written
+ */
+bool cTracer::Write(const char *path)
+{
+    std::string s = Dump();
+    FILE *f = fopen(path, "w");
+    if (f == nullptr) {
+        Esyslog("Can not write trace %s: %s", path, strerror(errno));
+        return false;
+    }
+    bool ok = (fwrite(s.data(), 1, s.size(), f) == s.size());
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        Esyslog("Can not write trace %s: %s", path, strerror(errno));
+    }
+    return ok;
+}
+
+} // namespace cecplugin
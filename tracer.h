@@ -0,0 +1,145 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the trace of the worker activity.
+ */
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "metrics.h"
+
+namespace cecplugin {
+
+/**
+ * @class cTracer
+ * @brief Records spans of the plugin threads in a ring buffer.
+ *
+ * The spans are dumped in the Chrome trace event format, which can be
+ * loaded into chrome://tracing or https://ui.perfetto.dev. The tracer is
+ * off unless <tracebuffer> is configured, a disabled tracer costs one
+ * relaxed load per span.
+ */
+class cTracer {
+public:
+    /**
+     * @brief Enables the tracer.
+     * @param size Number of events kept in the ring buffer.
+     */
+    static void Enable(int size);
+
+    /** @brief Checks if the tracer is enabled. */
+    static bool IsEnabled() {
+        return sEnabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Records a completed span.
+     * @param cat Category, must be a string literal.
+     * @param name Name, must be a string literal.
+     * @param startUs Start time (see cMetrics::NowUs()).
+     * @param durUs Duration in us.
+     * @param arg Argument shown with the span, -1 = none.
+     * @param tid Thread lane, 0 = the calling thread.
+     */
+    static void Complete(const char *cat, const char *name, uint64_t startUs,
+                         uint64_t durUs, int arg = -1, int tid = 0);
+
+    /**
+     * @brief Records an instant event of the calling thread.
+     * @param cat Category, must be a string literal.
+     * @param name Name, must be a string literal.
+     * @param arg Argument shown with the event, -1 = none.
+     */
+    static void Instant(const char *cat, const char *name, int arg = -1);
+
+    /**
+     * @brief Names the lane of the calling thread.
+     * @param name Thread name.
+     */
+    static void ThreadName(const std::string &name);
+
+    /**
+     * @brief Gets the recorded events as Chrome trace JSON.
+     * @return JSON text, one event per line.
+     */
+    static std::string Dump();
+
+    /**
+     * @brief Writes the recorded events as Chrome trace JSON to a file.
+     * @param path File name.
+     * @return false if the file could not be written.
+     */
+    static bool Write(const char *path);
+
+private:
+    /** @brief One recorded event. */
+    class cEvent {
+    public:
+        const char *mCat = nullptr;   ///< Category
+        const char *mName = nullptr;  ///< Name
+        char mPhase = 'X';            ///< 'X' = span, 'i' = instant
+        int mTid = 0;                 ///< Thread lane
+        int mArg = -1;                ///< Argument, -1 = none
+        uint64_t mTs = 0;             ///< Start time in us
+        uint64_t mDur = 0;            ///< Duration in us
+    };
+
+    static std::atomic<bool> sEnabled;        ///< Tracer is enabled
+    static cMutex sMutex;                     ///< Protects the ring buffer
+    static std::vector<cEvent> sRing;         ///< Ring buffer
+    static size_t sNext;                      ///< Next slot to write
+    static bool sWrapped;                     ///< Ring buffer is full
+    static std::map<int, std::string> sNames; ///< Thread names by tid
+
+    /** @brief Stores an event in the ring buffer. */
+    static void Add(const cEvent &event);
+};
+
+/**
+ * @class cTraceSpan
+ * @brief Records the lifetime of a scope as span of the calling thread.
+ */
+class cTraceSpan {
+private:
+    const char *mCat;    ///< Category
+    const char *mName;   ///< Name
+    int mArg;            ///< Argument
+    uint64_t mStartUs;   ///< Start time, 0 = tracer was disabled
+
+public:
+    /**
+     * @brief Marks the start of the span.
+     * @param cat Category, must be a string literal.
+     * @param name Name, must be a string literal.
+     * @param arg Argument shown with the span, -1 = none.
+     */
+    cTraceSpan(const char *cat, const char *name, int arg = -1) :
+            mCat(cat), mName(name), mArg(arg),
+            mStartUs(cTracer::IsEnabled() ? cMetrics::NowUs() : 0) {}
+
+    /** @brief Records the span. */
+    ~cTraceSpan() {
+        if (mStartUs != 0) {
+            cTracer::Complete(mCat, mName, mStartUs,
+                              cMetrics::NowUs() - mStartUs, mArg);
+        }
+    }
+};
+
+} // namespace cecplugin
+
+#endif /* TRACER_H_ */
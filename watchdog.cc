@@ -0,0 +1,63 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the watchdog for hung libCEC calls.
+ */
+
+#include "watchdog.h"
+#include "cecremote.h"
+#include "ceclog.h"
+
+namespace cecplugin {
+
+/**
+ * @brief Constructs the watchdog and starts its thread.
+ *
+ * @param remotes CEC remote handlers to supervise
+ * @param timeoutMs Maximum duration of a libCEC call in ms
+ */
+cCECWatchdog::cCECWatchdog(const std::vector<cCECRemote *> &remotes,
+                           int timeoutMs) :
+        cThread("CEC watchdog"),
+        mRemotes(remotes),
+        mTimeoutMs(timeoutMs)
+{
+    Isyslog("Watchdog timeout %d ms", mTimeoutMs);
+    Start();
+}
+
+/**
+ * @brief Destructor, stops the thread.
+ */
+cCECWatchdog::~cCECWatchdog()
+{
+    Cancel(-1);
+    mWait.Signal();
+    Cancel(3);
+}
+
+/**
+ * @brief Thread loop, checks the libCEC calls of all workers.
+ *
+ * The adapter of a stalled worker is closed by this thread, as the
+ * worker itself is blocked in the hung call.
+ */
+void cCECWatchdog::Action()
+{
+    while (Running()) {
+        mWait.Wait(CHECK_MS);
+        if (!Running()) {
+            break;
+        }
+        for (cCECRemote *remote : mRemotes) {
+            remote->CheckWatchdog(mTimeoutMs);
+        }
+    }
+}
+
+} // namespace cecplugin
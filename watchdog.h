@@ -0,0 +1,56 @@
+/*
+ * CECRemote PlugIn for VDR
+ *
+ * Copyright (C) 2015-2025 Ulrich Eckhardt <uli-vdr@uli-eckhardt.de>
+ *
+ * This code is distributed under the terms and conditions of the
+ * GNU GENERAL PUBLIC LICENSE. See the file COPYING for details.
+ *
+ * This class implements the watchdog for hung libCEC calls.
+ */
+
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+#include <vdr/thread.h>
+#include <vector>
+
+namespace cecplugin {
+
+class cCECRemote;
+
+/**
+ * @class cCECWatchdog
+ * @brief Detects libCEC calls of the worker threads which do not return.
+ *
+ * The worker threads record the libCEC call in flight and its start time
+ * (see cCECRemote::cLibCECCall). The watchdog checks them periodically
+ * and lets cCECRemote::CheckWatchdog() close a stalled adapter, so the
+ * hung call returns and the worker reconnects.
+ */
+class cCECWatchdog : public cThread {
+private:
+    static constexpr const int CHECK_MS = 500;  ///< Check interval
+
+    std::vector<cCECRemote *> mRemotes;  ///< Supervised handlers
+    int mTimeoutMs;                      ///< Maximum duration of a call
+    cCondWait mWait;                     ///< Wakes the thread on exit
+
+    /** @brief Thread loop, checks the workers every CHECK_MS. */
+    void Action();
+
+public:
+    /**
+     * @brief Constructs the watchdog and starts its thread.
+     * @param remotes CEC remote handlers to supervise.
+     * @param timeoutMs Maximum duration of a libCEC call in ms.
+     */
+    cCECWatchdog(const std::vector<cCECRemote *> &remotes, int timeoutMs);
+
+    /** @brief Destructor, stops the thread. */
+    ~cCECWatchdog();
+};
+
+} // namespace cecplugin
+
+#endif /* WATCHDOG_H_ */